@@ -83,8 +83,10 @@ void runBlynkWithChecks() {
   if (BlynkState::get() == MODE_RUNNING) {
     if (!Blynk.connected()) {
       if (WiFi.status() == WL_CONNECTED) {
+        reconnect.lost(LINK_CLOUD, millis());
         BlynkState::set(MODE_CONNECTING_CLOUD);
       } else {
+        reconnect.lost(LINK_NET, millis());
         BlynkState::set(MODE_CONNECTING_NET);
       }
     }
@@ -106,6 +108,7 @@ public:
     BLYNK_FS.begin(true);
 #endif
 
+    reconnect.begin(esp_random() ^ (uint32_t)ESP.getEfuseMac());
     indicator_init();
     button_init();
     config_init();
@@ -131,7 +134,12 @@ public:
 
   void run() {
     app_loop();
-    switch (BlynkState::get()) {
+    State current = BlynkState::get();
+    if (current != active) {
+      connectivityLeave(active, current);
+      active = current;
+    }
+    switch (current) {
     case MODE_WAIT_CONFIG:       
     case MODE_CONFIGURING:       enterConfigMode();    break;
     case MODE_CONNECTING_NET:    enterConnectNet();    break;
@@ -142,8 +150,12 @@ public:
     case MODE_RESET_CONFIG:      enterResetConfig();   break;
     default:                     enterError();         break;
     }
+    reconnect.track(WiFi.status() == WL_CONNECTED, Blynk.connected(), millis());
   }
 
+private:
+  State active = MODE_MAX_VALUE;   // state whose handler ran last
+
 } BlynkEdgent;
 
 void app_loop() {
@@ -3,6 +3,7 @@
 #include <WebServer.h>
 #include <DNSServer.h>
 #include <Update.h>
+#include "ReconnectScheduler.h"
 
 #ifndef BLYNK_FS
 
@@ -63,6 +64,28 @@ const byte DNS_PORT = 53;
 
 static int connectNetRetries    = WIFI_CLOUD_MAX_RETRIES;
 static int connectBlynkRetries  = WIFI_CLOUD_MAX_RETRIES;
+static bool fastConnectFailed   = false;  // fall back to scan + DHCP until reboot
+static bool netFastConnected    = false;  // current link came up on the fast path
+static bool netLeaseReused      = false;  // ...and skipped DHCP
+static volatile bool netHoldDown = false;  // treat the AP as unreachable (outage simulation)
+
+// The enter*() handlers below never block: each call advances one step of
+// the current state and returns, so the caller's loop keeps its cadence.
+// A state left mid-step is cleaned up by connectivityLeave().
+static bool          netPending    = false;   // association/DHCP in flight
+static bool          netFast       = false;
+static bool          netReuse      = false;
+static bool          cloudPending  = false;   // cloud login in flight
+static bool          errorPending  = false;   // waiting to restart
+static uint8_t       configPhase   = 0;       // AP bring-up steps, then serving
+static uint8_t       staPhase      = 0;
+static unsigned long stepDeadline  = 0;       // millis() the current step waits for
+
+static void connectNetResult();
+
+static bool stepWaiting() {
+  return (long)(millis() - stepDeadline) < 0;
+}
 
 static const char serverUpdateForm[] PROGMEM =
   R"(<html><body>
@@ -162,16 +185,8 @@ String getWiFiNetworkBSSID() {
   return WiFi.BSSIDstr();
 }
 
-void enterConfigMode()
+static void configServerBegin()
 {
-  WiFi.mode(WIFI_OFF);
-  delay(100);
-  WiFi.mode(WIFI_AP);
-  delay(2000);
-  WiFi.softAPConfig(WIFI_AP_IP, WIFI_AP_IP, WIFI_AP_Subnet);
-  WiFi.softAP(getWiFiName().c_str());
-  delay(500);
-
   // Set up DNS Server
   dnsServer.setTTL(300); // Time-to-live 300s
   dnsServer.setErrorReplyCode(DNSReplyCode::ServerFailure); // Return code for non-accessible domains
@@ -395,22 +410,49 @@ void enterConfigMode()
 #endif
 
   server.begin();
+}
 
-  while (BlynkState::is(MODE_WAIT_CONFIG) || BlynkState::is(MODE_CONFIGURING)) {
-    delay(10);
-    dnsServer.processNextRequest();
-    server.handleClient();
-    app_loop();
-    if (BlynkState::is(MODE_CONFIGURING) && WiFi.softAPgetStationNum() == 0) {
-      BlynkState::set(MODE_WAIT_CONFIG);
+void enterConfigMode()
+{
+  // Radio off, AP mode, AP up, then serve; each step settles before the next
+  static const uint16_t settleMs[] = { 100, 2000, 500, 0 };
+  if (configPhase < 4) {
+    if (stepWaiting()) {
+      return;
     }
+    switch (configPhase) {
+    case 0: WiFi.mode(WIFI_OFF); break;
+    case 1: WiFi.mode(WIFI_AP);  break;
+    case 2:
+      WiFi.softAPConfig(WIFI_AP_IP, WIFI_AP_IP, WIFI_AP_Subnet);
+      WiFi.softAP(getWiFiName().c_str());
+      break;
+    case 3: configServerBegin(); break;
+    }
+    stepDeadline = millis() + settleMs[configPhase++];
+    return;
   }
 
-  server.stop();
+  dnsServer.processNextRequest();
+  server.handleClient();
+  if (BlynkState::is(MODE_CONFIGURING) && WiFi.softAPgetStationNum() == 0) {
+    BlynkState::set(MODE_WAIT_CONFIG);
+  }
 }
 
 void enterConnectNet() {
   BlynkState::set(MODE_CONNECTING_NET);
+  if (netPending) {
+    if (stepWaiting() && (netHoldDown || WiFi.status() != WL_CONNECTED)) {
+      return;
+    }
+    netPending = false;
+    connectNetResult();
+    return;
+  }
+  if (!reconnect.due(LINK_NET, millis())) {
+    return; // backing off
+  }
   DEBUG_PRINT(String("Connecting to WiFi: ") + configStore.wifiSSID);
 
   // Needed for setHostname to work
@@ -420,6 +462,10 @@ void enterConnectNet() {
   hostname.replace(" ", "-");
   WiFi.setHostname(hostname.c_str());
 
+  // Fast path: join the last AP directly (no scan) and reuse a recent lease (no DHCP)
+  netFast = configStore.getFlag(CONFIG_FLAG_FAST_NET) && !fastConnectFailed;
+  netReuse = netFast && !configStore.getFlag(CONFIG_FLAG_STATIC_IP) && config_lease_usable();
+
   if (configStore.getFlag(CONFIG_FLAG_STATIC_IP)) {
     if (!WiFi.config(configStore.staticIP,
                     configStore.staticGW,
@@ -432,71 +478,109 @@ void enterConnectNet() {
       BlynkState::set(MODE_ERROR);
       return;
     }
+  } else if (netReuse) {
+    WiFi.config(configStore.fastIP, configStore.fastGW, configStore.fastMask, configStore.fastDNS);
+  } else {
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // back to DHCP
   }
 
-  WiFi.begin(configStore.wifiSSID, configStore.wifiPass);
+  if (netHoldDown) {
+    // Simulated outage: the attempt just runs into its timeout
+  } else if (netFast) {
+    WiFi.begin(configStore.wifiSSID, configStore.wifiPass, configStore.fastChannel, configStore.fastBSSID);
+  } else {
+    WiFi.begin(configStore.wifiSSID, configStore.wifiPass);
+  }
 
-  unsigned long timeoutMs = millis() + WIFI_NET_CONNECT_TIMEOUT;
-  while ((timeoutMs > millis()) && (WiFi.status() != WL_CONNECTED))
-  {
-    delay(10);
-    app_loop();
+  reconnect.started(LINK_NET, millis());
+  stepDeadline = millis() + (netFast ? WIFI_FAST_CONNECT_TIMEOUT
+                                     : reconnect.attemptTimeout(LINK_NET, WIFI_NET_CONNECT_TIMEOUT));
+  netPending = true;
+}
 
-    if (!BlynkState::is(MODE_CONNECTING_NET)) {
-      WiFi.disconnect();
-      return;
-    }
+static void connectNetResult() {
+  if (netFast && WiFi.status() != WL_CONNECTED) {
+    // AP moved channel or was replaced; not counted as a retry
+    DEBUG_PRINT("Fast connect failed, scanning");
+    WiFi.disconnect();
+    fastConnectFailed = true;
+    reconnect.failed(LINK_NET, millis(), false);
+    return;
   }
 
   if (WiFi.status() == WL_CONNECTED) {
     IPAddress localip = WiFi.localIP();
     if (configStore.getFlag(CONFIG_FLAG_STATIC_IP)) {
       BLYNK_LOG_IP("Using Static IP: ", localip);
+    } else if (netReuse) {
+      BLYNK_LOG_IP("Reusing cached IP: ", localip);
     } else {
       BLYNK_LOG_IP("Using Dynamic IP: ", localip);
     }
+    netFastConnected = netFast;
+    netLeaseReused = netReuse;
 
+    reconnect.succeeded(LINK_NET, millis());
     connectNetRetries = WIFI_CLOUD_MAX_RETRIES;
     BlynkState::set(MODE_CONNECTING_CLOUD);
-  } else if (--connectNetRetries <= 0) {
-    config_set_last_error(BLYNK_PROV_ERR_NETWORK);
-    BlynkState::set(MODE_ERROR);
+  } else {
+    // Stop the driver retrying on its own while we back off
+    WiFi.disconnect();
+    reconnect.failed(LINK_NET, millis());
+    DEBUG_PRINT(String("WiFi retry in ") + reconnect.stage(LINK_NET).waitMs + " ms");
+    if (--connectNetRetries <= 0) {
+      config_set_last_error(BLYNK_PROV_ERR_NETWORK);
+      BlynkState::set(MODE_ERROR);
+    }
   }
 }
 
 void enterConnectCloud() {
   BlynkState::set(MODE_CONNECTING_CLOUD);
 
-  Blynk.config(configStore.cloudToken, configStore.cloudHost, configStore.cloudPort);
-  Blynk.connect(0);
-
-  unsigned long timeoutMs = millis() + WIFI_CLOUD_CONNECT_TIMEOUT;
-  while ((timeoutMs > millis()) &&
-        (WiFi.status() == WL_CONNECTED) &&
-        (!Blynk.isTokenInvalid()) &&
-        (Blynk.connected() == false))
-  {
-    delay(10);
-    Blynk.run();
-    app_loop();
-    if (!BlynkState::is(MODE_CONNECTING_CLOUD)) {
-      Blynk.disconnect();
+  if (!cloudPending) {
+    if (WiFi.status() != WL_CONNECTED) {
+      BlynkState::set(MODE_CONNECTING_NET);
       return;
     }
+    if (!reconnect.due(LINK_CLOUD, millis())) {
+      return; // backing off
+    }
+    Blynk.config(configStore.cloudToken, configStore.cloudHost, configStore.cloudPort);
+    Blynk.connect(0);
+    reconnect.started(LINK_CLOUD, millis());
+    stepDeadline = millis() + reconnect.attemptTimeout(LINK_CLOUD, WIFI_CLOUD_CONNECT_TIMEOUT);
+    cloudPending = true;
+    return;
   }
 
-  if (millis() > timeoutMs) {
+  Blynk.run();
+  if (stepWaiting() &&
+      (WiFi.status() == WL_CONNECTED) &&
+      (!Blynk.isTokenInvalid()) &&
+      (Blynk.connected() == false))
+  {
+    return;
+  }
+  cloudPending = false;
+
+  if (!stepWaiting()) {
     DEBUG_PRINT("Timeout");
   }
 
   if (Blynk.isTokenInvalid()) {
+    reconnect.failed(LINK_CLOUD, millis());
     config_set_last_error(BLYNK_PROV_ERR_TOKEN);
     BlynkState::set(MODE_WAIT_CONFIG); // TODO: retry after timeout
   } else if (WiFi.status() != WL_CONNECTED) {
+    reconnect.failed(LINK_CLOUD, millis(), false);
     BlynkState::set(MODE_CONNECTING_NET);
   } else if (Blynk.connected()) {
+    reconnect.succeeded(LINK_CLOUD, millis());
     BlynkState::set(MODE_RUNNING);
     connectBlynkRetries = WIFI_CLOUD_MAX_RETRIES;
+    config_cache_network(!netLeaseReused && !configStore.getFlag(CONFIG_FLAG_STATIC_IP));
+    fastConnectFailed = false;
 
     if (!configStore.getFlag(CONFIG_FLAG_VALID)) {
       configStore.last_error = BLYNK_PROV_ERR_NONE;
@@ -505,36 +589,59 @@ void enterConnectCloud() {
 
       Blynk.sendInternal("meta", "set", "Hotspot Name", getWiFiName());
     }
-  } else if (--connectBlynkRetries <= 0) {
-    config_set_last_error(BLYNK_PROV_ERR_CLOUD);
-    BlynkState::set(MODE_ERROR);
+  } else if (netLeaseReused) {
+    // The cached lease may have been handed to someone else: redo DHCP
+    DEBUG_PRINT("Cloud unreachable on cached lease, renewing");
+    reconnect.failed(LINK_CLOUD, millis(), false);
+    config_forget_network();
+    fastConnectFailed = true;
+    WiFi.disconnect();
+    BlynkState::set(MODE_CONNECTING_NET);
+  } else {
+    // Keep the library from retrying on its own while we back off
+    Blynk.disconnect();
+    reconnect.failed(LINK_CLOUD, millis());
+    DEBUG_PRINT(String("Cloud retry in ") + reconnect.stage(LINK_CLOUD).waitMs + " ms");
+    if (--connectBlynkRetries <= 0) {
+      config_set_last_error(BLYNK_PROV_ERR_CLOUD);
+      BlynkState::set(MODE_ERROR);
+    }
   }
 }
 
 void enterSwitchToSTA() {
   BlynkState::set(MODE_SWITCH_TO_STA);
 
-  DEBUG_PRINT("Switching to STA...");
-
-  delay(1000);
-  WiFi.mode(WIFI_OFF);
-  delay(100);
-  WiFi.mode(WIFI_STA);
-
-  BlynkState::set(MODE_CONNECTING_NET);
+  if (stepWaiting()) {
+    return;
+  }
+  switch (staPhase++) {
+  case 0:
+    DEBUG_PRINT("Switching to STA...");
+    stepDeadline = millis() + 1000;   // let the config reply reach the app
+    break;
+  case 1:
+    WiFi.mode(WIFI_OFF);
+    stepDeadline = millis() + 100;
+    break;
+  default:
+    WiFi.mode(WIFI_STA);
+    staPhase = 0;
+    BlynkState::set(MODE_CONNECTING_NET);
+    break;
+  }
 }
 
 void enterError() {
   BlynkState::set(MODE_ERROR);
 
-  unsigned long timeoutMs = millis() + 10000;
-  while (timeoutMs > millis() || g_buttonPressed)
-  {
-    delay(10);
-    app_loop();
-    if (!BlynkState::is(MODE_ERROR)) {
-      return;
-    }
+  if (!errorPending) {
+    errorPending = true;
+    stepDeadline = millis() + 10000;
+    return;
+  }
+  if (stepWaiting() || g_buttonPressed) {
+    return;
   }
   DEBUG_PRINT("Restarting after error.");
   delay(10);
@@ -542,3 +649,36 @@ void enterError() {
   restartMCU();
 }
 
+/* Cleans up after a state that was left with a step in flight */
+void connectivityLeave(State from, State to) {
+  switch (from) {
+  case MODE_CONNECTING_NET:
+    if (netPending) {
+      netPending = false;
+      WiFi.disconnect();
+    }
+    break;
+  case MODE_CONNECTING_CLOUD:
+    if (cloudPending) {
+      cloudPending = false;
+      Blynk.disconnect();
+    }
+    break;
+  case MODE_WAIT_CONFIG:
+  case MODE_CONFIGURING:
+    if (to != MODE_WAIT_CONFIG && to != MODE_CONFIGURING && configPhase) {
+      configPhase = 0;
+      server.stop();
+    }
+    break;
+  case MODE_SWITCH_TO_STA:
+    staPhase = 0;
+    break;
+  case MODE_ERROR:
+    errorPending = false;
+    break;
+  default:
+    break;
+  }
+  stepDeadline = millis();
+}
@@ -1,6 +1,7 @@
 
 #define CONFIG_FLAG_VALID       0x01
 #define CONFIG_FLAG_STATIC_IP   0x02
+#define CONFIG_FLAG_FAST_NET    0x04   // fastBSSID/fastChannel/lease below are valid
 
 #define BLYNK_PROV_ERR_NONE     0      // All good
 #define BLYNK_PROV_ERR_CONFIG   700    // Invalid config from app (malformed token,etc)
@@ -29,6 +30,16 @@ struct ConfigStore {
 
   int       last_error;
 
+  // Last network that reached the cloud, for the fast-connect path.
+  // Appended so configs saved by older firmware still load (zeroed).
+  uint8_t   fastBSSID[6];
+  uint8_t   fastChannel;
+  uint32_t  fastIP;       // DHCP lease, 0 when static IP is configured
+  uint32_t  fastMask;
+  uint32_t  fastGW;
+  uint32_t  fastDNS;
+  uint32_t  fastLeaseAt;  // RTC seconds when the lease was obtained
+
   void setFlag(uint8_t mask, bool value) {
     if (value) {
       flags |= mask;
@@ -142,6 +153,43 @@ void enterResetConfig()
   BlynkState::set(MODE_WAIT_CONFIG);
 }
 
+static bool config_lease_usable() {
+  time_t now = time(nullptr);
+  return configStore.fastIP && configStore.fastLeaseAt && now > 1600000000 &&
+         (uint32_t)now - configStore.fastLeaseAt < WIFI_LEASE_REUSE_S;
+}
+
+// Remembers the network that just reached the cloud, saving only on change
+void config_cache_network(bool freshLease) {
+  ConfigStore cached = configStore;
+  memcpy(cached.fastBSSID, WiFi.BSSID(), sizeof(cached.fastBSSID));
+  cached.fastChannel = WiFi.channel();
+  if (configStore.getFlag(CONFIG_FLAG_STATIC_IP)) {
+    cached.fastIP = 0;
+  } else if (freshLease) {
+    time_t now = time(nullptr);
+    cached.fastIP   = WiFi.localIP();
+    cached.fastMask = WiFi.subnetMask();
+    cached.fastGW   = WiFi.gatewayIP();
+    cached.fastDNS  = WiFi.dnsIP();
+    cached.fastLeaseAt = now > 1600000000 ? (uint32_t)now : 0; // unusable until the clock is set
+  }
+  cached.setFlag(CONFIG_FLAG_FAST_NET, true);
+  if (memcmp(&cached, &configStore, sizeof(cached))) {
+    configStore = cached;
+    config_save();
+  }
+}
+
+// Drops the cache after a failed fast connect; the next attempt scans
+void config_forget_network() {
+  if (configStore.getFlag(CONFIG_FLAG_FAST_NET)) {
+    configStore.setFlag(CONFIG_FLAG_FAST_NET, false);
+    configStore.fastIP = 0;
+    config_save();
+  }
+}
+
 void config_set_last_error(int error) {
   // Only set error if not provisioned
   if (!configStore.getFlag(CONFIG_FLAG_VALID)) {
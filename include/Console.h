@@ -1,5 +1,8 @@
 
 #include <Blynk/BlynkConsole.h>
+#include "StageProfiler.h"
+#include "HeapTracker.h"
+#include "LogStore.h"
 
 extern "C" {
   #include "esp_partition.h"
@@ -130,6 +133,31 @@ void console_init()
     edgentConsole.printf(" Heap free:       %d / %d\n",   ESP.getFreeHeap(), ESP.getHeapSize());
     edgentConsole.printf("      max alloc:  %d\n",        ESP.getMaxAllocHeap());
     edgentConsole.printf("      min free:   %d\n",        ESP.getMinFreeHeap());
+    uint32_t heapFree = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    uint32_t largest  = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    edgentConsole.printf("      largest:    %d (%d%% fragmented, lowest %d)\n", largest,
+                         heapFree ? 100 - (int)(100ULL * largest / heapFree) : 0, heapTrend.lowestLargestBlock());
+    if (!isnan(heapTrend.largestSlopePerDay())) {
+      edgentConsole.printf("      trend:      largest %+.0f B/day, free %+.0f B/day, %.1f days to %dK\n",
+                           heapTrend.largestSlopePerDay(), heapTrend.freeSlopePerDay(),
+                           heapTrend.daysUntil(HEAP_LARGEST_FLOOR), HEAP_LARGEST_FLOOR / 1024);
+    }
+    if (HeapTracker::enabled()) {
+      for (uint8_t i = ALLOC_UNTAGGED + 1; i < ALLOC_TAGS; i++) {
+        const HeapTracker::TagStats st = heapTracker.tagStats((AllocTag)i);
+        edgentConsole.printf(" Alloc %-10s n:%u live:%u peak:%u total:%u failed:%u\n", ALLOC_TAG_NAMES[i],
+                             (unsigned)st.allocs, (unsigned)st.liveBytes, (unsigned)st.peakBytes,
+                             (unsigned)st.totalBytes, (unsigned)st.failed);
+      }
+      edgentConsole.printf(" Alloc tracked:   %d blocks, %d overflowed\n", heapTracker.trackedBlocks(), heapTracker.overflows());
+    }
+    const LogStore::Stats store = stateStore.getStats();
+    edgentConsole.printf(" State store:     %s, %u / %u B live, %u writes failed", stateStore.usesNvs() ? "NVS" : "hglog",
+                         (unsigned)store.liveBytes, (unsigned)LOG_LIVE_CAPACITY, (unsigned)store.failed);
+    if (store.failed) {
+      edgentConsole.printf(" (last key %u)", (unsigned)store.lastFailedKey);
+    }
+    edgentConsole.printf("\n");
     if (ESP.getPsramSize()) {
       edgentConsole.printf(" PSRAM free:      %d / %d\n", ESP.getFreePsram(), ESP.getPsramSize());
     }
@@ -139,6 +167,23 @@ void console_init()
 #endif
   });
 
+  edgentConsole.addCommand("perf", [](int argc, const char** argv) {
+    if (argc >= 1 && 0 == strcmp(argv[0], "reset")) {
+      stageProfiler.reset();
+      edgentConsole.print(R"json({"status":"OK"})json" "\n");
+      return;
+    }
+    static LatencyHistogram<PERF_BUCKETS> h; // console runs on the cloud task only
+    for (uint8_t i = 0; i < PERF_STAGES; i++) {
+      stageProfiler.snapshot((PerfStage)i, h);
+      edgentConsole.printf(R"json({"stage":"%s","n":%u,"mean_us":%u,"p50_us":%u,"p99_us":%u,"max_us":%u,"total_ms":%u})json" "\n",
+                           PERF_STAGE_NAMES[i], (unsigned)h.samples(), (unsigned)h.mean(),
+                           (unsigned)h.percentile(50), (unsigned)h.percentile(99), (unsigned)h.max(),
+                           (unsigned)(h.total() / 1000));
+    }
+    edgentConsole.printf(R"json({"heaviest":"%s"})json" "\n", PERF_STAGE_NAMES[stageProfiler.heaviest()]);
+  });
+
 #ifdef BLYNK_FS
 
   edgentConsole.addCommand("ls", [](int argc, const char** argv) {
@@ -111,6 +111,8 @@
 #define WIFI_CLOUD_MAX_RETRIES        500
 #define WIFI_NET_CONNECT_TIMEOUT      50000
 #define WIFI_CLOUD_CONNECT_TIMEOUT    50000
+#define WIFI_FAST_CONNECT_TIMEOUT     3000     // cached BSSID/channel, before falling back to a scan
+#define WIFI_LEASE_REUSE_S            43200    // reuse a cached DHCP lease for this long
 #define WIFI_AP_IP                    IPAddress(192, 168, 4, 1)
 #define WIFI_AP_Subnet                IPAddress(255, 255, 255, 0)
 //#define WIFI_CAPTIVE_PORTAL_ENABLE
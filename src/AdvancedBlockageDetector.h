@@ -28,6 +28,21 @@ public:
 
     BlockageStatus update(float inletPressure, float outletPressure, float flowRate, float temperature = 20.0f);
 
+    // Size of moving average window for smoothing
+    static constexpr size_t MOVING_AVG_SIZE = 50;
+
+    // Fixed-size copy of the detector histories, for persisting across reboots
+    struct Snapshot {
+        uint8_t pressureCount;
+        uint8_t blockageCount;
+        bool wasAboveThreshold;
+        float pressure[MOVING_AVG_SIZE];
+        float blockage[MOVING_AVG_SIZE];
+    };
+
+    void snapshot(Snapshot& out) const;
+    void restore(const Snapshot& in);
+
 private:
     // Minimum flow rate required for reliable measurements
     static constexpr float MINIMUM_FLOW_THRESHOLD = 1.0f;
@@ -35,8 +50,6 @@ private:
     static constexpr float BLOCKAGE_ATTENTION_THRESHOLD = 30.0f;
     // Hysteresis band to prevent oscillation around threshold
     static constexpr float HYSTERESIS = 8.0f;
-    // Size of moving average window for smoothing
-    static constexpr size_t MOVING_AVG_SIZE = 50;
     // Minimum pressure difference to consider valid (kPa)
     static constexpr float MINIMUM_PRESSURE_DIFF = 0.1f;
     // Maximum allowable pressure difference (kPa)
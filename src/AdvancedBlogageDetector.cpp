@@ -108,6 +108,23 @@ bool AdvancedBlockageDetector::validateReadings(float inletPressure, float outle
 
 
 
+void AdvancedBlockageDetector::snapshot(Snapshot& out) const {
+    memset(&out, 0, sizeof(out));
+    out.pressureCount = pressureHistory.size();
+    out.blockageCount = blockageHistory.size();
+    out.wasAboveThreshold = wasAboveThreshold;
+    std::copy(pressureHistory.begin(), pressureHistory.end(), out.pressure);
+    std::copy(blockageHistory.begin(), blockageHistory.end(), out.blockage);
+}
+
+void AdvancedBlockageDetector::restore(const Snapshot& in) {
+    size_t pressureCount = std::min<size_t>(in.pressureCount, MOVING_AVG_SIZE);
+    size_t blockageCount = std::min<size_t>(in.blockageCount, MOVING_AVG_SIZE);
+    pressureHistory.assign(in.pressure, in.pressure + pressureCount);
+    blockageHistory.assign(in.blockage, in.blockage + blockageCount);
+    wasAboveThreshold = in.wasAboveThreshold;
+}
+
 std::string AdvancedBlockageDetector::determineBlockageMessage(float blockagePercentage) const {
     if(blockagePercentage < 25.0f) return "Optimal Flow";
     if(blockagePercentage < 50.0f) return "Moderate Restriction";
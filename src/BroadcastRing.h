@@ -0,0 +1,77 @@
+#ifndef BROADCAST_RING_H
+#define BROADCAST_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Single-producer, many-reader ring that readers never consume from.
+ * Each reader keeps its own sequence cursor, so any number of them can
+ * walk the same slots without a per-reader queue, and a slow reader can
+ * never hold up the producer: it is lapped instead, which read() reports.
+ * Slots are guarded seqlock-style: the producer clears a slot's stamp,
+ * writes it, then stamps it with its sequence number + 1; a reader copies
+ * the slot and accepts it only if the stamp was the expected one before
+ * and after the copy.
+ *
+ * @tparam T Trivially copyable element type.
+ * @tparam N Capacity, a power of two.
+ */
+template <typename T, size_t N>
+class BroadcastRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "BroadcastRing capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity() { return N; }
+
+    /* Producer side */
+    void publish(const T &item)
+    {
+        uint32_t seq = next.load(std::memory_order_relaxed);
+        Slot &s = slots[seq & (N - 1)];
+        s.stamp.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.item = item;
+        s.stamp.store(seq + 1, std::memory_order_release);
+        next.store(seq + 1, std::memory_order_release);
+    }
+
+    /* Sequence number the next publish() will use */
+    uint32_t head() const { return next.load(std::memory_order_acquire); }
+
+    /* Oldest sequence number still held */
+    uint32_t tail() const
+    {
+        uint32_t h = head();
+        return h > N ? h - N : 0;
+    }
+
+    /**
+     * Copies item seq if it is still in the ring.
+     * @return False if seq is not published yet or was overwritten.
+     */
+    bool read(uint32_t seq, T &out) const
+    {
+        const Slot &s = slots[seq & (N - 1)];
+        if (s.stamp.load(std::memory_order_acquire) != seq + 1) {
+            return false;
+        }
+        out = s.item;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.stamp.load(std::memory_order_relaxed) == seq + 1;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32_t> stamp{0};
+        T item;
+    };
+
+    Slot slots[N];
+    std::atomic<uint32_t> next{0};
+};
+
+#endif // BROADCAST_RING_H
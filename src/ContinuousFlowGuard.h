@@ -0,0 +1,90 @@
+#ifndef CONTINUOUS_FLOW_GUARD_H
+#define CONTINUOUS_FLOW_GUARD_H
+
+#include <Arduino.h>
+
+/* ─── Continuous-flow event limits ─────────────────────────────────────── */
+constexpr float    CONT_FLOW_MIN_LPM       = 0.2f;    // below this the tap counts as closed
+constexpr uint32_t CONT_FLOW_END_MS        = 30000;   // closed this long ends the event
+constexpr uint16_t CONT_FLOW_DEFAULT_MIN   = 60;      // minutes of uninterrupted flow
+constexpr float    CONT_FLOW_DEFAULT_L     = 600.0f;  // litres in one uninterrupted event
+
+/**
+ * Volume/duration limits on a single continuous flow event. An event
+ * starts when flow rises above CONT_FLOW_MIN_LPM and ends once flow has
+ * stayed below it for CONT_FLOW_END_MS, so a hose left running at a
+ * moderate rate is caught even though it never crosses the burst rate
+ * threshold. Duration and volume are differences against the event start
+ * (sample time and totaliser), so each sample costs O(1). A limit of 0
+ * disables that check; each event trips at most once.
+ */
+class ContinuousFlowGuard
+{
+public:
+    struct Limits
+    {
+        uint16_t maxMinutes;
+        uint16_t reserved;
+        float    maxLitres;
+    };
+
+    enum Verdict : uint8_t
+    {
+        CONT_FLOW_OK,
+        CONT_FLOW_DURATION,     // event ran longer than maxMinutes
+        CONT_FLOW_VOLUME        // event used more than maxLitres
+    };
+
+    void setLimits(const Limits &l) { limits = l; }
+    const Limits &getLimits() const { return limits; }
+
+    /**
+     * Feeds one sample.
+     * @param flowLpm Instantaneous flow in L/min.
+     * @param litres  Totaliser reading.
+     * @param nowMs   Sample time.
+     */
+    Verdict update(float flowLpm, double litres, uint32_t nowMs)
+    {
+        if (flowLpm >= CONT_FLOW_MIN_LPM) {
+            if (!active) {
+                active = true;
+                tripped = false;
+                startMs = nowMs;
+                startLitres = litres;
+                events++;
+            }
+            lastFlowMs = nowMs;
+        } else if (active && nowMs - lastFlowMs >= CONT_FLOW_END_MS) {
+            active = false;
+        }
+        if (!active || tripped) {
+            return CONT_FLOW_OK;
+        }
+        if (limits.maxMinutes && durationMs(nowMs) >= (uint32_t)limits.maxMinutes * 60000UL) {
+            tripped = true;
+            return CONT_FLOW_DURATION;
+        }
+        if (limits.maxLitres > 0 && volume(litres) >= limits.maxLitres) {
+            tripped = true;
+            return CONT_FLOW_VOLUME;
+        }
+        return CONT_FLOW_OK;
+    }
+
+    bool     inEvent() const { return active; }
+    uint32_t durationMs(uint32_t nowMs) const { return active ? nowMs - startMs : 0; }
+    float    volume(double litres) const { return active ? (float)(litres - startLitres) : 0.0f; }
+    uint32_t eventCount() const { return events; }
+
+private:
+    Limits   limits = {CONT_FLOW_DEFAULT_MIN, 0, CONT_FLOW_DEFAULT_L};
+    bool     active = false;
+    bool     tripped = false;
+    uint32_t startMs = 0;
+    uint32_t lastFlowMs = 0;
+    double   startLitres = 0;
+    uint32_t events = 0;
+};
+
+#endif // CONTINUOUS_FLOW_GUARD_H
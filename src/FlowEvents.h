@@ -0,0 +1,184 @@
+#ifndef FLOW_EVENTS_H
+#define FLOW_EVENTS_H
+
+#include <Arduino.h>
+#include <math.h>
+
+/* ─── Segmentation ─────────────────────────────────────────────────────── */
+constexpr float    FLOW_EVENT_MIN_LPM   = 0.2f;    // flow below this is "tap closed"
+constexpr uint32_t FLOW_EVENT_END_MS    = 10000;   // closed this long ends an event
+constexpr uint8_t  FLOW_EVENT_LOG_SIZE  = 16;      // recent events kept for the console
+
+/* ─── End-use model ────────────────────────────────────────────────────── */
+enum FlowEndUse : uint8_t
+{
+    END_USE_TAP,
+    END_USE_TOILET,
+    END_USE_SHOWER,
+    END_USE_BATH,
+    END_USE_APPLIANCE,       // washing machine / dishwasher fill
+    END_USE_IRRIGATION,
+    END_USE_DRIP,            // long, very low flow
+    END_USE_OTHER,           // too far from every centroid
+    END_USE_CLASSES
+};
+
+/* Typical event shape per end use: duration (s) and mean flow (L/min) */
+struct EndUseCentroid
+{
+    FlowEndUse use;
+    float      durationS;
+    float      meanLpm;
+};
+
+constexpr EndUseCentroid END_USE_MODEL[] = {
+    {END_USE_TAP,        20,   4.0f},
+    {END_USE_TOILET,     75,   6.0f},
+    {END_USE_SHOWER,     480,  8.0f},
+    {END_USE_BATH,       600,  15.0f},
+    {END_USE_APPLIANCE,  90,   10.0f},
+    {END_USE_IRRIGATION, 1800, 12.0f},
+    {END_USE_DRIP,       3600, 0.3f},
+};
+constexpr uint8_t END_USE_MODEL_SIZE = sizeof(END_USE_MODEL) / sizeof(END_USE_MODEL[0]);
+constexpr float   END_USE_MAX_DISTANCE = 1.2f;   // in ln units; farther = other
+constexpr const char *END_USE_NAMES[END_USE_CLASSES] = {
+    "tap", "toilet", "shower", "bath", "appliance", "irrigation", "drip", "other"};
+
+/* Summary of one flow event; the only thing published */
+struct FlowEvent
+{
+    uint32_t   startEpochS;    // local time, 0 if the clock was unset
+    uint32_t   durationS;
+    float      volumeL;
+    float      peakLpm;
+    FlowEndUse use;
+
+    float meanLpm() const { return durationS ? volumeL * 60.0f / durationS : 0.0f; }
+};
+
+/**
+ * Nearest-centroid label in (ln duration, ln mean flow) space. Working in
+ * log space makes a 20 s tap and a 30 s tap as close as a 20 min and a
+ * 30 min irrigation run.
+ */
+inline FlowEndUse classifyFlowEvent(const FlowEvent &e)
+{
+    if (!e.durationS || e.volumeL <= 0) {
+        return END_USE_OTHER;
+    }
+    float d = logf((float)e.durationS);
+    float q = logf(e.meanLpm());
+    FlowEndUse best = END_USE_OTHER;
+    float bestDist = END_USE_MAX_DISTANCE * END_USE_MAX_DISTANCE;
+    for (uint8_t i = 0; i < END_USE_MODEL_SIZE; i++) {
+        float dd = d - logf(END_USE_MODEL[i].durationS);
+        float dq = q - logf(END_USE_MODEL[i].meanLpm);
+        float dist = dd * dd + dq * dq;
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = END_USE_MODEL[i].use;
+        }
+    }
+    return best;
+}
+
+/**
+ * Streaming flow-event segmenter. An event opens on the first sample above
+ * FLOW_EVENT_MIN_LPM and closes once flow has stayed below it for
+ * FLOW_EVENT_END_MS; volume is the totaliser difference over the event,
+ * so it matches the meter. Closed events are classified, kept in a small
+ * ring and accumulated into per-end-use totals.
+ */
+class FlowEventSegmenter
+{
+public:
+    /**
+     * Feeds one sample.
+     * @param flowLpm Instantaneous flow in L/min.
+     * @param litres  Totaliser reading.
+     * @param nowMs   Sample time.
+     * @param epochS  Local-time epoch seconds, 0 if unknown.
+     * @return True when an event closed; read it with last().
+     */
+    bool update(float flowLpm, double litres, uint32_t nowMs, uint32_t epochS)
+    {
+        if (flowLpm >= FLOW_EVENT_MIN_LPM) {
+            if (!open) {
+                open = true;
+                quiet = false;
+                current = {};
+                current.startEpochS = epochS;
+                startMs = nowMs;
+                startLitres = litres;
+            }
+            if (flowLpm > current.peakLpm) {
+                current.peakLpm = flowLpm;
+            }
+            quiet = false;
+            return false;
+        }
+        if (!open) {
+            return false;
+        }
+        if (!quiet) {
+            // The event ends at its first quiet sample, if the quiet lasts
+            quiet = true;
+            quietMs = nowMs;
+            quietLitres = litres;
+        }
+        if (nowMs - quietMs < FLOW_EVENT_END_MS) {
+            return false;
+        }
+        open = false;
+        current.durationS = (quietMs - startMs) / 1000;
+        current.volumeL = (float)(quietLitres - startLitres);
+        current.use = classifyFlowEvent(current);
+
+        log[logHead] = current;
+        logHead = (logHead + 1) % FLOW_EVENT_LOG_SIZE;
+        if (logCount < FLOW_EVENT_LOG_SIZE) {
+            logCount++;
+        }
+        litresByUse[current.use] += current.volumeL;
+        countByUse[current.use]++;
+        return true;
+    }
+
+    const FlowEvent &last() const { return log[(logHead + FLOW_EVENT_LOG_SIZE - 1) % FLOW_EVENT_LOG_SIZE]; }
+
+    /* i = 0 is the oldest kept event */
+    const FlowEvent &event(uint8_t i) const
+    {
+        return log[(logHead + FLOW_EVENT_LOG_SIZE - logCount + i) % FLOW_EVENT_LOG_SIZE];
+    }
+    uint8_t eventCount() const { return logCount; }
+
+    float    litres(FlowEndUse u) const { return litresByUse[u]; }
+    uint32_t count(FlowEndUse u) const { return countByUse[u]; }
+
+    void resetTotals()
+    {
+        memset(litresByUse, 0, sizeof(litresByUse));
+        memset(countByUse, 0, sizeof(countByUse));
+    }
+
+    bool inEvent() const { return open; }
+
+private:
+    FlowEvent current = {};
+    bool      open = false;
+    bool      quiet = false;
+    uint32_t  startMs = 0;
+    uint32_t  quietMs = 0;
+    double    startLitres = 0;
+    double    quietLitres = 0;
+
+    FlowEvent log[FLOW_EVENT_LOG_SIZE] = {};
+    uint8_t   logHead = 0;
+    uint8_t   logCount = 0;
+    float     litresByUse[END_USE_CLASSES] = {};
+    uint32_t  countByUse[END_USE_CLASSES] = {};
+};
+
+#endif // FLOW_EVENTS_H
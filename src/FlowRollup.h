@@ -0,0 +1,221 @@
+#ifndef FLOW_ROLLUP_H
+#define FLOW_ROLLUP_H
+
+#include <Arduino.h>
+
+/* ─── Window layout ────────────────────────────────────────────────────── */
+enum RollupLevel : uint8_t
+{
+    ROLLUP_MINUTE,
+    ROLLUP_HOUR,
+    ROLLUP_DAY,
+    ROLLUP_MONTH,
+    ROLLUP_LEVELS
+};
+
+// Completed buckets kept per level
+constexpr uint8_t ROLLUP_DEPTH[ROLLUP_LEVELS] = {60, 24, 31, 12};
+constexpr const char *ROLLUP_NAMES[ROLLUP_LEVELS] = {"minute", "hour", "day", "month"};
+
+/* Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant) */
+constexpr int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d)
+{
+    return (y - (m <= 2)) / 400 * 146097 - 719468 +
+           (365 * ((y - (m <= 2)) % 400) + ((y - (m <= 2)) % 400) / 4 - ((y - (m <= 2)) % 400) / 100 +
+            (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1);
+}
+
+/* Year*12 + month-1 for a day number since 1970-01-01 */
+inline int32_t monthIndexFromDays(int32_t z)
+{
+    z += 719468;
+    int32_t era = z / 146097;
+    uint32_t doe = z - era * 146097;
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    uint32_t m = mp < 10 ? mp + 3 : mp - 9;
+    int32_t y = (int32_t)yoe + era * 400 + (m <= 2);
+    return y * 12 + (int32_t)m - 1;
+}
+
+/**
+ * Tumbling-window usage rollups at minute, hour, day and month resolution,
+ * driven by the cumulative meter reading. Each level tracks the meter value
+ * at the start of its open bucket and a fixed ring of completed buckets, so
+ * a sample costs O(1) unless it crosses a boundary. When samples are missed
+ * across one or more boundaries, the volume of the gap is spread over the
+ * skipped buckets in proportion to time instead of landing in whichever
+ * bucket happened to be open. Times are local-time epoch seconds, so
+ * buckets follow the local calendar.
+ */
+class FlowRollup
+{
+public:
+    /* Everything except the minute buckets, checkpointed to the state log */
+    struct Persisted
+    {
+        uint32_t lastT;                     // 0 = not started
+        uint32_t reserved;
+        double   lastMeter;
+        double   base[ROLLUP_LEVELS];       // meter at the start of the open bucket
+        int32_t  period[ROLLUP_LEVELS];     // open bucket's period number
+        uint8_t  head[ROLLUP_LEVELS];       // next write position in the ring
+        uint8_t  filled[ROLLUP_LEVELS];
+        float    hour[24];
+        float    day[31];
+        float    month[12];
+    };
+
+    /* Restores a checkpoint; the next update() fills the gap since it */
+    void restore(const Persisted &p)
+    {
+        state = p;
+        memset(minute, 0, sizeof(minute));
+        state.filled[ROLLUP_MINUTE] = 0;
+        state.head[ROLLUP_MINUTE] = 0;
+    }
+
+    const Persisted &persisted() const { return state; }
+
+    bool started() const { return state.lastT != 0; }
+
+    /**
+     * Feeds one meter reading.
+     * @param t     Local-time epoch seconds.
+     * @param meter Cumulative meter reading in litres.
+     * @return Bitmask of levels (1 << RollupLevel) that closed a bucket.
+     */
+    uint8_t update(uint32_t t, double meter)
+    {
+        if (!started() || t < state.lastT || meter < state.lastMeter) {
+            rebase(t, meter);     // first sample, clock stepped back or meter reset
+            return 0;
+        }
+        uint8_t closed = 0;
+        for (uint8_t l = 0; l < ROLLUP_LEVELS; l++) {
+            if (periodOf((RollupLevel)l, t) != state.period[l]) {
+                roll((RollupLevel)l, t, meter);
+                closed |= 1 << l;
+            }
+        }
+        state.lastT = t;
+        state.lastMeter = meter;
+        return closed;
+    }
+
+    /* Volume so far in the open bucket */
+    float current(RollupLevel l) const
+    {
+        return started() ? (float)(state.lastMeter - state.base[l]) : 0.0f;
+    }
+
+    /* Most recently completed bucket, 0 if none */
+    float last(RollupLevel l) const
+    {
+        const uint8_t depth = ROLLUP_DEPTH[l];
+        return state.filled[l] ? buckets(l)[(state.head[l] + depth - 1) % depth] : 0.0f;
+    }
+
+    /**
+     * Copies completed buckets oldest first.
+     * @return Number of buckets written to out (at most max).
+     */
+    uint8_t series(RollupLevel l, float *out, uint8_t max) const
+    {
+        const uint8_t depth = ROLLUP_DEPTH[l];
+        uint8_t n = state.filled[l] < max ? state.filled[l] : max;
+        uint8_t start = (state.head[l] + depth - n) % depth;
+        for (uint8_t i = 0; i < n; i++) {
+            out[i] = buckets(l)[(start + i) % depth];
+        }
+        return n;
+    }
+
+    /* Period number of the open bucket (minutes/hours/days since epoch, year*12+month) */
+    int32_t openPeriod(RollupLevel l) const { return state.period[l]; }
+
+    static int32_t periodOf(RollupLevel l, uint32_t t)
+    {
+        switch (l) {
+        case ROLLUP_MINUTE: return t / 60;
+        case ROLLUP_HOUR:   return t / 3600;
+        case ROLLUP_DAY:    return t / 86400;
+        default:            return monthIndexFromDays(t / 86400);
+        }
+    }
+
+    static uint32_t periodStart(RollupLevel l, int32_t p)
+    {
+        switch (l) {
+        case ROLLUP_MINUTE: return (uint32_t)p * 60;
+        case ROLLUP_HOUR:   return (uint32_t)p * 3600;
+        case ROLLUP_DAY:    return (uint32_t)p * 86400;
+        default:            return (uint32_t)daysFromCivil(p / 12, p % 12 + 1, 1) * 86400;
+        }
+    }
+
+private:
+    float *buckets(RollupLevel l)
+    {
+        switch (l) {
+        case ROLLUP_MINUTE: return minute;
+        case ROLLUP_HOUR:   return state.hour;
+        case ROLLUP_DAY:    return state.day;
+        default:            return state.month;
+        }
+    }
+    const float *buckets(RollupLevel l) const { return const_cast<FlowRollup *>(this)->buckets(l); }
+
+    void push(RollupLevel l, float volume)
+    {
+        buckets(l)[state.head[l]] = volume;
+        state.head[l] = (state.head[l] + 1) % ROLLUP_DEPTH[l];
+        if (state.filled[l] < ROLLUP_DEPTH[l]) {
+            state.filled[l]++;
+        }
+    }
+
+    /* Meter value interpolated at time x inside the gap since the last sample */
+    double meterAt(uint32_t x, uint32_t t, double meter) const
+    {
+        uint32_t gap = t - state.lastT;
+        if (!gap || x <= state.lastT) {
+            return state.lastMeter;
+        }
+        return state.lastMeter + (meter - state.lastMeter) * (double)(x - state.lastT) / gap;
+    }
+
+    /* Closes the open bucket and any skipped ones up to the bucket holding t */
+    void roll(RollupLevel l, uint32_t t, double meter)
+    {
+        int32_t p = periodOf(l, t);
+        int32_t q = state.period[l];
+        // Skipped buckets beyond the ring depth would be overwritten anyway
+        if (p - q > ROLLUP_DEPTH[l] + 1) {
+            q = p - ROLLUP_DEPTH[l] - 1;
+            state.base[l] = meterAt(periodStart(l, q), t, meter);
+        }
+        for (; q < p; q++) {
+            double end = meterAt(periodStart(l, q + 1), t, meter);
+            push(l, (float)(end - state.base[l]));
+            state.base[l] = end;
+        }
+        state.period[l] = p;
+    }
+
+    void rebase(uint32_t t, double meter)
+    {
+        for (uint8_t l = 0; l < ROLLUP_LEVELS; l++) {
+            state.period[l] = periodOf((RollupLevel)l, t);
+            state.base[l] = meter;
+        }
+        state.lastT = t;
+        state.lastMeter = meter;
+    }
+
+    Persisted state = {};
+    float     minute[60] = {};
+};
+
+#endif // FLOW_ROLLUP_H
@@ -65,6 +65,7 @@ bool readFlowSensorData(byte *command, size_t commandSize, float &flowrate, doub
             debugln("Timeout waiting for data");
             return false;
         }
+        delay(1); // yield to the safety task instead of spinning
     }
 
     delay(50);
@@ -0,0 +1,125 @@
+#ifndef FLOW_TOTALISER_H
+#define FLOW_TOTALISER_H
+
+#include <Arduino.h>
+
+/* ─── Meter model ──────────────────────────────────────────────────────── */
+constexpr double   METER_ROLLOVER_L      = 1e9;     // 9 integer BCD digits on the register
+constexpr double   METER_MAX_LPM         = 200.0;   // nothing plausible flows faster
+constexpr double   METER_STEP_SLACK_L    = 1.0;     // register resolution and timing jitter
+constexpr double   METER_BOOT_GRACE_L    = 50.0;    // largest post-reset reading accepted right after boot
+constexpr uint8_t  METER_REBASE_AFTER    = 3;       // consecutive implausible reads before re-baselining
+
+/**
+ * 64-bit monotonic volume totaliser in millilitres, stitched from the
+ * meter's cumulative register. Register drops are classified as rollover
+ * (wrapped near the top of the register) or reset (restarted near zero,
+ * e.g. after V11); the volume either side is still counted. Readings that
+ * imply an impossible flow are ignored, and if they persist the register
+ * is re-baselined without counting the jump. Persist the state on every
+ * reset/rollover and periodically; after a reboot the first reading counts
+ * whatever flowed while the device was down.
+ */
+class FlowTotaliser
+{
+public:
+    struct Persisted
+    {
+        uint64_t totalMl;
+        double   lastMeter;     // register value the total was last stitched at
+        uint32_t resets;
+        uint32_t rollovers;
+        uint8_t  hasMeter;
+        uint8_t  reserved[7];
+    };
+
+    void restore(const Persisted &p)
+    {
+        state = p;
+        rejectRun = 0;
+        lastUpdateMs = 0;
+    }
+
+    const Persisted &persisted() const { return state; }
+
+    /**
+     * Stitches a new register reading into the total.
+     * @param meter Register value in litres.
+     * @param nowMs Sample time, used to bound plausible steps.
+     * @return True if the reading changed the baseline in a way that should
+     *         be checkpointed now (reset, rollover or re-baseline).
+     */
+    bool update(double meter, uint32_t nowMs)
+    {
+        if (meter < 0 || meter >= METER_ROLLOVER_L) {
+            rejected++;
+            return false;
+        }
+        uint32_t dtMs = lastUpdateMs ? nowMs - lastUpdateMs : 0;
+        if (!state.hasMeter) {
+            state.hasMeter = 1;
+            state.lastMeter = meter;
+            lastUpdateMs = nowMs;
+            return true;
+        }
+
+        // Without a previous sample this boot, the downtime is unknown: any forward step counts
+        double maxStep = dtMs ? METER_MAX_LPM * dtMs / 60000.0 + METER_STEP_SLACK_L : METER_ROLLOVER_L;
+        double delta = meter - state.lastMeter;
+        bool checkpoint = false;
+        if (delta < 0) {
+            // Across unknown downtime only small post-reset/post-wrap readings are trusted
+            double backStep = dtMs ? maxStep : METER_BOOT_GRACE_L;
+            double wrapped = METER_ROLLOVER_L - state.lastMeter + meter;
+            if (state.lastMeter >= METER_ROLLOVER_L * 0.9 && wrapped <= backStep) {
+                delta = wrapped;
+                state.rollovers++;
+                checkpoint = true;
+            } else if (meter <= backStep) {
+                delta = meter;              // register restarted from zero
+                state.resets++;
+                checkpoint = true;
+            } else {
+                return reject(meter, nowMs);
+            }
+        } else if (delta > maxStep) {
+            return reject(meter, nowMs);
+        }
+
+        state.totalMl += (uint64_t)(delta * 1000.0 + 0.5);
+        state.lastMeter = meter;
+        lastUpdateMs = nowMs;
+        rejectRun = 0;
+        return checkpoint;
+    }
+
+    uint64_t totalMl() const { return state.totalMl; }
+    double   litres() const { return state.totalMl / 1000.0; }
+    uint32_t resets() const { return state.resets; }
+    uint32_t rollovers() const { return state.rollovers; }
+    uint32_t rejectedReads() const { return rejected; }
+    uint32_t rebases() const { return rebaseCount; }
+
+private:
+    bool reject(double meter, uint32_t nowMs)
+    {
+        rejected++;
+        if (++rejectRun < METER_REBASE_AFTER) {
+            return false;
+        }
+        // The register really did jump; follow it without counting the jump
+        state.lastMeter = meter;
+        lastUpdateMs = nowMs;
+        rejectRun = 0;
+        rebaseCount++;
+        return true;
+    }
+
+    Persisted state = {};
+    uint32_t  lastUpdateMs = 0;
+    uint32_t  rejected = 0;
+    uint32_t  rebaseCount = 0;
+    uint8_t   rejectRun = 0;
+};
+
+#endif // FLOW_TOTALISER_H
@@ -0,0 +1,407 @@
+#ifndef HEAP_TRACKER_H
+#define HEAP_TRACKER_H
+
+#include <Arduino.h>
+#include <math.h>
+#include <atomic>
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #include "esp_heap_caps.h"
+}
+
+/* ─── Subsystem tags ───────────────────────────────────────────────────── */
+enum AllocTag : uint8_t
+{
+    ALLOC_UNTAGGED,       // Wi-Fi, TLS, libraries: everything outside a scope
+    ALLOC_SAFETY,         // burst / continuous-flow checks and lockout alerts
+    ALLOC_DISPLAY,        // debug output of the sample
+    ALLOC_BLOCKAGE,       // processData() and the blockage detector
+    ALLOC_USAGE,          // rollups, night flow, flow events
+    ALLOC_EDGENT,         // BlynkEdgent.run() and the console
+    ALLOC_CLOUD,          // events, reports, backfill
+    ALLOC_TAGS
+};
+
+constexpr const char *ALLOC_TAG_NAMES[ALLOC_TAGS] = {
+    "untagged", "safety", "display", "blockage", "usage", "edgent", "cloud"};
+
+constexpr uint16_t HEAP_TRACK_SLOTS   = 256;   // live tagged blocks tracked at once (power of two)
+constexpr uint8_t  HEAP_TRACK_TASKS   = 4;     // tasks that may open scopes
+
+/**
+ * Attributes heap traffic to subsystems. Code opens an AllocScope for its
+ * tag; the malloc/free hooks look up the running task's tag and, inside a
+ * scope, remember the block in a fixed open-addressing table so the free
+ * is credited back to the same subsystem even when another task releases
+ * it (e.g. an event String built by the safety task and sent by the
+ * cloud task). Allocations outside any scope are not tracked, so Wi-Fi
+ * and TLS traffic only pays for a counter check. The hooks need the
+ * linker to wrap malloc/calloc/realloc/free and HEAP_TRACKING defined;
+ * without them the scopes cost nothing and the stats stay at zero.
+ */
+class HeapTracker
+{
+public:
+    struct TagStats
+    {
+        uint32_t allocs;
+        uint32_t frees;
+        uint32_t failed;
+        uint32_t liveBytes;
+        uint32_t peakBytes;
+        uint64_t totalBytes;
+    };
+
+    /* Sets the calling task's tag; returns the previous one for leave() */
+    AllocTag enter(AllocTag tag)
+    {
+        Slot *s = taskSlot(true);
+        if (!s) {
+            return ALLOC_UNTAGGED;
+        }
+        AllocTag prev = s->tag;
+        s->tag = tag;
+        scopeDepth++;
+        return prev;
+    }
+
+    void leave(AllocTag prev)
+    {
+        Slot *s = taskSlot(false);
+        if (s) {
+            s->tag = prev;
+            scopeDepth--;
+        }
+    }
+
+    /* Hook side: p was just returned by the allocator for size bytes */
+    void onAlloc(void *p, size_t size)
+    {
+        AllocTag tag = currentTag();
+        if (tag == ALLOC_UNTAGGED) {
+            return;
+        }
+        portENTER_CRITICAL(&mux);
+        TagStats &st = stats[tag];
+        if (!p) {
+            st.failed++;
+        } else if (insert(p, size, tag)) {
+            st.allocs++;
+            st.totalBytes += size;
+            st.liveBytes += size;
+            if (st.liveBytes > st.peakBytes) {
+                st.peakBytes = st.liveBytes;
+            }
+        } else {
+            overflow++;
+        }
+        portEXIT_CRITICAL(&mux);
+    }
+
+    /* Hook side: p is about to be released */
+    void onFree(void *p)
+    {
+        if (!p || !tracked) {
+            return;
+        }
+        portENTER_CRITICAL(&mux);
+        uint16_t i;
+        if (find(p, i)) {
+            TagStats &st = stats[table[i].tag];
+            st.frees++;
+            st.liveBytes -= table[i].size;
+            remove(i);
+        }
+        portEXIT_CRITICAL(&mux);
+    }
+
+    /* Copy taken under the lock: the hooks update it from every task */
+    TagStats tagStats(AllocTag t)
+    {
+        portENTER_CRITICAL(&mux);
+        TagStats copy = stats[t];
+        portEXIT_CRITICAL(&mux);
+        return copy;
+    }
+    uint16_t trackedBlocks() const { return tracked; }
+    uint32_t overflows() const { return overflow; }
+
+    static bool enabled()
+    {
+#ifdef HEAP_TRACKING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+private:
+    struct Slot
+    {
+        TaskHandle_t task;
+        AllocTag     tag;
+    };
+
+    struct Entry
+    {
+        void    *ptr;        // nullptr = empty
+        uint32_t size : 24;
+        uint32_t tag  : 8;
+    };
+
+    Slot *taskSlot(bool claim)
+    {
+        TaskHandle_t self = xTaskGetCurrentTaskHandle();
+        if (!self) {
+            return nullptr;  // before the scheduler runs
+        }
+        for (Slot &s : tasks) {
+            if (s.task == self) {
+                return &s;
+            }
+        }
+        if (!claim) {
+            return nullptr;
+        }
+        Slot *found = nullptr;
+        portENTER_CRITICAL(&mux);
+        for (Slot &s : tasks) {
+            if (!s.task) {
+                s.task = self;
+                s.tag = ALLOC_UNTAGGED;
+                found = &s;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&mux);
+        return found;
+    }
+
+    AllocTag currentTag()
+    {
+        if (!scopeDepth || xPortInIsrContext()) {
+            return ALLOC_UNTAGGED;
+        }
+        Slot *s = taskSlot(false);
+        return s ? s->tag : ALLOC_UNTAGGED;
+    }
+
+    static uint16_t hash(const void *p)
+    {
+        return (uint16_t)((((uintptr_t)p >> 3) * 2654435761u) >> 16) & (HEAP_TRACK_SLOTS - 1);
+    }
+
+    bool insert(void *p, size_t size, AllocTag tag)
+    {
+        if (tracked >= HEAP_TRACK_SLOTS - HEAP_TRACK_SLOTS / 8) {
+            return false;  // keep probes short
+        }
+        uint16_t i = hash(p);
+        while (table[i].ptr) {
+            i = (i + 1) & (HEAP_TRACK_SLOTS - 1);
+        }
+        table[i].ptr = p;
+        table[i].size = size < 0xFFFFFF ? size : 0xFFFFFF;
+        table[i].tag = tag;
+        tracked++;
+        return true;
+    }
+
+    bool find(const void *p, uint16_t &i) const
+    {
+        for (i = hash(p); table[i].ptr; i = (i + 1) & (HEAP_TRACK_SLOTS - 1)) {
+            if (table[i].ptr == p) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Backward-shift deletion keeps every probe chain unbroken without tombstones */
+    void remove(uint16_t i)
+    {
+        uint16_t j = i;
+        for (;;) {
+            table[i].ptr = nullptr;
+            for (;;) {
+                j = (j + 1) & (HEAP_TRACK_SLOTS - 1);
+                if (!table[j].ptr) {
+                    tracked--;
+                    return;
+                }
+                uint16_t home = hash(table[j].ptr);
+                // Entry j may move into the hole only if its home is not in (i, j]
+                bool between = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+                if (!between) {
+                    break;
+                }
+            }
+            table[i] = table[j];
+            i = j;
+        }
+    }
+
+    portMUX_TYPE          mux = portMUX_INITIALIZER_UNLOCKED;
+    Slot                  tasks[HEAP_TRACK_TASKS] = {};
+    std::atomic<uint16_t> scopeDepth{0};   // open scopes across all tasks
+    volatile uint16_t     tracked = 0;
+    uint32_t              overflow = 0;
+    Entry                 table[HEAP_TRACK_SLOTS] = {};
+    TagStats              stats[ALLOC_TAGS] = {};
+};
+
+HeapTracker heapTracker;
+
+/* Attributes allocations made until the end of the enclosing block */
+class AllocScope
+{
+public:
+    explicit AllocScope(AllocTag tag) : prev(heapTracker.enter(tag)) {}
+    ~AllocScope() { heapTracker.leave(prev); }
+    AllocScope(const AllocScope &) = delete;
+    AllocScope &operator=(const AllocScope &) = delete;
+
+private:
+    AllocTag prev;
+};
+
+#ifdef HEAP_TRACKING
+/* Linked in with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free */
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void  __real_free(void *p);
+
+void *__wrap_malloc(size_t size)
+{
+    void *p = __real_malloc(size);
+    heapTracker.onAlloc(p, size);
+    return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *p = __real_calloc(n, size);
+    heapTracker.onAlloc(p, n * size);
+    return p;
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    // Credited as a free of the old block and an allocation of the new one. The
+    // old entry goes first: once realloc moves the block its address can be
+    // handed to another task before this one gets to update the table.
+    heapTracker.onFree(p);
+    void *q = __real_realloc(p, size);
+    if (size) {
+        heapTracker.onAlloc(q, size);
+    }
+    return q;
+}
+
+void __wrap_free(void *p)
+{
+    heapTracker.onFree(p);
+    __real_free(p);
+}
+}
+#endif
+
+/* ─── Fragmentation trend ──────────────────────────────────────────────── */
+constexpr uint32_t HEAP_TREND_PERIOD_MS = 15UL * 60 * 1000;   // one point per 15 min
+constexpr uint8_t  HEAP_TREND_DEPTH     = 96;                  // 24 h of points
+constexpr uint8_t  HEAP_TREND_MIN_POINTS = 8;                  // fewer than this gives no slope
+constexpr uint32_t HEAP_LARGEST_FLOOR   = 16384;               // contiguous block a TLS reconnect needs
+constexpr float    HEAP_WARN_DAYS       = 7.0f;                // warn when the floor is this close
+
+/**
+ * Ring of free heap / largest free block samples. A falling largest block
+ * while free heap stays flat is fragmentation, which is what eventually
+ * fails a TLS handshake after weeks of uptime; the least-squares slope
+ * over the ring projects how long the current trend leaves before the
+ * largest block drops below a given size.
+ */
+class HeapTrend
+{
+public:
+    struct Point
+    {
+        uint32_t tS;         // uptime seconds
+        uint32_t freeBytes;
+        uint32_t largestBlock;
+    };
+
+    /* Adds a point if a period has passed since the last one */
+    bool sample(uint32_t nowMs, uint32_t freeBytes, uint32_t largestBlock)
+    {
+        if (count && nowMs - lastMs < HEAP_TREND_PERIOD_MS) {
+            return false;
+        }
+        lastMs = nowMs;
+        points[head] = {nowMs / 1000, freeBytes, largestBlock};
+        head = (head + 1) % HEAP_TREND_DEPTH;
+        if (count < HEAP_TREND_DEPTH) {
+            count++;
+        }
+        if (!lowestLargest || largestBlock < lowestLargest) {
+            lowestLargest = largestBlock;
+        }
+        return true;
+    }
+
+    uint8_t  pointCount() const { return count; }
+    uint32_t lowestLargestBlock() const { return lowestLargest; }
+
+    /* i = 0 is the oldest point */
+    const Point &point(uint8_t i) const { return points[(head + HEAP_TREND_DEPTH - count + i) % HEAP_TREND_DEPTH]; }
+    const Point &latest() const { return point(count - 1); }
+
+    /* Bytes per day; NAN until enough points exist */
+    float largestSlopePerDay() const { return slope(&Point::largestBlock); }
+    float freeSlopePerDay() const { return slope(&Point::freeBytes); }
+
+    /* Days until the largest block falls below floorBytes; INFINITY if not falling */
+    float daysUntil(uint32_t floorBytes) const
+    {
+        float s = largestSlopePerDay();
+        if (isnan(s) || s >= 0) {
+            return INFINITY;
+        }
+        uint32_t now = latest().largestBlock;
+        return now > floorBytes ? (now - floorBytes) / -s : 0.0f;
+    }
+
+private:
+    float slope(uint32_t Point::*field) const
+    {
+        if (count < HEAP_TREND_MIN_POINTS) {
+            return NAN;
+        }
+        // Centred on the first point so the sums stay well inside float range
+        const Point &first = point(0);
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            const Point &p = point(i);
+            double x = (p.tS - first.tS) / 86400.0;
+            double y = (double)(p.*field) - (double)(first.*field);
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+        }
+        double d = count * sxx - sx * sx;
+        return d > 0 ? (float)((count * sxy - sx * sy) / d) : NAN;
+    }
+
+    Point    points[HEAP_TREND_DEPTH] = {};
+    uint8_t  head = 0;
+    uint8_t  count = 0;
+    uint32_t lastMs = 0;
+    uint32_t lowestLargest = 0;
+};
+
+HeapTrend heapTrend;
+
+#endif // HEAP_TRACKER_H
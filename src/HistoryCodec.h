@@ -0,0 +1,216 @@
+#ifndef HISTORY_CODEC_H
+#define HISTORY_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// No Arduino dependencies: tools/history_decode.cpp builds this on the host.
+
+/* ─── Columns (fixed point, as stored in BufferedSample) ───────────────── */
+enum HistoryColumn : uint8_t
+{
+    HIST_TIME,               // UTC ms
+    HIST_FLOW,               // 0.01 L/min
+    HIST_TOTAL,              // 0.1 L cumulative
+    HIST_PRESSURE1,          // 0.1 kPa
+    HIST_PRESSURE2,          // 0.1 kPa
+    HIST_UV,                 // 0.01 mW/cm²
+    HIST_DOSE,               // 0.1 mJ/cm²
+    HIST_BLOCKAGE,           // 0.1 %
+    HIST_COLUMNS
+};
+
+constexpr const char *HIST_COLUMN_NAMES[HIST_COLUMNS] = {
+    "time_ms", "flow_lpm", "total_l", "p1_kpa", "p2_kpa", "uv_mw_cm2", "dose_mj_cm2", "blockage_pct"};
+constexpr float HIST_COLUMN_SCALE[HIST_COLUMNS] = {1.0f, 0.01f, 0.1f, 0.1f, 0.1f, 0.01f, 0.1f, 0.1f};
+
+constexpr uint8_t HIST_MAGIC[4]   = {'H', 'G', 'H', 1};   // format name + version
+constexpr uint8_t HIST_BLOCK_ROWS = 16;                   // rows per column block
+constexpr size_t  HIST_OUT_CHUNK  = 96;                   // encoder output buffer
+
+struct HistoryRow
+{
+    int64_t v[HIST_COLUMNS];
+};
+
+inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+/**
+ * Streaming encoder for sample history. The stream is the magic, then
+ * blocks of up to HIST_BLOCK_ROWS rows stored column by column, then a
+ * zero row count. Every value is a zigzag varint: the timestamp as the
+ * change in the sample interval (one byte while the cadence holds), the
+ * other columns as the change from the previous row. Predictions carry
+ * across blocks, so a steady 5 s stream costs about one byte per value.
+ * Only the current block is held; rows can come straight off a ring
+ * buffer and output leaves through the write callback in small chunks.
+ */
+class HistoryEncoder
+{
+public:
+    /* Returns false to abort the stream (e.g. the transport failed) */
+    typedef bool (*WriteFn)(void *ctx, const uint8_t *data, size_t len);
+
+    bool begin(WriteFn fn, void *fnCtx)
+    {
+        write = fn;
+        ctx = fnCtx;
+        count = 0;
+        outLen = 0;
+        rowCount = 0;
+        byteCount = 0;
+        ok = true;
+        memset(prev, 0, sizeof(prev));
+        prevInterval = 0;
+        return put(HIST_MAGIC, sizeof(HIST_MAGIC));
+    }
+
+    bool add(const HistoryRow &row)
+    {
+        block[count++] = row;
+        rowCount++;
+        return count < HIST_BLOCK_ROWS || emitBlock();
+    }
+
+    /* Emits the partial block and the terminator; false if any write failed */
+    bool finish()
+    {
+        if (count && !emitBlock()) {
+            return false;
+        }
+        putVarint(0);
+        return flush();
+    }
+
+    uint32_t rows() const { return rowCount; }
+    uint32_t bytes() const { return byteCount + outLen; }
+
+private:
+    bool emitBlock()
+    {
+        putVarint(count);
+        for (uint8_t c = 0; c < HIST_COLUMNS; c++) {
+            for (uint8_t i = 0; i < count; i++) {
+                int64_t v = block[i].v[c];
+                if (c == HIST_TIME) {
+                    int64_t interval = v - prev[c];
+                    putVarint(zigzag(interval - prevInterval));
+                    prevInterval = interval;
+                } else {
+                    putVarint(zigzag(v - prev[c]));
+                }
+                prev[c] = v;
+            }
+        }
+        count = 0;
+        return ok;
+    }
+
+    void putVarint(uint64_t v)
+    {
+        uint8_t b[10];
+        size_t n = 0;
+        while (v >= 0x80) {
+            b[n++] = (uint8_t)v | 0x80;
+            v >>= 7;
+        }
+        b[n++] = (uint8_t)v;
+        put(b, n);
+    }
+
+    bool put(const uint8_t *data, size_t len)
+    {
+        if (outLen + len > sizeof(out)) {
+            flush();
+        }
+        memcpy(out + outLen, data, len);
+        outLen += len;
+        return ok;
+    }
+
+    bool flush()
+    {
+        if (outLen && ok) {
+            ok = write(ctx, out, outLen);
+        }
+        byteCount += outLen;
+        outLen = 0;
+        return ok;
+    }
+
+    WriteFn    write = nullptr;
+    void      *ctx = nullptr;
+    HistoryRow block[HIST_BLOCK_ROWS];
+    uint8_t    count = 0;
+    int64_t    prev[HIST_COLUMNS] = {};
+    int64_t    prevInterval = 0;
+    uint8_t    out[HIST_OUT_CHUNK];
+    size_t     outLen = 0;
+    uint32_t   rowCount = 0;
+    uint32_t   byteCount = 0;
+    bool       ok = true;
+};
+
+/**
+ * Decodes a complete stream produced by HistoryEncoder.
+ * @return Rows decoded, or -1 if the stream is malformed or truncated.
+ */
+inline long decodeHistory(const uint8_t *data, size_t len, void (*fn)(void *ctx, const HistoryRow &row), void *ctx)
+{
+    size_t pos = 0;
+    auto varint = [&](uint64_t &v) {
+        v = 0;
+        for (uint8_t shift = 0; shift < 64; shift += 7) {
+            if (pos >= len) {
+                return false;
+            }
+            uint8_t b = data[pos++];
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (len < sizeof(HIST_MAGIC) || memcmp(data, HIST_MAGIC, sizeof(HIST_MAGIC))) {
+        return -1;
+    }
+    pos = sizeof(HIST_MAGIC);
+    int64_t prev[HIST_COLUMNS] = {};
+    int64_t prevInterval = 0;
+    long rows = 0;
+    for (;;) {
+        uint64_t n;
+        if (!varint(n) || n > HIST_BLOCK_ROWS) {
+            return -1;
+        }
+        if (!n) {
+            return rows;
+        }
+        HistoryRow block[HIST_BLOCK_ROWS];
+        for (uint8_t c = 0; c < HIST_COLUMNS; c++) {
+            for (uint8_t i = 0; i < n; i++) {
+                uint64_t z;
+                if (!varint(z)) {
+                    return -1;
+                }
+                if (c == HIST_TIME) {
+                    prevInterval += unzigzag(z);
+                    prev[c] += prevInterval;
+                } else {
+                    prev[c] += unzigzag(z);
+                }
+                block[i].v[c] = prev[c];
+            }
+        }
+        for (uint8_t i = 0; i < n; i++) {
+            fn(ctx, block[i]);
+        }
+        rows += n;
+    }
+}
+
+#endif // HISTORY_CODEC_H
@@ -0,0 +1,440 @@
+#ifndef LAN_STREAM_H
+#define LAN_STREAM_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include "BroadcastRing.h"
+#include "Pipeline.h"
+
+/* ─── Endpoint ─────────────────────────────────────────────────────────── */
+constexpr uint16_t LAN_STREAM_PORT        = 8080;
+constexpr uint8_t  LAN_MAX_CLIENTS        = 3;
+constexpr size_t   LAN_CHUNK_MAX          = 1400;    // payload per HTTP chunk, about one TCP segment
+constexpr size_t   LAN_CHUNK_HEAD         = 8;       // room for "<hex>\r\n" in front of a chunk
+constexpr uint32_t LAN_REQUEST_TIMEOUT_MS = 3000;
+constexpr uint32_t LAN_STALL_TIMEOUT_MS   = 15000;   // nothing accepted by the socket → dropped
+
+/* ─── Taps ─────────────────────────────────────────────────────────────── */
+constexpr size_t SAMPLE_TAP_LEN           = 16;      // last 80 s of samples
+constexpr size_t PRESSURE_TRACE_LEN       = 256;     // last ~5 s of trace at TRACE_PERIOD_MS
+
+/* One unfiltered reading of both pressure channels */
+typedef struct
+{
+    int64_t  acquiredUs;
+    uint64_t epochMs;        // 0 before the clock is set
+    float    pressure1;      // kPa
+    float    pressure2;      // kPa
+} PressurePoint_t;
+
+// Written by the acquisition task only; read by every stream client in place
+BroadcastRing<Sample_t, SAMPLE_TAP_LEN>            sampleTap;
+BroadcastRing<PressurePoint_t, PRESSURE_TRACE_LEN> pressureTrace;
+
+/* ─── Binary frames: type, payload length, little-endian payload ───────── */
+enum LanFrameType : uint8_t
+{
+    LAN_FRAME_SAMPLE = 1,    // u64 epochMs, i64 acquiredUs, f32 flow, f64 total, u16 uv, f32 p1, f32 p2, u8 valid
+    LAN_FRAME_TRACE  = 2,    // u64 epochMs, i64 acquiredUs, f32 p1, f32 p2
+    LAN_FRAME_GAP    = 3     // u8 frame type, u32 records skipped
+};
+
+/**
+ * Read-only HTTP streaming endpoint for on-site tools:
+ *
+ *   GET /stream               chunked NDJSON, one record per line
+ *   GET /stream?format=bin    chunked binary frames (LanFrameType)
+ *
+ * Every client walks the shared taps with its own cursors, encoding
+ * straight from the ring into its one outgoing chunk; there is no
+ * per-client queue. Sockets are written non-blocking, so a client that
+ * reads slowly only ever holds back its own cursors. If it falls further
+ * behind than a tap holds, it skips to the oldest record still there and
+ * receives a gap record with the count it missed. The acquisition task
+ * is never slowed by a client. All socket work runs on one low-priority
+ * task on the Wi-Fi core.
+ */
+class LanStream
+{
+public:
+    struct Stats
+    {
+        uint32_t accepted;
+        uint32_t rejected;       // bad request or no free slot
+        uint32_t stalled;        // dropped after LAN_STALL_TIMEOUT_MS
+        uint32_t gaps;           // records clients were lapped on
+    };
+
+    struct ClientInfo
+    {
+        bool     streaming;
+        bool     binary;
+        uint32_t ip;
+        uint32_t ageS;
+        uint32_t bytes;
+        uint32_t lag;            // records published but not yet sent
+        uint32_t gaps;
+    };
+
+    /* LAN task: accepts, parses requests and pushes data; call every few ms */
+    void poll(uint32_t now, bool netUp)
+    {
+        if (!netUp) {
+            for (Client &c : clients) {
+                release(c);
+            }
+            return;
+        }
+        if (!isListening) {
+            server.begin(LAN_STREAM_PORT);
+            server.setNoDelay(true);
+            isListening = true;
+        }
+        accept(now);
+        for (Client &c : clients) {
+            if (c.state == CLIENT_REQUEST) {
+                readRequest(c, now);
+            } else if (c.state == CLIENT_STREAM) {
+                service(c, now);
+            }
+        }
+    }
+
+    /* True while a client is connected, so the acquisition task traces pressure */
+    bool tracing() const { return streaming > 0; }
+
+    bool listening() const { return isListening; }
+
+    bool client(uint8_t i, ClientInfo &info) const
+    {
+        const Client &c = clients[i];
+        if (c.state == CLIENT_FREE) {
+            return false;
+        }
+        info.streaming = c.state == CLIENT_STREAM;
+        info.binary = c.binary;
+        info.ip = c.ip;
+        info.ageS = (millis() - c.openedMs) / 1000;
+        info.bytes = c.bytes;
+        info.lag = (sampleTap.head() - c.sampleSeq) + (pressureTrace.head() - c.traceSeq);
+        info.gaps = c.gapTotal;
+        return true;
+    }
+
+    const Stats &stats() const { return stat; }
+
+private:
+    enum ClientState : uint8_t
+    {
+        CLIENT_FREE,
+        CLIENT_REQUEST,
+        CLIENT_STREAM
+    };
+
+    struct Client
+    {
+        WiFiClient  sock;
+        ClientState state;
+        bool        binary;
+        uint32_t    ip;
+        uint32_t    openedMs;
+        uint32_t    progressMs;          // last time the socket took bytes
+        uint32_t    sampleSeq;
+        uint32_t    traceSeq;
+        uint32_t    sampleGap;           // skipped, not yet reported
+        uint32_t    traceGap;
+        uint32_t    gapTotal;
+        uint32_t    bytes;
+        uint16_t    start;               // unsent bytes are out[start, end)
+        uint16_t    end;
+        uint8_t     out[LAN_CHUNK_HEAD + LAN_CHUNK_MAX + 2];
+    };
+
+    void accept(uint32_t now)
+    {
+        WiFiClient sock = server.available();
+        if (!sock) {
+            return;
+        }
+        for (Client &c : clients) {
+            if (c.state == CLIENT_FREE) {
+                c.sock = sock;
+                c.state = CLIENT_REQUEST;
+                c.ip = (uint32_t)sock.remoteIP();
+                c.openedMs = c.progressMs = now;
+                c.start = c.end = 0;
+                c.out[0] = '\0';
+                c.bytes = 0;
+                stat.accepted++;
+                return;
+            }
+        }
+        reply(sock, "503 Service Unavailable");
+        sock.stop();
+        stat.rejected++;
+    }
+
+    /* Collects the request head in the (still unused) output buffer */
+    void readRequest(Client &c, uint32_t now)
+    {
+        size_t room = sizeof(c.out) - 1 - c.end;
+        int n = recv(c.sock.fd(), c.out + c.end, room, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            release(c);
+            return;
+        }
+        if (n > 0) {
+            c.end += n;
+            c.out[c.end] = '\0';
+        }
+        const char *req = (const char *)c.out;
+        if (!strstr(req, "\r\n\r\n")) {
+            if (c.end >= sizeof(c.out) - 1 || now - c.openedMs > LAN_REQUEST_TIMEOUT_MS) {
+                reject(c, "400 Bad Request");
+            }
+            return;
+        }
+        if (strncmp(req, "GET /stream", 11) || (req[11] != ' ' && req[11] != '?')) {
+            reject(c, "404 Not Found");
+            return;
+        }
+        const char *eol = strstr(req, "\r\n");
+        const char *fmt = strstr(req, "format=bin");
+        c.binary = fmt && fmt < eol;
+
+        c.start = 0;
+        c.end = snprintf((char *)c.out, sizeof(c.out),
+                         "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: %s\r\n"
+                         "Transfer-Encoding: chunked\r\n"
+                         "Cache-Control: no-store\r\n"
+                         "Connection: close\r\n\r\n",
+                         c.binary ? "application/octet-stream" : "application/x-ndjson");
+        // Start from the latest sample so the client has values at once; the trace is live only
+        uint32_t head = sampleTap.head();
+        c.sampleSeq = head ? head - 1 : 0;
+        c.traceSeq = pressureTrace.head();
+        c.sampleGap = c.traceGap = c.gapTotal = 0;
+        c.progressMs = now;
+        c.state = CLIENT_STREAM;
+        streaming++;
+    }
+
+    void service(Client &c, uint32_t now)
+    {
+        // Anything the client sends after the request is drained; EOF ends the stream
+        uint8_t scratch[32];
+        int n = recv(c.sock.fd(), scratch, sizeof(scratch), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            release(c);
+            return;
+        }
+
+        if (c.start == c.end) {
+            fill(c);
+        }
+        if (c.start == c.end) {
+            c.progressMs = now;   // idle, not stalled
+            return;
+        }
+        n = send(c.sock.fd(), c.out + c.start, c.end - c.start, MSG_DONTWAIT);
+        if (n > 0) {
+            c.start += n;
+            c.bytes += n;
+            c.progressMs = now;
+        } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            release(c);
+        } else if (now - c.progressMs > LAN_STALL_TIMEOUT_MS) {
+            stat.stalled++;
+            release(c);
+        }
+    }
+
+    /* Encodes the next chunk from the taps, oldest records first */
+    void fill(Client &c)
+    {
+        skipLapped(c.sampleSeq, sampleTap.tail(), c.sampleGap, c);
+        skipLapped(c.traceSeq, pressureTrace.tail(), c.traceGap, c);
+
+        uint8_t *p = c.out + LAN_CHUNK_HEAD;
+        size_t used = 0;
+        if (c.sampleGap && encodeGap(c, p, used, LAN_FRAME_SAMPLE, c.sampleGap)) {
+            c.sampleGap = 0;
+        }
+        if (c.traceGap && encodeGap(c, p, used, LAN_FRAME_TRACE, c.traceGap)) {
+            c.traceGap = 0;
+        }
+
+        Sample_t s;
+        while (c.sampleSeq != sampleTap.head()) {
+            if (!sampleTap.read(c.sampleSeq, s)) {
+                skipLapped(c.sampleSeq, sampleTap.tail(), c.sampleGap, c);
+                continue;
+            }
+            if (!encodeSample(c, p, used, s)) {
+                break;
+            }
+            c.sampleSeq++;
+        }
+        PressurePoint_t t;
+        while (c.traceSeq != pressureTrace.head()) {
+            if (!pressureTrace.read(c.traceSeq, t)) {
+                skipLapped(c.traceSeq, pressureTrace.tail(), c.traceGap, c);
+                continue;
+            }
+            if (!encodeTrace(c, p, used, t)) {
+                break;
+            }
+            c.traceSeq++;
+        }
+        if (!used) {
+            c.start = c.end = 0;
+            return;
+        }
+
+        // Chunk framing around the payload: "<hex>\r\n" payload "\r\n"
+        char head[LAN_CHUNK_HEAD + 1];
+        int h = snprintf(head, sizeof(head), "%X\r\n", (unsigned)used);
+        c.start = LAN_CHUNK_HEAD - h;
+        memcpy(c.out + c.start, head, h);
+        memcpy(p + used, "\r\n", 2);
+        c.end = LAN_CHUNK_HEAD + used + 2;
+    }
+
+    void skipLapped(uint32_t &seq, uint32_t tail, uint32_t &gap, Client &c)
+    {
+        if ((int32_t)(seq - tail) < 0) {
+            uint32_t missed = tail - seq;
+            gap += missed;
+            c.gapTotal += missed;
+            stat.gaps += missed;
+            seq = tail;
+        }
+    }
+
+    /* Each encoder appends one record if it fits, else leaves the chunk as is */
+
+    bool encodeSample(const Client &c, uint8_t *p, size_t &used, const Sample_t &s)
+    {
+        if (c.binary) {
+            uint8_t f[2 + 39];
+            uint8_t *q = f;
+            *q++ = LAN_FRAME_SAMPLE;
+            *q++ = sizeof(f) - 2;
+            q = put(q, s.epochMs);
+            q = put(q, s.acquiredUs);
+            q = put(q, s.flowrate);
+            q = put(q, s.cumulativeFlow);
+            q = put(q, s.uvAdc);
+            q = put(q, s.pressure1);
+            q = put(q, s.pressure2);
+            *q++ = s.flowValid;
+            return append(p, used, f, q - f);
+        }
+        int n = snprintf((char *)p + used, LAN_CHUNK_MAX - used,
+                         R"json({"type":"sample","t":%llu,"us":%lld,"valid":%d,"flow":%.2f,"total":%.3f,"uv":%u,"p1":%.2f,"p2":%.2f})json" "\n",
+                         (unsigned long long)s.epochMs, (long long)s.acquiredUs, s.flowValid, s.flowrate,
+                         s.cumulativeFlow, (unsigned)s.uvAdc, s.pressure1, s.pressure2);
+        return commit(used, n);
+    }
+
+    bool encodeTrace(const Client &c, uint8_t *p, size_t &used, const PressurePoint_t &t)
+    {
+        if (c.binary) {
+            uint8_t f[2 + 24];
+            uint8_t *q = f;
+            *q++ = LAN_FRAME_TRACE;
+            *q++ = sizeof(f) - 2;
+            q = put(q, t.epochMs);
+            q = put(q, t.acquiredUs);
+            q = put(q, t.pressure1);
+            q = put(q, t.pressure2);
+            return append(p, used, f, q - f);
+        }
+        int n = snprintf((char *)p + used, LAN_CHUNK_MAX - used,
+                         R"json({"type":"p","t":%llu,"us":%lld,"p1":%.2f,"p2":%.2f})json" "\n",
+                         (unsigned long long)t.epochMs, (long long)t.acquiredUs, t.pressure1, t.pressure2);
+        return commit(used, n);
+    }
+
+    bool encodeGap(const Client &c, uint8_t *p, size_t &used, LanFrameType of, uint32_t missed)
+    {
+        if (c.binary) {
+            uint8_t f[2 + 5];
+            uint8_t *q = f;
+            *q++ = LAN_FRAME_GAP;
+            *q++ = sizeof(f) - 2;
+            *q++ = of;
+            q = put(q, missed);
+            return append(p, used, f, q - f);
+        }
+        int n = snprintf((char *)p + used, LAN_CHUNK_MAX - used,
+                         R"json({"type":"gap","of":"%s","skipped":%u})json" "\n",
+                         of == LAN_FRAME_SAMPLE ? "sample" : "p", (unsigned)missed);
+        return commit(used, n);
+    }
+
+    template <typename T>
+    static uint8_t *put(uint8_t *q, const T &v)
+    {
+        memcpy(q, &v, sizeof(v));   // both ends of the wire are little-endian
+        return q + sizeof(v);
+    }
+
+    static bool append(uint8_t *p, size_t &used, const uint8_t *f, size_t len)
+    {
+        if (used + len > LAN_CHUNK_MAX) {
+            return false;
+        }
+        memcpy(p + used, f, len);
+        used += len;
+        return true;
+    }
+
+    /* snprintf wrote n bytes after used; a truncated record is left unsent */
+    static bool commit(size_t &used, int n)
+    {
+        if (n <= 0 || used + n >= LAN_CHUNK_MAX) {
+            return false;
+        }
+        used += n;
+        return true;
+    }
+
+    static void reply(WiFiClient &sock, const char *status)
+    {
+        char buf[96];
+        int n = snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+        send(sock.fd(), buf, n, MSG_DONTWAIT);
+    }
+
+    void reject(Client &c, const char *status)
+    {
+        reply(c.sock, status);
+        stat.rejected++;
+        release(c);
+    }
+
+    void release(Client &c)
+    {
+        if (c.state == CLIENT_FREE) {
+            return;
+        }
+        if (c.state == CLIENT_STREAM) {
+            streaming--;
+        }
+        c.sock.stop();
+        c.state = CLIENT_FREE;
+    }
+
+    WiFiServer       server;
+    bool             isListening = false;
+    Client           clients[LAN_MAX_CLIENTS] = {};
+    volatile uint8_t streaming = 0;
+    Stats            stat = {};
+};
+
+LanStream lanStream;
+
+#endif // LAN_STREAM_H
@@ -0,0 +1,91 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+
+/**
+ * Fixed-bucket log-linear histogram: every power of two is split into four
+ * linear sub-buckets, so any recorded value lands in a bucket no wider
+ * than 25 % of itself. Recording is O(1) with no allocation; values past
+ * the last bucket are clamped into it (the exact maximum is kept apart).
+ *
+ * @tparam BUCKETS Number of buckets; covers values up to 2^(BUCKETS/4 + 1).
+ */
+template <uint8_t BUCKETS>
+class LatencyHistogram
+{
+public:
+    void record(uint32_t value)
+    {
+        counts[indexFor(value)]++;
+        count++;
+        sum += value;
+        if (value > maxValue) {
+            maxValue = value;
+        }
+        lastValue = value;
+    }
+
+    void reset()
+    {
+        memset(counts, 0, sizeof(counts));
+        count = 0;
+        sum = 0;
+        maxValue = 0;
+        lastValue = 0;
+    }
+
+    uint32_t samples() const { return count; }
+    uint32_t max()     const { return maxValue; }
+    uint32_t last()    const { return lastValue; }
+    uint32_t mean()    const { return count ? (uint32_t)(sum / count) : 0; }
+    uint64_t total()   const { return sum; }
+
+    /* Upper bound of the bucket holding the p-th percentile (0 < p <= 100) */
+    uint32_t percentile(float p) const
+    {
+        if (!count) {
+            return 0;
+        }
+        uint32_t rank = (uint32_t)ceilf(count * p / 100.0f);
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank && counts[i]) {
+                uint32_t upper = (i + 1 < BUCKETS) ? lowerBound(i + 1) - 1 : maxValue;
+                return upper < maxValue ? upper : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+    uint32_t bucketCount(uint8_t i) const { return counts[i]; }
+
+    static uint8_t indexFor(uint32_t v)
+    {
+        if (v < 4) {
+            return v;
+        }
+        uint8_t msb = 31 - __builtin_clz(v);
+        uint32_t idx = (msb - 1) * 4 + ((v >> (msb - 2)) & 3);
+        return idx < BUCKETS ? idx : BUCKETS - 1;
+    }
+
+    static uint32_t lowerBound(uint8_t idx)
+    {
+        if (idx < 4) {
+            return idx;
+        }
+        uint8_t msb = idx / 4 + 1;
+        return (uint32_t)(4 + idx % 4) << (msb - 2);
+    }
+
+private:
+    uint32_t counts[BUCKETS] = {};
+    uint32_t count = 0;
+    uint64_t sum = 0;
+    uint32_t maxValue = 0;
+    uint32_t lastValue = 0;
+};
+
+#endif // LATENCY_HISTOGRAM_H
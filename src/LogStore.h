@@ -0,0 +1,584 @@
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+extern "C" {
+  #include "esp_partition.h"
+  #include "esp_timer.h"
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/semphr.h"
+}
+
+/* ─── Record keys (one live value per key) ─────────────────────────────── */
+enum LogKey : uint8_t
+{
+    LOG_KEY_NONE        = 0,
+    LOG_KEY_VALVE       = 1,    // settled valve position
+    LOG_KEY_SETTINGS    = 2,    // flow threshold, shutoff override
+    LOG_KEY_USAGE       = 3,    // hourly/daily/monthly rollup baselines
+    LOG_KEY_BURST       = 4,    // leak lockout state
+    LOG_KEY_DETECTOR    = 5,    // blockage detector histories
+    LOG_KEY_TOTAL       = 6,    // monotonic volume totaliser
+    LOG_KEY_NIGHTFLOW   = 7,    // night-flow detector config and streak
+    LOG_KEY_FLOW_LIMITS = 8,    // continuous-flow duration/volume limits
+    LOG_KEY_POWER       = 9,    // power mode, sleep period, upload interval
+    LOG_KEY_TIMEZONE    = 10,   // POSIX TZ rule
+    LOG_KEY_MQTT        = 11,   // site broker for the MQTT telemetry sink
+
+    LOG_MAX_KEYS        = 16
+};
+
+/* ─── Layout ───────────────────────────────────────────────────────────── */
+constexpr uint32_t LOG_SECTOR_SIZE    = 4096;
+constexpr uint32_t LOG_SECTOR_MAGIC   = 0x534C4748;  // "HGLS"
+constexpr uint16_t LOG_RECORD_MAGIC   = 0x524C;      // "LR"
+constexpr uint16_t LOG_MAX_PAYLOAD    = 480;
+constexpr uint32_t LOG_LIVE_CAPACITY  = LOG_SECTOR_SIZE - 8;  // sector minus its header
+constexpr const char *LOG_NVS_NAMESPACE = "hgstate";        // fallback without the hglog partition
+
+/**
+ * Raw flash access used by LogStore. The device build talks to a data
+ * partition; a host build can substitute a RAM-backed simulator.
+ */
+class LogFlash
+{
+public:
+    virtual ~LogFlash() {}
+    virtual uint32_t size() const = 0;
+    virtual bool read(uint32_t addr, void *dst, size_t len) = 0;
+    virtual bool write(uint32_t addr, const void *src, size_t len) = 0;
+    virtual bool eraseSector(uint32_t addr) = 0;
+};
+
+class PartitionFlash : public LogFlash
+{
+public:
+    bool begin(const char *label)
+    {
+        part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        return part != nullptr;
+    }
+    uint32_t size() const override { return part ? part->size : 0; }
+    bool read(uint32_t addr, void *dst, size_t len) override
+    {
+        return esp_partition_read(part, addr, dst, len) == ESP_OK;
+    }
+    bool write(uint32_t addr, const void *src, size_t len) override
+    {
+        return esp_partition_write(part, addr, src, len) == ESP_OK;
+    }
+    bool eraseSector(uint32_t addr) override
+    {
+        return esp_partition_erase_range(part, addr, LOG_SECTOR_SIZE) == ESP_OK;
+    }
+
+private:
+    const esp_partition_t *part = nullptr;
+};
+
+/**
+ * Append-only key/value record log spread over a ring of flash sectors.
+ *
+ * Every write appends a CRC-checked record; a RAM index maps each key to
+ * its newest record. When the head sector fills, the log moves into the
+ * next (always pre-erased) sector and compacts the oldest one: records
+ * that are still the latest for their key are re-appended, then the sector
+ * is erased. Erases therefore rotate evenly over the whole partition.
+ * Boot recovery is a single scan of all sectors, keeping the highest
+ * sequence number per key.
+ *
+ * Compaction must always fit the survivors into one fresh sector, so the
+ * live set (newest record of every key, headers included) is capped at
+ * LOG_LIVE_CAPACITY; the firmware's keys use about 1.3 KB of it. A write
+ * that would exceed the cap, or that the flash rejects, returns false and
+ * is counted in Stats::failed.
+ *
+ * Records are staged in one scratch buffer owned by the store, never on
+ * the caller's stack (compaction runs inside a write on the safety task);
+ * a mutex serialises writers and guards it.
+ *
+ * The partition only exists on units whose partition table was flashed
+ * over serial; an OTA update cannot add it. Without it, beginNvs() keeps
+ * the same keys as one NVS blob each (NVS levels its own wear), with the
+ * same live-set cap and coalescing.
+ */
+class LogStore
+{
+public:
+    struct Stats
+    {
+        uint32_t payloadBytes;    // bytes handed to write()
+        uint32_t flashBytes;      // bytes programmed, including headers and compaction
+        uint32_t erases;
+        uint32_t coalesced;       // writes skipped because the value was unchanged
+        uint32_t recoveryUs;
+        uint32_t failed;          // writes refused (full, not ready) or lost to a flash error
+        uint32_t liveBytes;       // of LOG_LIVE_CAPACITY
+        uint16_t sectors;
+        uint8_t  lastFailedKey;
+    };
+
+    bool begin(LogFlash &dev)
+    {
+        if (!lock) {
+            lock = xSemaphoreCreateMutexStatic(&lockBuffer);
+        }
+        Locked guard(lock);
+        flash = &dev;
+        nvsName = nullptr;
+        memset(index, 0, sizeof(index));
+        memset(&stats, 0, sizeof(stats));
+        sectorCount = flash->size() / LOG_SECTOR_SIZE;
+        stats.sectors = sectorCount;
+        if (sectorCount < 3) {
+            ready = false;
+            return false;
+        }
+        int64_t t0 = esp_timer_get_time();
+        ready = recover();
+        stats.recoveryUs = (uint32_t)(esp_timer_get_time() - t0);
+        return ready;
+    }
+
+    /* Fallback without a log partition: keys live in an NVS namespace */
+    bool beginNvs(const char *ns)
+    {
+        if (!lock) {
+            lock = xSemaphoreCreateMutexStatic(&lockBuffer);
+        }
+        Locked guard(lock);
+        flash = nullptr;
+        nvsName = ns;
+        memset(index, 0, sizeof(index));
+        memset(&stats, 0, sizeof(stats));
+        sectorCount = 0;
+        int64_t t0 = esp_timer_get_time();
+        Preferences prefs;
+        ready = prefs.begin(nvsName, false);
+        for (uint8_t k = 1; ready && k < LOG_MAX_KEYS; k++) {
+            char name[4];
+            size_t len = prefs.getBytesLength(nvsKey(k, name));
+            if (len && len <= LOG_MAX_PAYLOAD && prefs.getBytes(name, scratch, len) == len) {
+                index[k] = {1, 0, crc32(scratch, len), (uint16_t)len};
+            }
+        }
+        prefs.end();
+        stats.recoveryUs = (uint32_t)(esp_timer_get_time() - t0);
+        return ready;
+    }
+
+    /**
+     * Stores a value for a key, superseding any previous one. Identical
+     * values are coalesced and not written again.
+     */
+    bool write(uint8_t key, const void *data, uint16_t len)
+    {
+        if (!lock) {
+            return false;   // begin() never ran
+        }
+        Locked guard(lock);
+        if (!ready || key == LOG_KEY_NONE || key >= LOG_MAX_KEYS || len > LOG_MAX_PAYLOAD) {
+            return failed(key);
+        }
+        uint32_t crc = crc32(data, len);
+        if (index[key].seq && index[key].len == len && index[key].crc == crc) {
+            stats.coalesced++;
+            return true;
+        }
+        if (liveBytes() - recordSize(index[key].seq ? index[key].len : 0) + recordSize(len) >
+            LOG_LIVE_CAPACITY) {
+            return failed(key);   // live set would no longer fit through compaction
+        }
+        stats.payloadBytes += len;
+        if (nvsName) {
+            return nvsWrite(key, data, len, crc) || failed(key);
+        }
+        // Make room first: compaction reuses the scratch buffer
+        if (!reserve(recordSize(len))) {
+            return failed(key);
+        }
+        memcpy(scratch + sizeof(RecordHeader), data, len);
+        return commit(key, len, crc) || failed(key);
+    }
+
+    /* @return Length of the stored value, 0 if none (or buffer too small) */
+    uint16_t read(uint8_t key, void *data, uint16_t maxLen)
+    {
+        if (!ready || key >= LOG_MAX_KEYS) {
+            return 0;
+        }
+        Locked guard(lock);
+        const Entry &e = index[key];
+        if (!e.seq || e.len > maxLen) {
+            return 0;
+        }
+        if (nvsName) {
+            return nvsRead(key, data, e.len) ? e.len : 0;
+        }
+        if (!flash->read(e.addr + sizeof(RecordHeader), data, e.len)) {
+            return 0;
+        }
+        return e.len;
+    }
+
+    template <typename T>
+    bool writeValue(uint8_t key, const T &value) { return write(key, &value, sizeof(T)); }
+
+    template <typename T>
+    bool readValue(uint8_t key, T &value) { return read(key, &value, sizeof(T)) == sizeof(T); }
+
+    bool isReady() const { return ready; }
+    bool usesNvs() const { return nvsName != nullptr; }
+
+    /* Consistent copy for other tasks; the safety task may be mid-write */
+    Stats getStats() const
+    {
+        if (!lock) {
+            return stats;
+        }
+        Locked guard(lock);
+        Stats copy = stats;
+        copy.liveBytes = liveBytes();
+        return copy;
+    }
+
+    /* Flash bytes programmed per payload byte */
+    float writeAmplification() const
+    {
+        Stats s = getStats();
+        return s.payloadBytes ? (float)s.flashBytes / s.payloadBytes : 0.0f;
+    }
+
+private:
+    struct SectorHeader
+    {
+        uint32_t magic;
+        uint32_t seq;
+    };
+    static_assert(sizeof(SectorHeader) == LOG_SECTOR_SIZE - LOG_LIVE_CAPACITY, "capacity assumes an 8-byte sector header");
+
+    struct RecordHeader
+    {
+        uint16_t magic;
+        uint8_t  key;
+        uint8_t  reserved;
+        uint16_t len;
+        uint16_t pad;
+        uint32_t seq;
+        uint32_t crc;       // over key, len, seq and payload
+    };
+
+    /* Holds the store's mutex for a scope */
+    class Locked
+    {
+    public:
+        explicit Locked(SemaphoreHandle_t m) : mutex(m) { xSemaphoreTake(mutex, portMAX_DELAY); }
+        ~Locked() { xSemaphoreGive(mutex); }
+
+    private:
+        SemaphoreHandle_t mutex;
+    };
+
+    struct Entry
+    {
+        uint32_t seq;       // 0 = key absent
+        uint32_t addr;
+        uint32_t crc;       // payload CRC, for write coalescing
+        uint16_t len;
+    };
+
+    static uint32_t recordSize(uint16_t len)
+    {
+        return (sizeof(RecordHeader) + len + 3) & ~3u;
+    }
+
+    static uint32_t crc32(const void *data, size_t len, uint32_t crc = 0)
+    {
+        const uint8_t *p = (const uint8_t *)data;
+        crc = ~crc;
+        while (len--) {
+            crc ^= *p++;
+            for (uint8_t k = 0; k < 8; k++) {
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+            }
+        }
+        return ~crc;
+    }
+
+    static uint32_t recordCrc(const RecordHeader &h, uint32_t payloadCrc)
+    {
+        uint8_t meta[7] = {h.key, (uint8_t)h.len, (uint8_t)(h.len >> 8),
+                           (uint8_t)h.seq, (uint8_t)(h.seq >> 8),
+                           (uint8_t)(h.seq >> 16), (uint8_t)(h.seq >> 24)};
+        return crc32(meta, sizeof(meta), payloadCrc);
+    }
+
+    uint32_t liveBytes() const
+    {
+        uint32_t total = 0;
+        for (uint8_t k = 1; k < LOG_MAX_KEYS; k++) {
+            if (index[k].seq) {
+                total += recordSize(index[k].len);
+            }
+        }
+        return total;
+    }
+
+    bool failed(uint8_t key)
+    {
+        stats.failed++;
+        stats.lastFailedKey = key;
+        return false;
+    }
+
+    static const char *nvsKey(uint8_t key, char *name)
+    {
+        snprintf(name, 4, "k%u", (unsigned)key);
+        return name;
+    }
+
+    bool nvsWrite(uint8_t key, const void *data, uint16_t len, uint32_t crc)
+    {
+        Preferences prefs;
+        char name[4];
+        bool ok = prefs.begin(nvsName, false) && prefs.putBytes(nvsKey(key, name), data, len) == len;
+        prefs.end();
+        if (ok) {
+            index[key] = {1, 0, crc, len};
+            stats.flashBytes += len;
+        }
+        return ok;
+    }
+
+    bool nvsRead(uint8_t key, void *data, uint16_t len)
+    {
+        Preferences prefs;
+        char name[4];
+        bool ok = prefs.begin(nvsName, true) && prefs.getBytes(nvsKey(key, name), data, len) == len;
+        prefs.end();
+        return ok;
+    }
+
+    uint16_t nextSector(uint16_t s) const { return (s + 1) % sectorCount; }
+
+    /* Moves the head on until `need` bytes fit, compacting as it goes */
+    bool reserve(uint32_t need)
+    {
+        for (uint16_t tries = 0; headOffset + need > LOG_SECTOR_SIZE; tries++) {
+            if (tries >= sectorCount || !advance()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Programs the record whose payload is staged in scratch; never advances */
+    bool commit(uint8_t key, uint16_t len, uint32_t payloadCrc)
+    {
+        uint32_t need = recordSize(len);
+        if (headOffset + need > LOG_SECTOR_SIZE) {
+            return false;
+        }
+
+        RecordHeader h = {};
+        h.magic = LOG_RECORD_MAGIC;
+        h.key   = key;
+        h.len   = len;
+        h.seq   = ++recordSeq;
+        h.crc   = recordCrc(h, payloadCrc);
+
+        uint32_t addr = headSector * LOG_SECTOR_SIZE + headOffset;
+        memcpy(scratch, &h, sizeof(h));
+        memset(scratch + sizeof(h) + len, 0, need - sizeof(h) - len);
+        if (!flash->write(addr, scratch, need)) {
+            headOffset = LOG_SECTOR_SIZE;   // do not reuse a possibly torn area
+            return false;
+        }
+        headOffset += need;
+        stats.flashBytes += need;
+
+        index[key] = {h.seq, addr, payloadCrc, len};
+        return true;
+    }
+
+    /* Opens the next (erased) sector and compacts the one after it */
+    bool advance()
+    {
+        headSector = nextSector(headSector);
+        SectorHeader sh = {LOG_SECTOR_MAGIC, ++sectorSeq};
+        if (!flash->write(headSector * LOG_SECTOR_SIZE, &sh, sizeof(sh))) {
+            return false;
+        }
+        headOffset = sizeof(SectorHeader);
+        stats.flashBytes += sizeof(sh);
+        return compact(nextSector(headSector));
+    }
+
+    /* The live set fits one sector, so the victim's survivors fit the fresh head */
+    bool compact(uint16_t victim)
+    {
+        uint32_t base = victim * LOG_SECTOR_SIZE;
+        for (uint8_t k = 1; k < LOG_MAX_KEYS; k++) {
+            Entry e = index[k];
+            if (!e.seq || e.addr < base || e.addr >= base + LOG_SECTOR_SIZE) {
+                continue;
+            }
+            if (!flash->read(e.addr + sizeof(RecordHeader), scratch + sizeof(RecordHeader), e.len) ||
+                !commit(k, e.len, e.crc)) {
+                return false;
+            }
+        }
+        if (sectorErased(victim)) {
+            return true;
+        }
+        stats.erases++;
+        return flash->eraseSector(base);
+    }
+
+    bool sectorErased(uint16_t s)
+    {
+        uint32_t word = 0;
+        flash->read(s * LOG_SECTOR_SIZE, &word, sizeof(word));
+        return word == 0xFFFFFFFF;
+    }
+
+    /* Reads and checks the record at addr; the payload lands in scratch */
+    bool validRecord(uint32_t addr, uint32_t sectorEnd, RecordHeader &h, uint32_t &payloadCrc)
+    {
+        flash->read(addr, &h, sizeof(h));
+        if (h.magic != LOG_RECORD_MAGIC || h.len > LOG_MAX_PAYLOAD || h.key >= LOG_MAX_KEYS ||
+            addr + recordSize(h.len) > sectorEnd) {
+            return false;
+        }
+        flash->read(addr + sizeof(h), scratch + sizeof(RecordHeader), h.len);
+        payloadCrc = crc32(scratch + sizeof(RecordHeader), h.len);
+        return recordCrc(h, payloadCrc) == h.crc;
+    }
+
+    /* Offset just past the last programmed word of a sector */
+    uint32_t programmedEnd(uint32_t base)
+    {
+        uint32_t words[16];
+        for (uint32_t off = LOG_SECTOR_SIZE; off > sizeof(SectorHeader); off -= sizeof(words)) {
+            flash->read(base + off - sizeof(words), words, sizeof(words));
+            for (uint8_t i = 16; i > 0; i--) {
+                if (words[i - 1] != 0xFFFFFFFF) {
+                    return off - sizeof(words) + i * sizeof(uint32_t);
+                }
+            }
+        }
+        return sizeof(SectorHeader);
+    }
+
+    /*
+     * Scans one sector into the index; returns the end of valid data.
+     * A torn record (power lost mid-write) is stepped over: scanning
+     * resumes at the next valid header, and if there is none the sector
+     * continues after the programmed bytes, so recovery still has room
+     * to finish an interrupted compaction into it.
+     */
+    uint32_t scanSector(uint16_t s)
+    {
+        uint32_t base = s * LOG_SECTOR_SIZE;
+        uint32_t sectorEnd = base + LOG_SECTOR_SIZE;
+        uint32_t off = sizeof(SectorHeader);
+        uint32_t end = 0;
+
+        while (off + sizeof(RecordHeader) <= LOG_SECTOR_SIZE) {
+            RecordHeader h;
+            uint32_t payloadCrc;
+            if (validRecord(base + off, sectorEnd, h, payloadCrc)) {
+                if (h.seq > index[h.key].seq) {
+                    index[h.key] = {h.seq, base + off, payloadCrc, h.len};
+                }
+                if (h.seq > recordSeq) {
+                    recordSeq = h.seq;
+                }
+                off += recordSize(h.len);
+                continue;
+            }
+            if (h.magic == 0xFFFF) {
+                return off;                         // clean end of log
+            }
+            if (!end) {
+                end = programmedEnd(base);
+            }
+            do {
+                off += sizeof(uint32_t);
+            } while (off < end && !validRecord(base + off, sectorEnd, h, payloadCrc));
+            if (off >= end) {
+                return end;
+            }
+        }
+        return off;
+    }
+
+    bool format()
+    {
+        for (uint16_t s = 0; s < sectorCount; s++) {
+            if (sectorErased(s)) {
+                continue;
+            }
+            if (!flash->eraseSector(s * LOG_SECTOR_SIZE)) {
+                return false;
+            }
+            stats.erases++;
+        }
+        headSector = sectorCount - 1;
+        sectorSeq = 0;
+        recordSeq = 0;
+        return advance();
+    }
+
+    bool recover()
+    {
+        bool found = false;
+        sectorSeq = 0;
+        recordSeq = 0;
+        for (uint16_t s = 0; s < sectorCount; s++) {
+            SectorHeader sh;
+            flash->read(s * LOG_SECTOR_SIZE, &sh, sizeof(sh));
+            if (sh.magic != LOG_SECTOR_MAGIC) {
+                continue;
+            }
+            uint32_t end = scanSector(s);
+            if (!found || sh.seq > sectorSeq) {
+                found = true;
+                sectorSeq = sh.seq;
+                headSector = s;
+                headOffset = end;
+            }
+        }
+        if (!found) {
+            return format();
+        }
+        // Finish a compaction interrupted by a reset
+        uint16_t victim = nextSector(headSector);
+        if (!sectorErased(victim)) {
+            return compact(victim);
+        }
+        return true;
+    }
+
+    LogFlash   *flash = nullptr;
+    const char *nvsName = nullptr;   // set when running on NVS instead of flash
+    Entry       index[LOG_MAX_KEYS];
+    Stats       stats;
+    uint16_t    sectorCount = 0;
+    uint16_t    headSector = 0;
+    uint32_t    headOffset = 0;
+    uint32_t    sectorSeq = 0;
+    uint32_t    recordSeq = 0;
+    bool        ready = false;
+
+    // One record's staging area, guarded by lock
+    uint8_t           scratch[sizeof(RecordHeader) + LOG_MAX_PAYLOAD + 3];
+    SemaphoreHandle_t lock = nullptr;
+    StaticSemaphore_t lockBuffer;
+};
+
+PartitionFlash statePartition;
+LogStore stateStore;
+
+#endif // LOG_STORE_H
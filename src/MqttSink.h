@@ -0,0 +1,555 @@
+#ifndef MQTT_SINK_H
+#define MQTT_SINK_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "ReconnectScheduler.h"
+#include "SpscRing.h"
+#include "TelemetrySink.h"
+
+/* ─── Broker session ───────────────────────────────────────────────────── */
+constexpr uint16_t MQTT_DEFAULT_PORT       = 1883;
+constexpr uint16_t MQTT_KEEPALIVE_S        = 30;
+constexpr uint32_t MQTT_CONNECT_TIMEOUT_MS = 5000;
+constexpr uint32_t MQTT_RATE_WINDOW_MS     = 10000;   // sent/s is measured over this window
+
+/* ─── Queueing and pipelining ──────────────────────────────────────────── */
+constexpr size_t   MQTT_QUEUE_LEN          = 32;      // records from the safety task (~2.5 min)
+constexpr uint8_t  MQTT_BATCH              = 8;       // records per flush
+constexpr uint8_t  MQTT_INFLIGHT           = 8;       // QoS 1 publishes awaiting PUBACK
+constexpr size_t   MQTT_PACKET_MAX         = 320;
+constexpr size_t   MQTT_TX_MAX             = 1460;    // one TCP segment per flush where possible
+
+/* Broker settings, persisted under LOG_KEY_MQTT */
+struct MqttConfig
+{
+    uint8_t  enabled;
+    uint8_t  qos;            // telemetry QoS, 0 or 1; events always use 1
+    uint16_t port;
+    char     host[64];
+    char     user[32];
+    char     pass[64];
+};
+
+/**
+ * MQTT 3.1.1 publisher for a site broker. Reports go to
+ * <prefix>/telemetry as JSON, events to <prefix>/event/<code>,
+ * <prefix>/resolve/<code> and pin writes to <prefix>/pin/<n>, where
+ * prefix is "hydroguard/<MAC>". Each pass of the MQTT task packs up to
+ * MQTT_BATCH queued records into one socket write. QoS 1 publishes are
+ * pipelined: up to MQTT_INFLIGHT may await their PUBACK at once, a full
+ * window holds the queue back, and whatever is unacknowledged when the
+ * session drops is resent with DUP set after the reconnect (at least
+ * once), unless the broker itself changed. Reconnects back off like the
+ * cloud link.
+ */
+class MqttSink : public TelemetrySink
+{
+public:
+    struct Session
+    {
+        uint32_t connects;
+        uint32_t disconnects;
+        uint32_t resent;         // QoS 1 publishes repeated after a reconnect
+        uint8_t  inflight;
+        float    sentPerS;       // over the last MQTT_RATE_WINDOW_MS
+    };
+
+    MqttSink() : TelemetrySink("mqtt") { setActive(false); }
+
+    /**
+     * Any task: queues broker settings. The MQTT task owns the session and
+     * switches to them at the start of its next pass, which is also when
+     * the sink starts or stops taking records.
+     */
+    void requestConfig(const MqttConfig &c)
+    {
+        portENTER_CRITICAL(&lock);
+        pending = c;
+        pending.host[sizeof(pending.host) - 1] = '\0';
+        pending.user[sizeof(pending.user) - 1] = '\0';
+        pending.pass[sizeof(pending.pass) - 1] = '\0';
+        pendingSet = true;
+        portEXIT_CRITICAL(&lock);
+    }
+
+    /* The queued settings if any, else those in use */
+    MqttConfig config()
+    {
+        portENTER_CRITICAL(&lock);
+        MqttConfig c = pendingSet ? pending : cfg;
+        portEXIT_CRITICAL(&lock);
+        return c;
+    }
+
+    /* MQTT task: connects, drains the queue and reads acknowledgements */
+    void run(uint32_t now, bool netUp)
+    {
+        applyPendingConfig();
+        step(now, netUp);
+        portENTER_CRITICAL(&lock);
+        shared = sess;
+        portEXIT_CRITICAL(&lock);
+    }
+
+    /* Any task: session counters as of the MQTT task's last pass */
+    Session session()
+    {
+        portENTER_CRITICAL(&lock);
+        Session s = shared;
+        portEXIT_CRITICAL(&lock);
+        return s;
+    }
+
+private:
+    enum RecordKind : uint8_t
+    {
+        RECORD_REPORT,
+        RECORD_EVENT
+    };
+
+    struct Record
+    {
+        RecordKind kind;
+        union
+        {
+            Report_t     report;
+            CloudEvent_t event;
+        };
+    };
+
+    struct Inflight
+    {
+        uint16_t id;             // 0 = free
+        uint16_t len;
+        uint8_t  packet[MQTT_PACKET_MAX];
+    };
+
+    bool enqueueReport(const Report_t &r) override
+    {
+        Record rec;
+        rec.kind = RECORD_REPORT;
+        rec.report = r;
+        return queue.push(rec);
+    }
+
+    bool enqueueEvent(const CloudEvent_t &e) override
+    {
+        Record rec;
+        rec.kind = RECORD_EVENT;
+        rec.event = e;
+        return queue.push(rec);
+    }
+
+    void applyPendingConfig()
+    {
+        MqttConfig prev = cfg;
+        portENTER_CRITICAL(&lock);
+        bool changed = pendingSet;
+        if (changed) {
+            cfg = pending;
+            pendingSet = false;
+        }
+        portEXIT_CRITICAL(&lock);
+        if (changed) {
+            disconnect(false);
+            if (strcmp(prev.host, cfg.host) || brokerPort(prev) != brokerPort(cfg)) {
+                dropInflight();                          // packet ids mean nothing to another broker
+            }
+            backoff = ReconnectScheduler();
+            backoff.begin(esp_random());
+            uint8_t mac[6];
+            WiFi.macAddress(mac);
+            snprintf(prefix, sizeof(prefix), "hydroguard/%02X%02X%02X%02X%02X%02X",
+                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+            setActive(cfg.enabled && cfg.host[0]);
+        }
+    }
+
+    void step(uint32_t now, bool netUp)
+    {
+        if (!cfg.enabled || !cfg.host[0] || !netUp) {
+            disconnect(false);
+            return;
+        }
+        if (!online) {
+            if (!connect(now)) {
+                return;
+            }
+            now = millis();                              // connecting blocks for a while
+        }
+        if (!readIncoming(now) || !keepAlive(now) || !publishQueued(now)) {
+            disconnect(true);
+            backoff.lost(LINK_CLOUD, now);
+        }
+        measure(now);
+    }
+
+    /* ─── Session ─── */
+
+    bool connect(uint32_t now)
+    {
+        if (!backoff.due(LINK_CLOUD, now)) {
+            return false;
+        }
+        backoff.started(LINK_CLOUD, now);
+        if (!sock.connect(cfg.host, brokerPort(cfg), MQTT_CONNECT_TIMEOUT_MS)) {
+            backoff.failed(LINK_CLOUD, millis());
+            return false;
+        }
+        sock.setNoDelay(true);
+        rxLen = 0;
+
+        // CONNECT, clean session: unacknowledged QoS 1 publishes are resent below
+        uint8_t body[MQTT_PACKET_MAX];
+        size_t n = 0;
+        n = putString(body, n, "MQTT");
+        body[n++] = 4;                                   // protocol level 3.1.1
+        body[n++] = 0x02 | (cfg.user[0] ? 0x80 : 0) | (cfg.pass[0] ? 0x40 : 0);
+        body[n++] = MQTT_KEEPALIVE_S >> 8;
+        body[n++] = MQTT_KEEPALIVE_S & 0xFF;
+        n = putString(body, n, prefix + 11);             // client id: the MAC
+        if (cfg.user[0]) {
+            n = putString(body, n, cfg.user);
+        }
+        if (cfg.pass[0]) {
+            n = putString(body, n, cfg.pass);
+        }
+        uint8_t packet[MQTT_PACKET_MAX + 5];
+        size_t len = frame(packet, 0x10, body, n);
+        connAcked = false;
+        if (sock.write(packet, len) != len) {
+            return failConnect();
+        }
+        uint32_t start = millis();
+        while (!connAcked && millis() - start < MQTT_CONNECT_TIMEOUT_MS) {
+            if (!readIncoming(millis())) {
+                return failConnect();
+            }
+            delay(10);
+        }
+        if (!connAcked) {
+            return failConnect();
+        }
+
+        now = millis();
+        backoff.succeeded(LINK_CLOUD, now);
+        online = true;
+        setConnected(true);
+        sess.connects++;
+        lastTxMs = lastRxMs = pingMs = now;
+
+        for (Inflight &f : inflight) {
+            if (f.id) {
+                f.packet[0] |= 0x08;                     // DUP
+                if (sock.write(f.packet, f.len) != f.len) {
+                    disconnect(true);
+                    return false;
+                }
+                sess.resent++;
+            }
+        }
+        return true;
+    }
+
+    bool failConnect()
+    {
+        sock.stop();
+        backoff.failed(LINK_CLOUD, millis());
+        return false;
+    }
+
+    void disconnect(bool lost)
+    {
+        if (online && !lost) {
+            static const uint8_t bye[] = {0xE0, 0x00};
+            sock.write(bye, sizeof(bye));
+        }
+        if (online) {
+            sess.disconnects++;
+        }
+        sock.stop();
+        online = false;
+        setConnected(false);
+    }
+
+    /* Unacknowledged QoS 1 publishes are given up and counted as failed */
+    void dropInflight()
+    {
+        uint8_t dropped = 0;
+        for (Inflight &f : inflight) {
+            if (f.id) {
+                f.id = 0;
+                dropped++;
+            }
+        }
+        sess.inflight = 0;
+        noteFailed(dropped);
+    }
+
+    static uint16_t brokerPort(const MqttConfig &c) { return c.port ? c.port : MQTT_DEFAULT_PORT; }
+
+    bool keepAlive(uint32_t now)
+    {
+        if (now - lastRxMs > MQTT_KEEPALIVE_S * 1500UL) {
+            return false;                                // broker gone silent
+        }
+        // Ping when either direction has been quiet, so QoS 0 traffic still sees replies
+        uint32_t half = MQTT_KEEPALIVE_S * 500UL;
+        if ((now - lastTxMs >= half || now - lastRxMs >= half) && now - pingMs >= half) {
+            static const uint8_t ping[] = {0xC0, 0x00};
+            if (sock.write(ping, sizeof(ping)) != sizeof(ping)) {
+                return false;
+            }
+            lastTxMs = pingMs = now;
+        }
+        return true;
+    }
+
+    /* Handles CONNACK, PUBACK and PINGRESP; false if the session is broken */
+    bool readIncoming(uint32_t now)
+    {
+        int avail = sock.available();
+        if (avail > 0) {
+            size_t room = sizeof(rx) - rxLen;
+            int n = sock.read(rx + rxLen, (size_t)avail < room ? avail : room);
+            if (n > 0) {
+                rxLen += n;
+                lastRxMs = now;
+            }
+        } else if (!sock.connected()) {
+            return false;
+        }
+        while (rxLen >= 2) {
+            size_t len = 0, hdr = 1;
+            uint8_t shift = 0;
+            do {
+                if (hdr >= rxLen) {
+                    return true;                         // length still arriving
+                }
+                len |= (size_t)(rx[hdr] & 0x7F) << shift;
+                shift += 7;
+            } while (rx[hdr++] & 0x80 && shift < 28);
+            if (hdr + len > sizeof(rx)) {
+                return false;                            // nothing this large is expected
+            }
+            if (hdr + len > rxLen) {
+                return true;
+            }
+            const uint8_t *p = rx + hdr;
+            switch (rx[0] & 0xF0) {
+            case 0x20:                                   // CONNACK
+                if (len < 2 || p[1] != 0) {
+                    return false;                        // refused (bad credentials, ...)
+                }
+                connAcked = true;
+                break;
+            case 0x40:                                   // PUBACK
+                if (len >= 2) {
+                    acknowledge((uint16_t)(p[0] << 8 | p[1]));
+                }
+                break;
+            default:                                     // PINGRESP and anything unexpected
+                break;
+            }
+            rxLen -= hdr + len;
+            memmove(rx, rx + hdr + len, rxLen);
+        }
+        return true;
+    }
+
+    void acknowledge(uint16_t id)
+    {
+        for (Inflight &f : inflight) {
+            if (f.id == id) {
+                f.id = 0;
+                sess.inflight--;
+                noteSent();
+                return;
+            }
+        }
+    }
+
+    /* ─── Publishing ─── */
+
+    /* Packs queued records into one write; stops early at a full QoS 1 window */
+    bool publishQueued(uint32_t now)
+    {
+        uint8_t tx[MQTT_TX_MAX];
+        size_t txLen = 0;
+        uint8_t qos0 = 0;
+        Record rec;
+        for (uint8_t i = 0; i < MQTT_BATCH && queue.peek(rec); i++) {
+            uint8_t qos = rec.kind == RECORD_EVENT ? 1 : cfg.qos;
+            Inflight *slot = qos ? freeSlot() : nullptr;
+            if (qos && !slot) {
+                break;                                   // window full: acks first
+            }
+            queue.pop(rec);
+            uint8_t packet[MQTT_PACKET_MAX];
+            size_t len = encode(rec, qos, packet);
+            if (!len) {
+                noteFailed();
+                continue;
+            }
+            if (txLen + len > sizeof(tx)) {
+                if (!flush(tx, txLen, qos0, now)) {
+                    return false;
+                }
+                txLen = qos0 = 0;
+            }
+            memcpy(tx + txLen, packet, len);
+            txLen += len;
+            if (slot) {
+                slot->id = nextId;
+                slot->len = len;
+                memcpy(slot->packet, packet, len);
+                sess.inflight++;
+            } else {
+                qos0++;
+            }
+        }
+        return flush(tx, txLen, qos0, now);
+    }
+
+    bool flush(const uint8_t *tx, size_t len, uint8_t qos0, uint32_t now)
+    {
+        if (!len) {
+            return true;
+        }
+        if (sock.write(tx, len) != len) {
+            noteFailed(qos0);
+            return false;                                // QoS 1 records stay in flight
+        }
+        noteSent(qos0);
+        lastTxMs = now;
+        return true;
+    }
+
+    Inflight *freeSlot()
+    {
+        for (Inflight &f : inflight) {
+            if (!f.id) {
+                return &f;
+            }
+        }
+        return nullptr;
+    }
+
+    /* Builds one PUBLISH; QoS 1 takes the next packet id */
+    size_t encode(const Record &rec, uint8_t qos, uint8_t *packet)
+    {
+        char topic[112];
+        char payload[224];
+        int plen;
+        if (rec.kind == RECORD_REPORT) {
+            const Report_t &r = rec.report;
+            snprintf(topic, sizeof(topic), "%s/telemetry", prefix);
+            plen = snprintf(payload, sizeof(payload),
+                            R"json({"t":%llu,"flow":%.2f,"total":%.1f,"irr":%.2f,"dose":%.1f,"p1":%.1f,"p2":%.1f,"block":%.1f,"under":%.1f,"lamp_h":%.1f,"safety_p99_us":%u})json",
+                            (unsigned long long)r.epochMs, r.flowrate, r.cumulativeflow, r.irradiance, r.dosage,
+                            r.pressure1, r.pressure2, r.blockagePercentage, r.underDosedLitres, r.lampHours,
+                            (unsigned)r.safetyP99Us);
+        } else {
+            const CloudEvent_t &e = rec.event;
+            switch (e.type) {
+            case CLOUD_LOG_EVENT:
+                snprintf(topic, sizeof(topic), "%s/event/%s", prefix, e.name);
+                plen = snprintf(payload, sizeof(payload), "%s", e.msg);
+                break;
+            case CLOUD_RESOLVE_EVENT:
+                snprintf(topic, sizeof(topic), "%s/resolve/%s", prefix, e.name);
+                plen = 0;
+                break;
+            case CLOUD_WRITE_PIN:
+                snprintf(topic, sizeof(topic), "%s/pin/%u", prefix, (unsigned)e.pin);
+                plen = snprintf(payload, sizeof(payload), "%g", e.value);
+                break;
+            default:
+                snprintf(topic, sizeof(topic), "%s/pin/%u", prefix, (unsigned)e.pin);
+                plen = snprintf(payload, sizeof(payload), "%s", e.msg);
+                break;
+            }
+        }
+        if (plen < 0 || plen >= (int)sizeof(payload)) {
+            return 0;
+        }
+
+        uint8_t body[MQTT_PACKET_MAX];
+        size_t n = putString(body, 0, topic);
+        if (qos) {
+            if (++nextId == 0) {
+                nextId = 1;
+            }
+            body[n++] = nextId >> 8;
+            body[n++] = nextId & 0xFF;
+        }
+        if (n + plen > sizeof(body) - 5) {
+            return 0;
+        }
+        memcpy(body + n, payload, plen);
+        n += plen;
+        return frame(packet, 0x30 | (qos << 1), body, n);
+    }
+
+    static size_t putString(uint8_t *buf, size_t n, const char *s)
+    {
+        size_t len = strlen(s);
+        buf[n++] = len >> 8;
+        buf[n++] = len & 0xFF;
+        memcpy(buf + n, s, len);
+        return n + len;
+    }
+
+    /* Fixed header + remaining length + body */
+    static size_t frame(uint8_t *out, uint8_t type, const uint8_t *body, size_t len)
+    {
+        size_t n = 0;
+        out[n++] = type;
+        size_t rem = len;
+        do {
+            uint8_t b = rem & 0x7F;
+            rem >>= 7;
+            out[n++] = rem ? b | 0x80 : b;
+        } while (rem);
+        memcpy(out + n, body, len);
+        return n + len;
+    }
+
+    void measure(uint32_t now)
+    {
+        if (now - rateMs >= MQTT_RATE_WINDOW_MS) {
+            sess.sentPerS = (stats().sent - rateSent) * 1000.0f / (now - rateMs);
+            rateSent = stats().sent;
+            rateMs = now;
+        }
+    }
+
+    SpscRing<Record, MQTT_QUEUE_LEN> queue;
+    portMUX_TYPE       lock = portMUX_INITIALIZER_UNLOCKED;
+    MqttConfig         pending = {};
+    bool               pendingSet = false;
+    Session            shared = {};
+
+    // MQTT task only
+    MqttConfig         cfg = {};
+    char               prefix[32] = "hydroguard/";
+    WiFiClient         sock;
+    ReconnectScheduler backoff;
+    bool               online = false;
+    bool               connAcked = false;
+    uint8_t            rx[64];
+    size_t             rxLen = 0;
+    uint16_t           nextId = 0;
+    Inflight           inflight[MQTT_INFLIGHT] = {};
+    uint32_t           lastTxMs = 0;
+    uint32_t           lastRxMs = 0;
+    uint32_t           pingMs = 0;
+    uint32_t           rateMs = 0;
+    uint32_t           rateSent = 0;
+    Session            sess = {};
+};
+
+MqttSink mqttSink;
+
+#endif // MQTT_SINK_H
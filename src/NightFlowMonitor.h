@@ -0,0 +1,168 @@
+#ifndef NIGHT_FLOW_MONITOR_H
+#define NIGHT_FLOW_MONITOR_H
+
+#include <Arduino.h>
+#include "LatencyHistogram.h"
+
+/* ─── Detector tuning ──────────────────────────────────────────────────── */
+constexpr uint32_t NIGHT_BLOCK_S          = 15 * 60;   // flow averaged over blocks this long
+constexpr uint8_t  NIGHT_MIN_BLOCKS       = 4;         // a night needs ≥ 1 h of coverage to count
+constexpr uint8_t  NIGHT_DEFAULT_START    = 1;         // quiet window, local hours [start, end)
+constexpr uint8_t  NIGHT_DEFAULT_END      = 5;
+constexpr float    NIGHT_DEFAULT_LPH      = 1.0f;      // sustained baseline above this is a leak
+constexpr uint8_t  NIGHT_DEFAULT_NIGHTS   = 3;         // consecutive nights before alerting
+
+/**
+ * Minimum-night-flow drip detector. During the quiet window nobody should
+ * be drawing water, so the lowest sustained flow (the minimum of 15-minute
+ * block averages taken from the totaliser) is the leak baseline. A night
+ * whose baseline stays above the threshold extends a streak; once the
+ * streak reaches the configured number of nights a slow leak is reported
+ * with the litres/day it costs; it clears after a night below threshold.
+ * State per sample is O(1): the current block, the running minimum and a
+ * fixed histogram of sample flow for the low percentile.
+ */
+class NightFlowMonitor
+{
+public:
+    struct Config
+    {
+        uint8_t startHour;
+        uint8_t endHour;
+        uint8_t nights;
+        uint8_t reserved;
+        float   thresholdLph;
+    };
+
+    /* Persisted once per night */
+    struct Persisted
+    {
+        Config   config;
+        uint8_t  streak;            // consecutive nights above threshold
+        uint8_t  flagged;           // slow leak currently reported
+        uint8_t  reserved[2];
+        float    lastBaselineLph;   // minimum sustained flow of the last night
+        float    lastP10Lph;
+        uint32_t nightsEvaluated;
+    };
+
+    enum Verdict : uint8_t
+    {
+        NIGHT_NONE,          // no night completed with this sample
+        NIGHT_EVALUATED,     // night completed, nothing to report
+        NIGHT_LEAK,          // streak just reached the limit
+        NIGHT_CLEARED        // flagged leak went back to zero
+    };
+
+    NightFlowMonitor()
+    {
+        state.config = {NIGHT_DEFAULT_START, NIGHT_DEFAULT_END, NIGHT_DEFAULT_NIGHTS, 0, NIGHT_DEFAULT_LPH};
+    }
+
+    void restore(const Persisted &p) { state = p; }
+    const Persisted &persisted() const { return state; }
+
+    bool configure(uint8_t startHour, uint8_t endHour, float thresholdLph, uint8_t nights)
+    {
+        if (startHour > 23 || endHour > 23 || startHour == endHour || thresholdLph <= 0 || !nights) {
+            return false;
+        }
+        state.config = {startHour, endHour, nights, 0, thresholdLph};
+        inWindow = false;
+        return true;
+    }
+
+    /**
+     * Feeds one sample.
+     * @param t       Local-time epoch seconds.
+     * @param litres  Totaliser reading.
+     * @param flowLpm Instantaneous flow, for the percentile.
+     */
+    Verdict update(uint32_t t, double litres, float flowLpm)
+    {
+        if (!isQuiet((t / 3600) % 24)) {
+            if (!inWindow) {
+                return NIGHT_NONE;
+            }
+            inWindow = false;
+            return evaluate();
+        }
+        if (!inWindow) {
+            inWindow = true;
+            blocks = 0;
+            minBlockLph = INFINITY;
+            samples.reset();
+            startBlock(t, litres);
+        }
+        samples.record((uint32_t)(flowLpm * 1000.0f));  // mL/min
+        if (t - blockStartT >= NIGHT_BLOCK_S) {
+            float lph = (float)((litres - blockStartL) * 3600.0 / (t - blockStartT));
+            if (lph < minBlockLph) {
+                minBlockLph = lph;
+            }
+            blocks++;
+            startBlock(t, litres);
+        }
+        return NIGHT_NONE;
+    }
+
+    bool  flagged() const { return state.flagged; }
+    uint8_t streak() const { return state.streak; }
+    float lastBaselineLph() const { return state.lastBaselineLph; }
+    float litresPerDay() const { return state.lastBaselineLph * 24.0f; }
+    const Config &config() const { return state.config; }
+
+    /* Tonight so far, while inside the window */
+    bool  active() const { return inWindow; }
+    float tonightLph() const { return blocks ? minBlockLph : NAN; }
+
+private:
+    bool isQuiet(uint8_t hour) const
+    {
+        const Config &c = state.config;
+        return c.startHour < c.endHour ? (hour >= c.startHour && hour < c.endHour)
+                                       : (hour >= c.startHour || hour < c.endHour);
+    }
+
+    void startBlock(uint32_t t, double litres)
+    {
+        blockStartT = t;
+        blockStartL = litres;
+    }
+
+    Verdict evaluate()
+    {
+        if (blocks < NIGHT_MIN_BLOCKS) {
+            return NIGHT_NONE;      // too little coverage (late boot, outage): skip the night
+        }
+        state.nightsEvaluated++;
+        state.lastBaselineLph = minBlockLph;
+        state.lastP10Lph = samples.percentile(10) * 60.0f / 1000.0f;
+        if (minBlockLph >= state.config.thresholdLph) {
+            if (state.streak < 255) {
+                state.streak++;
+            }
+            if (!state.flagged && state.streak >= state.config.nights) {
+                state.flagged = 1;
+                return NIGHT_LEAK;
+            }
+            return NIGHT_EVALUATED;
+        }
+        state.streak = 0;
+        if (state.flagged) {
+            state.flagged = 0;
+            return NIGHT_CLEARED;
+        }
+        return NIGHT_EVALUATED;
+    }
+
+    Persisted state = {};
+    LatencyHistogram<72> samples;   // sample flow in mL/min during the window
+    bool     inWindow = false;
+    uint8_t  blocks = 0;
+    float    minBlockLph = INFINITY;
+    uint32_t blockStartT = 0;
+    double   blockStartL = 0;
+};
+
+#endif // NIGHT_FLOW_MONITOR_H
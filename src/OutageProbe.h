@@ -0,0 +1,140 @@
+#ifndef OUTAGE_PROBE_H
+#define OUTAGE_PROBE_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "LatencyHistogram.h"
+
+constexpr uint32_t OUTAGE_MAX_S = 600;   // longest outage the console will simulate
+
+/**
+ * Measures how the pipeline behaves through a connectivity outage: the
+ * acquisition cadence and sample → shutoff latency seen by the safety
+ * task, the cloud task's loop gap, queue drops, and the time to get back
+ * to the cloud afterwards. While a simulated outage is active the
+ * connectivity state machine treats the AP as unreachable, so the real
+ * retry/timeout paths run. Each histogram is written by one task only;
+ * a new run is flagged and each writer resets its own histogram.
+ */
+class OutageProbe
+{
+public:
+    struct Result
+    {
+        uint32_t samples;
+        uint32_t acqGapP99Us;
+        uint32_t acqGapMaxUs;
+        uint32_t safetyP99Us;
+        uint32_t safetyMaxUs;
+        uint32_t budgetMisses;
+        uint32_t cloudGapMaxUs;
+        uint32_t reportDrops;
+        uint32_t eventDrops;
+        int32_t  reconnectMs;      // outage end → cloud, -1 until reconnected
+    };
+
+    /* Console side: starts a run; the drop counters are baselines */
+    void start(uint32_t durationS, uint32_t reportDrops, uint32_t eventDrops)
+    {
+        startUs = esp_timer_get_time();
+        endUs = startUs + (int64_t)durationS * 1000000;
+        reconnectUs = 0;
+        reportDropsAt = reportDrops;
+        eventDropsAt = eventDrops;
+        safetyReset = cloudReset = true;
+        active = true;
+    }
+
+    /* True while connectivity should be held down */
+    bool simulating() const { return active && esp_timer_get_time() < endUs; }
+    bool running() const { return active; }
+
+    /* Safety task, once per sample */
+    void recordSample(int64_t acquiredUs, uint32_t latencyUs, bool overBudget)
+    {
+        if (!active) {
+            return;
+        }
+        if (safetyReset) {
+            safetyReset = false;
+            acqGap.reset();
+            safety.reset();
+            misses = 0;
+            lastAcquiredUs = 0;
+        }
+        if (lastAcquiredUs) {
+            acqGap.record((uint32_t)(acquiredUs - lastAcquiredUs));
+        }
+        lastAcquiredUs = acquiredUs;
+        safety.record(latencyUs);
+        if (overBudget) {
+            misses++;
+        }
+    }
+
+    /**
+     * Cloud task, once per loop pass. Ends the run at the first cloud
+     * connection after the simulated outage.
+     */
+    void cloudPass(bool cloudConnected)
+    {
+        if (!active) {
+            return;
+        }
+        int64_t now = esp_timer_get_time();
+        if (cloudReset) {
+            cloudReset = false;
+            cloudGap.reset();
+            lastPassUs = now;
+        }
+        cloudGap.record((uint32_t)(now - lastPassUs));
+        lastPassUs = now;
+        if (now >= endUs && cloudConnected) {
+            reconnectUs = now;
+            active = false;
+        }
+    }
+
+    Result result(uint32_t reportDrops, uint32_t eventDrops) const
+    {
+        Result r;
+        r.samples = safety.samples();
+        r.acqGapP99Us = acqGap.percentile(99);
+        r.acqGapMaxUs = acqGap.max();
+        r.safetyP99Us = safety.percentile(99);
+        r.safetyMaxUs = safety.max();
+        r.budgetMisses = misses;
+        r.cloudGapMaxUs = cloudGap.max();
+        r.reportDrops = reportDrops - reportDropsAt;
+        r.eventDrops = eventDrops - eventDropsAt;
+        r.reconnectMs = reconnectUs ? (int32_t)((reconnectUs - endUs) / 1000) : -1;
+        return r;
+    }
+
+    uint32_t elapsedS() const
+    {
+        return startUs ? (uint32_t)(((active ? esp_timer_get_time() : reconnectUs) - startUs) / 1000000) : 0;
+    }
+
+private:
+    volatile bool active = false;
+    volatile bool safetyReset = false;
+    volatile bool cloudReset = false;
+    int64_t  startUs = 0;
+    int64_t  endUs = 0;
+    int64_t  reconnectUs = 0;
+    uint32_t reportDropsAt = 0;
+    uint32_t eventDropsAt = 0;
+
+    LatencyHistogram<96> acqGap;      // safety task
+    LatencyHistogram<96> safety;      // safety task
+    int64_t  lastAcquiredUs = 0;
+    uint32_t misses = 0;
+
+    LatencyHistogram<96> cloudGap;    // cloud task
+    int64_t  lastPassUs = 0;
+};
+
+OutageProbe outageProbe;
+
+#endif // OUTAGE_PROBE_H
@@ -0,0 +1,208 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <Arduino.h>
+#include "LatencyHistogram.h"
+#include "SpscRing.h"
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #include "esp_timer.h"
+}
+
+/* ─── Task layout ──────────────────────────────────────────────────────── */
+// Core 0 carries Wi-Fi/TLS and the cloud task; core 1 is kept for the
+// acquisition → safety path so connectivity stalls cannot delay it.
+constexpr BaseType_t CLOUD_CORE        = 0;
+constexpr BaseType_t SENSOR_CORE       = 1;
+
+constexpr UBaseType_t SAFETY_PRIORITY  = 6;   // valve/leak decisions preempt everything
+constexpr UBaseType_t ACQ_PRIORITY     = 5;
+constexpr UBaseType_t CLOUD_PRIORITY   = 2;
+constexpr UBaseType_t MQTT_PRIORITY    = 2;   // peer of the cloud task; neither waits on the other
+constexpr UBaseType_t LAN_PRIORITY     = 1;   // local streaming yields to the cloud task
+
+constexpr uint32_t SAFETY_STACK        = 6144;
+constexpr uint32_t ACQ_STACK           = 4096;
+constexpr uint32_t CLOUD_STACK         = 12288;  // TLS handshake lives here
+constexpr uint32_t MQTT_STACK          = 6144;
+constexpr uint32_t LAN_STACK           = 4096;
+
+constexpr uint32_t ACQ_PERIOD_MS       = 5000;   // meter poll interval
+constexpr uint32_t TRACE_PERIOD_MS     = 20;     // pressure trace between polls while a LAN client streams
+constexpr uint32_t LAN_POLL_MS         = 5;
+constexpr uint32_t MQTT_POLL_MS        = 20;
+constexpr uint32_t SAFETY_TICK_MS      = 50;     // valve supervision when no sample arrives
+constexpr uint32_t SAFETY_BUDGET_US    = 100000; // sample → shutoff decision hard budget
+
+// Every boundary has a single producer and a single consumer (powers of two)
+constexpr size_t SAMPLE_QUEUE_LEN      = 8;    // acquire → safety
+constexpr size_t REPORT_QUEUE_LEN      = 4;    // safety  → cloud
+constexpr size_t EVENT_QUEUE_LEN       = 16;   // safety  → cloud
+constexpr size_t CONTROL_QUEUE_LEN     = 8;    // cloud   → safety
+constexpr size_t REPORT_BATCH          = REPORT_QUEUE_LEN; // reports sent per cloud pass
+
+/* ─── Messages ─────────────────────────────────────────────────────────── */
+
+/* One acquisition pass over all sensors */
+typedef struct
+{
+    int64_t  acquiredUs;     // esp_timer time the sample was taken
+    uint32_t acquiredMs;
+    uint64_t epochMs;        // UTC wall-clock time of the sample, 0 before the clock is set
+    bool     flowValid;
+    float    flowrate;       // L/hr as reported by the meter
+    double   cumulativeFlow;
+    uint16_t uvAdc;
+    float    pressure1;      // kPa
+    float    pressure2;      // kPa
+} Sample_t;
+
+/* Values published to the cloud for one report */
+typedef struct
+{
+    uint64_t epochMs;        // acquisition time, carried through to the cloud
+    float    flowrate;
+    double   cumulativeflow;
+    float    irradiance;
+    float    dosage;
+    float    pressure1;
+    float    pressure2;
+    float    blockagePercentage;
+    float    underDosedLitres;
+    float    lampHours;
+    float    lampHoursLeft;
+    uint32_t valveLatencyMs;
+    bool     hasValveLatency;
+    uint32_t safetyP99Us;
+} Report_t;
+
+enum CloudEventType : uint8_t
+{
+    CLOUD_LOG_EVENT,
+    CLOUD_RESOLVE_EVENT,
+    CLOUD_WRITE_PIN,
+    CLOUD_WRITE_TEXT         // msg written to pin
+};
+
+/* Alerts and pin updates raised off the cloud task */
+typedef struct
+{
+    CloudEventType type;
+    uint8_t        pin;
+    const char    *name;     // event code, must be a string literal
+    float          value;
+    char           msg[96];
+} CloudEvent_t;
+
+enum ControlType : uint8_t
+{
+    CTRL_VALVE_MANUAL,       // value 1 = user closed, 0 = user released
+    CTRL_SHUTOFF_OVERRIDE,   // value 1 = auto shutoff disabled
+    CTRL_FLOW_THRESHOLD,     // value = L/min
+    CTRL_LAMP_RESET,
+    CTRL_NIGHTFLOW_CONFIG,   // value = start hour, args = end hour, L/h, nights
+    CTRL_FLOW_LIMITS,        // value = max minutes, args[0] = max litres
+    CTRL_POWER_CONFIG,       // value = PowerMode, args = period s, upload minutes
+    CTRL_TIMEZONE,           // persist wallClock.timezone(), already applied
+    CTRL_MQTT_CONFIG         // persist mqttSink.config(), already queued
+};
+
+/* Commands from cloud handlers/console to the safety task */
+typedef struct
+{
+    ControlType type;
+    float       value;
+    float       args[3];     // extra parameters for multi-value commands
+} Control_t;
+
+/* ─── Queues ───────────────────────────────────────────────────────────── */
+struct QueueStats
+{
+    size_t   length;
+    size_t   peak;
+    uint32_t drops;
+};
+
+/**
+ * Lock-free SPSC queue between two tasks. push() never blocks; a full
+ * queue counts a drop. When a consumer task is attached, push() wakes it
+ * with a task notification so pop() can sleep instead of polling.
+ */
+template <typename T, size_t N>
+struct PipelineQueue : QueueStats
+{
+    SpscRing<T, N> ring;
+    TaskHandle_t  *consumer = nullptr;
+
+    PipelineQueue() : QueueStats{N, 0, 0} {}
+
+    void attach(TaskHandle_t *task) { consumer = task; }
+
+    bool push(const T &item)
+    {
+        if (!ring.push(item)) {
+            drops++;
+            return false;
+        }
+        size_t depth = ring.size();
+        if (depth > peak) {
+            peak = depth;
+        }
+        if (consumer && *consumer) {
+            xTaskNotifyGive(*consumer);
+        }
+        return true;
+    }
+
+    bool empty() const { return ring.empty(); }
+
+    /* Moves out everything queued, up to max items, without waiting */
+    size_t popBatch(T *items, size_t max)
+    {
+        return ring.popBatch(items, max);
+    }
+
+    bool pop(T &item, TickType_t wait = 0)
+    {
+        if (ring.pop(item)) {
+            return true;
+        }
+        if (wait == 0) {
+            return false;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+        return ring.pop(item);
+    }
+};
+
+PipelineQueue<Sample_t, SAMPLE_QUEUE_LEN>      sampleQueue;
+PipelineQueue<Report_t, REPORT_QUEUE_LEN>      reportQueue;
+PipelineQueue<CloudEvent_t, EVENT_QUEUE_LEN>   eventQueue;
+PipelineQueue<Control_t, CONTROL_QUEUE_LEN>    controlQueue;
+
+TaskHandle_t acquisitionTaskHandle = nullptr;
+TaskHandle_t safetyTaskHandle = nullptr;
+TaskHandle_t cloudTaskHandle = nullptr;
+TaskHandle_t mqttTaskHandle = nullptr;
+TaskHandle_t lanTaskHandle = nullptr;
+
+// Sample → shutoff decision latency in µs, measured by the safety task
+LatencyHistogram<96> safetyLatency;
+uint32_t safetyBudgetMisses = 0;
+volatile uint32_t samplesProcessed = 0;   // lets the acquisition task see the safety task is done
+
+/* ─── Commands to the safety task ──────────────────────────────────────── */
+void postControl(ControlType type, float value = 0.0f)
+{
+    Control_t c = {type, value, {}};
+    controlQueue.push(c);
+}
+
+void postControl(ControlType type, float value, float a0, float a1, float a2)
+{
+    Control_t c = {type, value, {a0, a1, a2}};
+    controlQueue.push(c);
+}
+
+#endif // PIPELINE_H
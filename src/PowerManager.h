@@ -0,0 +1,492 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_attr.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+#include <driver/gpio.h>
+#include <driver/rtc_io.h>
+
+/* ─── Modes ────────────────────────────────────────────────────────────── */
+enum PowerMode : uint8_t
+{
+    POWER_ALWAYS_ON,        // mains: radio up, fixed acquisition period
+    POWER_LIGHT_SLEEP,      // light sleep between samples, radio only for uploads
+    POWER_DEEP_SLEEP,       // deep sleep between idle samples, state kept in RTC memory
+    POWER_MODES
+};
+constexpr const char *POWER_MODE_NAMES[POWER_MODES] = {"on", "light", "deep"};
+
+constexpr uint16_t POWER_DEFAULT_UPLOAD_MIN = 15;       // batched upload interval
+constexpr uint32_t POWER_MIN_WINDOW_MS      = 3000;     // stay online this long for app commands
+constexpr uint32_t POWER_UPLOAD_TIMEOUT_MS  = 60000;    // give up on an upload window after this
+constexpr uint32_t POWER_MIN_SLEEP_MS       = 50;       // shorter gaps are not worth a sleep
+constexpr uint32_t POWER_SETTLE_MS          = 500;      // wait this long for the pipeline to go quiet
+constexpr uint32_t POWER_HOUR_MS            = 3600000;
+constexpr uint8_t  POWER_HISTORY_HOURS      = 24;
+constexpr uint8_t  POWER_MAX_WAKE_PINS      = 2;
+
+//#define FLOW_WAKE_PIN         5       // meter activity/pulse output, active low
+
+/* Current model for the budget (mA); board and sensor quiescent draw comes on top */
+constexpr float POWER_ACTIVE_MA     = 40.0f;    // CPUs running, radio off
+constexpr float POWER_RADIO_MA      = 120.0f;   // CPUs running, Wi-Fi associated / TLS
+constexpr float POWER_LIGHT_MA      = 0.25f;
+constexpr float POWER_DEEP_MA       = 0.01f;
+constexpr float POWER_BOARD_MA      = 0.0f;     // regulator, sensors, valve driver: set per hardware
+
+enum WakeCause : uint8_t
+{
+    WAKE_TIMER,
+    WAKE_BUTTON,
+    WAKE_FLOW,
+    WAKE_OTHER,
+    WAKE_CAUSES
+};
+constexpr const char *WAKE_CAUSE_NAMES[WAKE_CAUSES] = {"timer", "button", "flow", "other"};
+
+/* Time spent in each power state over one hour of elapsed time */
+struct EnergyHour
+{
+    uint32_t awakeMs;
+    uint32_t radioMs;       // part of awakeMs with the radio up
+    uint32_t lightMs;
+    uint32_t deepMs;
+    uint32_t wakes;
+
+    uint32_t elapsedMs() const { return awakeMs + lightMs + deepMs; }
+
+    float mAh() const
+    {
+        uint32_t radio = radioMs < awakeMs ? radioMs : awakeMs;
+        float mAms = (awakeMs - radio) * POWER_ACTIVE_MA + radio * POWER_RADIO_MA +
+                     lightMs * POWER_LIGHT_MA + deepMs * POWER_DEEP_MA + elapsedMs() * POWER_BOARD_MA;
+        return mAms / 3600000.0f;
+    }
+};
+
+/**
+ * Rolling energy budget: time awake, with the radio up, in light and in
+ * deep sleep, closed into hourly buckets by elapsed time rather than wall
+ * time so it works before the clock is set and across deep sleep. Plain
+ * data without constructors so it can live in RTC memory.
+ */
+struct EnergyLedger
+{
+    EnergyHour open;
+    EnergyHour hours[POWER_HISTORY_HOURS];
+    uint8_t    head;
+    uint8_t    filled;
+    uint8_t    reserved[2];
+    uint32_t   wakesByCause[WAKE_CAUSES];
+
+    void reset() { memset(this, 0, sizeof(*this)); }
+
+    /* Time past the end of the open hour is split pro rata, so a closed hour is exactly one hour */
+    void add(uint32_t awakeMs, uint32_t radioMs, uint32_t lightMs, uint32_t deepMs)
+    {
+        uint64_t total = (uint64_t)awakeMs + lightMs + deepMs;
+        while (open.elapsedMs() + total >= POWER_HOUR_MS) {
+            uint32_t room = POWER_HOUR_MS - open.elapsedMs();
+            uint32_t a = (uint32_t)((uint64_t)awakeMs * room / total);
+            uint32_t al = (uint32_t)(((uint64_t)awakeMs + lightMs) * room / total);
+            uint32_t r = awakeMs ? (uint32_t)((uint64_t)radioMs * a / awakeMs) : 0;
+            open.awakeMs += a;
+            open.radioMs += r;
+            open.lightMs += al - a;
+            open.deepMs += room - al;
+            closeHour();
+            awakeMs -= a;
+            radioMs -= r;
+            lightMs -= al - a;
+            deepMs -= room - al;
+            total -= room;
+        }
+        open.awakeMs += awakeMs;
+        open.radioMs += radioMs;
+        open.lightMs += lightMs;
+        open.deepMs += deepMs;
+    }
+
+    void wake(WakeCause c)
+    {
+        open.wakes++;
+        wakesByCause[c]++;
+    }
+
+    /* i = 0 is the oldest closed hour */
+    const EnergyHour &hour(uint8_t i) const
+    {
+        return hours[(head + POWER_HISTORY_HOURS - filled + i) % POWER_HISTORY_HOURS];
+    }
+
+    /* Closed hours summed, or the open hour until one has closed */
+    EnergyHour window() const
+    {
+        if (!filled) {
+            return open;
+        }
+        EnergyHour sum = {};
+        for (uint8_t i = 0; i < filled; i++) {
+            const EnergyHour &h = hour(i);
+            sum.awakeMs += h.awakeMs;
+            sum.radioMs += h.radioMs;
+            sum.lightMs += h.lightMs;
+            sum.deepMs += h.deepMs;
+            sum.wakes += h.wakes;
+        }
+        return sum;
+    }
+
+    void closeHour()
+    {
+        hours[head] = open;
+        head = (head + 1) % POWER_HISTORY_HOURS;
+        if (filled < POWER_HISTORY_HOURS) {
+            filled++;
+        }
+        memset(&open, 0, sizeof(open));
+    }
+
+    float mAhPerDay() const
+    {
+        EnergyHour w = window();
+        return w.elapsedMs() ? w.mAh() * 86400000.0f / w.elapsedMs() : 0.0f;
+    }
+
+    /* Awake milliseconds per hour of elapsed time */
+    float awakeMsPerHour() const
+    {
+        EnergyHour w = window();
+        return w.elapsedMs() ? (float)w.awakeMs * POWER_HOUR_MS / w.elapsedMs() : 0.0f;
+    }
+};
+
+/* Survives deep sleep and soft resets; validated by magic and size */
+struct PowerRetained
+{
+    uint32_t     magic;
+    uint32_t     size;
+    EnergyLedger ledger;
+    int64_t      sleepStartUs;    // system (RTC-backed) time the deep sleep began
+    uint32_t     msSinceUpload;   // upload clock carried across deep sleep
+    uint8_t      inDeepSleep;
+    uint8_t      reserved[3];
+};
+
+constexpr uint32_t POWER_RETAINED_MAGIC = 0x48475057;   // "HGPW"
+
+RTC_NOINIT_ATTR PowerRetained powerRetained;
+
+/**
+ * Low-power scheduling for battery-backed installs. The acquisition task
+ * asks it to sleep once the pipeline is quiet (light sleep keeps RAM, deep
+ * sleep restarts from setup() with state restored from RTC memory); the
+ * cloud task asks it whether the radio should be up, which in the sleep
+ * modes is only for a batched upload every few minutes or when an alert is
+ * waiting. Wakes on the timer, the user button or the meter activity pin.
+ * The ledger is written only by the acquisition task; radio time from the
+ * cloud task is handed over through an atomic counter.
+ */
+class PowerManager
+{
+public:
+    struct Config
+    {
+        uint8_t  mode;
+        uint8_t  reserved;
+        uint16_t periodS;       // acquisition period while sleeping
+        uint16_t uploadMin;     // radio comes up this often
+        uint16_t reserved2;
+    };
+
+    /**
+     * Call first in setup(): validates retained state and accounts a deep
+     * sleep that just ended.
+     * @param defaultPeriodS Acquisition period while sleeping, unless configured.
+     */
+    void begin(uint16_t defaultPeriodS)
+    {
+        defaultPeriod = defaultPeriodS;
+        cfg = {POWER_ALWAYS_ON, 0, defaultPeriodS, POWER_DEFAULT_UPLOAD_MIN, 0};
+        esp_reset_reason_t reason = esp_reset_reason();
+        if (powerRetained.magic != POWER_RETAINED_MAGIC || powerRetained.size != sizeof(PowerRetained) ||
+            reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT) {
+            memset(&powerRetained, 0, sizeof(powerRetained));
+            powerRetained.magic = POWER_RETAINED_MAGIC;
+            powerRetained.size = sizeof(PowerRetained);
+        }
+        bootCause = esp_sleep_get_wakeup_cause();
+        wokeFromDeep = powerRetained.inDeepSleep && bootCause != ESP_SLEEP_WAKEUP_UNDEFINED;
+        if (wokeFromDeep) {
+            // The system clock keeps running through deep sleep, so a pin wake is measured
+            // too; the time since this boot is already counted as awake
+            int64_t slept = systemUs() - powerRetained.sleepStartUs - (int64_t)esp_timer_get_time();
+            uint32_t sleptMs = slept > 0 ? (uint32_t)(slept / 1000) : 0;
+            powerRetained.ledger.add(0, 0, 0, sleptMs);
+            lastUploadMs = millis() - powerRetained.msSinceUpload - sleptMs;
+        }
+        powerRetained.inDeepSleep = 0;
+        awakeSinceUs = 0;   // boot time counts as awake
+        radioUp = !wokeFromDeep;   // a cold boot opens an upload window, a timer wake does not
+    }
+
+    /**
+     * Registers an active-low pin that wakes the unit from either sleep.
+     * @param edgeIsr The pin has an edge interrupt attached that must be
+     *                restored after a light-sleep wake.
+     */
+    void addWakePin(gpio_num_t pin, WakeCause cause, bool edgeIsr)
+    {
+        if (wakePinCount < POWER_MAX_WAKE_PINS) {
+            wakePins[wakePinCount++] = {pin, cause, edgeIsr};
+        }
+        if (wokeFromDeep && rtc_gpio_is_valid_gpio(pin)) {
+            rtc_gpio_deinit(pin);   // hand the pin back to the digital GPIO matrix
+        }
+    }
+
+    /* Call once the pin is driven again after a deep-sleep wake */
+    void releaseHold(gpio_num_t pin)
+    {
+        gpio_hold_dis(pin);
+        gpio_deep_sleep_hold_dis();
+    }
+
+    /* First wake of this boot, once the pins are set up */
+    void noteBootWake()
+    {
+        if (wokeFromDeep) {
+            WakeCause bootWake = classifyDeepWake(bootCause);
+            powerRetained.ledger.wake(bootWake);
+            if (bootWake == WAKE_BUTTON) {
+                uploadRequested = true;
+            }
+        }
+    }
+
+    void configure(const Config &c)
+    {
+        cfg = c;
+        if (cfg.mode >= POWER_MODES) {
+            cfg.mode = POWER_ALWAYS_ON;
+        }
+        if (!cfg.periodS) {
+            cfg.periodS = defaultPeriod;
+        }
+        if (!cfg.uploadMin) {
+            cfg.uploadMin = POWER_DEFAULT_UPLOAD_MIN;
+        }
+    }
+
+    const Config &config() const { return cfg; }
+    bool     lowPower() const { return cfg.mode != POWER_ALWAYS_ON; }
+    uint32_t periodMs() const { return (uint32_t)cfg.periodS * 1000; }
+    bool     wokeFromDeepSleep() const { return wokeFromDeep; }
+
+    /* ─── Cloud task side ─── */
+
+    /**
+     * Decides whether the radio should be up on this pass.
+     * @param urgent  Something (an alert) must go out now.
+     * @param drained Connected, with nothing left to upload.
+     */
+    bool radioWanted(uint32_t nowMs, bool urgent, bool drained)
+    {
+        if (!lowPower()) {
+            radioUp = true;
+            return true;
+        }
+        if (!radioUp) {
+            if (!urgent && !uploadRequested && nowMs - lastUploadMs < (uint32_t)cfg.uploadMin * 60000UL) {
+                return false;
+            }
+            radioUp = true;
+            uploadRequested = false;
+            windowStartMs = nowMs;
+            windows++;
+            return true;
+        }
+        uint32_t open = nowMs - windowStartMs;
+        if ((drained && open >= POWER_MIN_WINDOW_MS) || open >= POWER_UPLOAD_TIMEOUT_MS) {
+            // A failed window still waits a full interval, or a dead AP would drain the battery
+            if (!drained) {
+                failedWindows++;
+            }
+            radioUp = false;
+            lastUploadMs = nowMs;
+            return false;
+        }
+        return true;
+    }
+
+    void noteRadio(bool on, uint32_t nowMs)
+    {
+        if (on && radioWasOn) {
+            pendingRadioMs += nowMs - lastRadioNoteMs;
+        }
+        radioWasOn = on;
+        lastRadioNoteMs = nowMs;
+    }
+
+    void requestUpload() { uploadRequested = true; }
+    /**
+     * Reported at the end of every cloud pass.
+     * @param seen samplesProcessed as read at the start of the pass.
+     */
+    void setCloudIdle(bool idle, uint32_t seen) { idleThrough = idle ? seen : seen - 1; }
+
+    /* The cloud task went idle after handling everything up to this sample */
+    uint32_t cloudIdleThrough() const { return idleThrough; }
+    bool radioOn() const { return radioUp; }
+    uint32_t uploadWindows() const { return windows; }
+    uint32_t failedUploadWindows() const { return failedWindows; }
+
+    /* ─── Acquisition task side ─── */
+
+    /* Folds awake and radio time up to now into the ledger */
+    void account(int64_t nowUs)
+    {
+        uint32_t awakeMs = (uint32_t)((nowUs - awakeSinceUs) / 1000);
+        awakeSinceUs += (int64_t)awakeMs * 1000;
+        powerRetained.ledger.add(awakeMs, pendingRadioMs.exchange(0), 0, 0);
+    }
+
+    /* Light-sleeps for up to us; returns what woke the unit */
+    WakeCause lightSleep(uint64_t us)
+    {
+        account(esp_timer_get_time());
+        esp_sleep_enable_timer_wakeup(us);
+        for (uint8_t i = 0; i < wakePinCount; i++) {
+            // Level wake-up on a pin with an edge ISR would storm; the ISR is restored after
+            gpio_intr_disable(wakePins[i].pin);
+            gpio_wakeup_enable(wakePins[i].pin, GPIO_INTR_LOW_LEVEL);
+        }
+        if (wakePinCount) {
+            esp_sleep_enable_gpio_wakeup();
+        }
+
+        int64_t start = esp_timer_get_time();
+        esp_light_sleep_start();
+        int64_t end = esp_timer_get_time();
+
+        WakeCause cause = WAKE_OTHER;
+        esp_sleep_wakeup_cause_t c = esp_sleep_get_wakeup_cause();
+        if (c == ESP_SLEEP_WAKEUP_TIMER) {
+            cause = WAKE_TIMER;
+        }
+        for (uint8_t i = 0; i < wakePinCount; i++) {
+            if (c == ESP_SLEEP_WAKEUP_GPIO && !gpio_get_level(wakePins[i].pin)) {
+                cause = wakePins[i].cause;
+            }
+            gpio_wakeup_disable(wakePins[i].pin);
+            if (wakePins[i].edgeIsr) {
+                gpio_set_intr_type(wakePins[i].pin, GPIO_INTR_ANYEDGE);
+                gpio_intr_enable(wakePins[i].pin);
+            }
+        }
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+
+        powerRetained.ledger.add(0, 0, (uint32_t)((end - start) / 1000), 0);
+        powerRetained.ledger.wake(cause);
+        awakeSinceUs = end;
+        if (cause == WAKE_BUTTON) {
+            uploadRequested = true;
+        }
+        return cause;
+    }
+
+    /* Deep-sleeps for us with holdPin latched at its level; does not return */
+    void deepSleep(uint64_t us, gpio_num_t holdPin)
+    {
+        uint32_t nowMs = millis();
+        account(esp_timer_get_time());
+        powerRetained.sleepStartUs = systemUs();
+        powerRetained.msSinceUpload = nowMs - lastUploadMs;
+        powerRetained.inDeepSleep = 1;
+
+        esp_sleep_enable_timer_wakeup(us);
+        // ext0 takes the first pin and ext1 (all-low) the second, so either one wakes the unit
+        esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+        for (uint8_t i = 0; i < wakePinCount; i++) {
+            gpio_num_t pin = wakePins[i].pin;
+            if (!rtc_gpio_is_valid_gpio(pin)) {
+                continue;
+            }
+            rtc_gpio_pullup_en(pin);
+            rtc_gpio_pulldown_dis(pin);
+            if (i == 0) {
+                esp_sleep_enable_ext0_wakeup(pin, 0);
+            } else {
+                esp_sleep_enable_ext1_wakeup(1ULL << pin, ESP_EXT1_WAKEUP_ALL_LOW);
+            }
+        }
+        gpio_hold_en(holdPin);
+        gpio_deep_sleep_hold_en();
+        esp_deep_sleep_start();
+    }
+
+    const EnergyLedger &ledger() const { return powerRetained.ledger; }
+
+private:
+    struct WakePin
+    {
+        gpio_num_t pin;
+        WakeCause  cause;
+        bool       edgeIsr;
+    };
+
+    /* System time in µs; unlike esp_timer it keeps counting through deep sleep */
+    static int64_t systemUs()
+    {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+
+    WakeCause classifyDeepWake(esp_sleep_wakeup_cause_t cause) const
+    {
+        if (cause == ESP_SLEEP_WAKEUP_TIMER) {
+            return WAKE_TIMER;
+        }
+        if (cause == ESP_SLEEP_WAKEUP_EXT0 && wakePinCount) {
+            return wakePins[0].cause;
+        }
+        if (cause == ESP_SLEEP_WAKEUP_EXT1) {
+            uint64_t status = esp_sleep_get_ext1_wakeup_status();
+            for (uint8_t i = 0; i < wakePinCount; i++) {
+                if (status & (1ULL << wakePins[i].pin)) {
+                    return wakePins[i].cause;
+                }
+            }
+        }
+        return WAKE_OTHER;
+    }
+
+    Config   cfg = {};
+    WakePin  wakePins[POWER_MAX_WAKE_PINS] = {};
+    uint8_t  wakePinCount = 0;
+    uint16_t defaultPeriod = 0;
+    bool     wokeFromDeep = false;
+    esp_sleep_wakeup_cause_t bootCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+    int64_t  awakeSinceUs = 0;
+
+    // Cloud task
+    volatile bool radioUp = true;
+    volatile uint32_t idleThrough = UINT32_MAX;
+    volatile bool uploadRequested = false;
+    uint32_t lastUploadMs = 0;
+    uint32_t windowStartMs = 0;
+    uint32_t lastRadioNoteMs = 0;
+    bool     radioWasOn = false;
+    uint32_t windows = 0;
+    uint32_t failedWindows = 0;
+    std::atomic<uint32_t> pendingRadioMs{0};
+};
+
+PowerManager powerManager;
+
+#endif // POWER_MANAGER_H
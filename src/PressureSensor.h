@@ -51,6 +51,18 @@ inline uint16_t readPressureRaw_ch2() { return applyMovingAverage(analogRead(PRE
 inline float readPressureKpa_ch1() { return adcToKpa(readPressureRaw_ch1()); }
 inline float readPressureKpa_ch2() { return adcToKpa(readPressureRaw_ch2()); }
 
+/* Fills both moving-average windows from one conversion each, so the
+   first filtered readings are not dragged towards zero */
+inline void primePressureFilters()
+{
+    uint16_t ch1 = analogRead(PRESSCH1);
+    uint16_t ch2 = analogRead(PRESSCH2);
+    for (int i = 0; i < WINDOW_SIZE; ++i) {
+        readings1[i] = ch1;
+        readings2[i] = ch2;
+    }
+}
+
 /* Optional: reset both moving-average buffers */
 inline void resetPressureFilters()
 {
@@ -0,0 +1,180 @@
+#ifndef RECONNECT_SCHEDULER_H
+#define RECONNECT_SCHEDULER_H
+
+#include <Arduino.h>
+#include "LatencyHistogram.h"
+
+/* ─── Backoff policy ───────────────────────────────────────────────────── */
+constexpr uint32_t RECONNECT_BASE_MS        = 2000;     // wait after the first failure
+constexpr uint32_t RECONNECT_CAP_MS         = 120000;   // longest wait between attempts
+constexpr uint32_t RECONNECT_MIN_TIMEOUT_MS = 10000;    // adaptive attempt timeout bounds;
+                                                        // the upper bound is the caller's
+constexpr uint8_t  RECONNECT_TIMEOUT_FACTOR = 4;        // × mean successful connect time
+
+enum LinkStage : uint8_t
+{
+    LINK_NET,       // association + IP
+    LINK_CLOUD,     // TCP/TLS + Blynk login
+    LINK_STAGES
+};
+
+constexpr const char *LINK_STAGE_NAMES[LINK_STAGES] = {"net", "cloud"};
+
+/**
+ * Decides when the connectivity state machine may start the next Wi-Fi or
+ * cloud attempt, and keeps connection metrics. Failures back off
+ * exponentially up to RECONNECT_CAP_MS with "equal jitter": each wait is
+ * half the exponential step plus a random half, so a fleet that lost the
+ * same router spreads its retries instead of hitting the AP together.
+ * A fresh network link clears the cloud backoff (fast retry on link-up).
+ * Attempt timeouts adapt to the connect times actually seen. Time is
+ * passed in by the caller, so the whole policy runs on a host against
+ * virtual time.
+ */
+class ReconnectScheduler
+{
+public:
+    struct StageStats
+    {
+        uint32_t attempts;
+        uint32_t successes;
+        uint32_t failures;
+        uint32_t failStreak;         // consecutive failures, drives the backoff
+        uint32_t waitMs;             // current backoff
+        uint32_t lastConnectMs;      // duration of the last successful attempt
+        LatencyHistogram<64> connectMs;
+    };
+
+    void begin(uint32_t seed) { rng = seed ? seed : 0x9E3779B9; }
+
+    /* True if an attempt at this stage may start now */
+    bool due(LinkStage s, uint32_t now) const
+    {
+        return (int32_t)(now - notBefore[s]) >= 0;
+    }
+
+    /* ms until the next attempt may start, 0 if due */
+    uint32_t waitLeft(LinkStage s, uint32_t now) const
+    {
+        return due(s, now) ? 0 : notBefore[s] - now;
+    }
+
+    /**
+     * Timeout for the next attempt: a multiple of the mean successful
+     * connect time, bounded by RECONNECT_MIN_TIMEOUT_MS and maxMs.
+     */
+    uint32_t attemptTimeout(LinkStage s, uint32_t maxMs) const
+    {
+        const StageStats &st = stats[s];
+        if (!st.connectMs.samples()) {
+            return maxMs;
+        }
+        uint32_t t = st.connectMs.mean() * RECONNECT_TIMEOUT_FACTOR;
+        return t < RECONNECT_MIN_TIMEOUT_MS ? RECONNECT_MIN_TIMEOUT_MS : (t > maxMs ? maxMs : t);
+    }
+
+    /**
+     * An established link dropped. The first retry is spread over
+     * RECONNECT_BASE_MS so devices that lost the same AP together do not
+     * all come back in the same instant.
+     */
+    void lost(LinkStage s, uint32_t now)
+    {
+        notBefore[s] = now + next() % RECONNECT_BASE_MS;
+    }
+
+    void started(LinkStage s, uint32_t now)
+    {
+        stats[s].attempts++;
+        startedAt[s] = now;
+    }
+
+    void succeeded(LinkStage s, uint32_t now)
+    {
+        StageStats &st = stats[s];
+        st.successes++;
+        st.failStreak = 0;
+        st.waitMs = 0;
+        st.lastConnectMs = now - startedAt[s];
+        st.connectMs.record(st.lastConnectMs);
+        notBefore[s] = now;
+        if (s == LINK_NET) {
+            // Link just came up: whatever kept the cloud away may be gone too
+            stats[LINK_CLOUD].failStreak = 0;
+            stats[LINK_CLOUD].waitMs = 0;
+            notBefore[LINK_CLOUD] = now;
+        }
+    }
+
+    /**
+     * @param backoff False for attempts that say nothing about the remote
+     *                end (fast-path miss, link lost mid-login): retry now.
+     */
+    void failed(LinkStage s, uint32_t now, bool backoff = true)
+    {
+        StageStats &st = stats[s];
+        st.failures++;
+        if (!backoff) {
+            notBefore[s] = now;
+            return;
+        }
+        uint32_t step = RECONNECT_BASE_MS;
+        for (uint32_t i = 0; i < st.failStreak && step < RECONNECT_CAP_MS; i++) {
+            step *= 2;
+        }
+        if (step > RECONNECT_CAP_MS) {
+            step = RECONNECT_CAP_MS;
+        }
+        st.failStreak++;
+        st.waitMs = step / 2 + next() % (step / 2 + 1);
+        notBefore[s] = now + st.waitMs;
+    }
+
+    /**
+     * Uptime accounting; call on every pass the radio is meant to be up.
+     * Gaps after pause() (radio deliberately off) are not counted.
+     */
+    void track(bool netUp, bool cloudUp, uint32_t now)
+    {
+        if (tracking) {
+            uint32_t dt = now - lastTrack;
+            totalMs += dt;
+            upMs[LINK_NET] += netUp ? dt : 0;
+            upMs[LINK_CLOUD] += cloudUp ? dt : 0;
+        }
+        tracking = true;
+        lastTrack = now;
+    }
+
+    void pause() { tracking = false; }
+
+    /* Fraction of tracked time the stage was up, 0..1 */
+    float uptime(LinkStage s) const { return totalMs ? (float)upMs[s] / totalMs : 0.0f; }
+    uint64_t trackedMs() const { return totalMs; }
+
+    const StageStats &stage(LinkStage s) const { return stats[s]; }
+
+private:
+    /* xorshift32: jitter only needs to differ between devices */
+    uint32_t next()
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    }
+
+    StageStats stats[LINK_STAGES] = {};
+    uint32_t   notBefore[LINK_STAGES] = {};
+    uint32_t   startedAt[LINK_STAGES] = {};
+    uint32_t   rng = 0x9E3779B9;
+
+    bool       tracking = false;
+    uint32_t   lastTrack = 0;
+    uint64_t   totalMs = 0;
+    uint64_t   upMs[LINK_STAGES] = {};
+};
+
+ReconnectScheduler reconnect;
+
+#endif // RECONNECT_SCHEDULER_H
@@ -1,33 +1,228 @@
-#include <EEPROM.h>
+#ifndef SERVO_H
+#define SERVO_H
+
+#include <Arduino.h>
 #include "debug.h"
+#include "LogStore.h"
+#include "LatencyHistogram.h"
 #define SERVOPIN 4
-#define EEPROM_SIZE 1
 
+/* Optional position feedback - define whichever your valve provides */
+//#define VALVE_FB_OPEN_PIN       15      // end-stop, active low when fully open
+//#define VALVE_FB_CLOSED_PIN     16      // end-stop, active low when fully shut
+//#define VALVE_CURRENT_PIN       8       // motor current-sense ADC input
+
+constexpr uint32_t VALVE_SETTLE_MS        = 500;    // assumed travel time without feedback
+constexpr uint32_t VALVE_STUCK_TIMEOUT_MS = 10000;  // no confirmation by then = stuck
+constexpr uint16_t VALVE_CURRENT_IDLE_ADC = 200;    // motor current below this = stopped
+constexpr uint32_t VALVE_CURRENT_INRUSH_MS = 100;   // ignore current sense while starting
+
+#if defined(VALVE_FB_OPEN_PIN) || defined(VALVE_FB_CLOSED_PIN)
+static volatile uint32_t valveEdgeMs = 0;
+
+void IRAM_ATTR valveEndStopIsr()
+{
+    valveEdgeMs = millis();
+}
+#endif
+
+/**
+ * Non-blocking valve driver. A command only drives the pin when it changes
+ * the target position; the motion then completes in the background.
+ * With end-stop or current-sense feedback the move is confirmed when the
+ * valve actually arrives (end-stop edge, or motor current dropping back to
+ * idle) and the command-to-position latency goes into a histogram; a move
+ * that is not confirmed within VALVE_STUCK_TIMEOUT_MS is flagged as stuck.
+ * Stuck only latches the target it failed on: repeated automatic opens
+ * are ignored (so the control loop does not re-drive and re-alert every
+ * pass) until a user or console command retries, while feedback is still
+ * polled so a late arrival clears it. A close, or a change of direction,
+ * always drives the pin and restarts the stuck timer, so the safety
+ * shutoffs are never swallowed. One stuck event is raised per target
+ * position.
+ * Without feedback the valve is assumed settled after VALVE_SETTLE_MS.
+ * The settled position is held in a write-behind cache and appended to the
+ * state log only when it differs from what is already stored.
+ */
+class ValveActuator
+{
+public:
+    enum State : uint8_t
+    {
+        VALVE_CLOSED,
+        VALVE_OPENING,
+        VALVE_OPEN,
+        VALVE_CLOSING,
+        VALVE_STUCK
+    };
+
+    /* Restores the last settled position (call after stateStore.begin) */
+    void begin()
+    {
+        uint8_t open;
+        storedOpen = stateStore.readValue(LOG_KEY_VALVE, open) ? open : true;
+        pinMode(SERVOPIN, OUTPUT);
+        digitalWrite(SERVOPIN, storedOpen ? HIGH : LOW);
+        state = storedOpen ? VALVE_OPEN : VALVE_CLOSED;
+        target = storedOpen;
+#ifdef VALVE_FB_OPEN_PIN
+        pinMode(VALVE_FB_OPEN_PIN, INPUT_PULLUP);
+        attachInterrupt(VALVE_FB_OPEN_PIN, valveEndStopIsr, FALLING);
+#endif
+#ifdef VALVE_FB_CLOSED_PIN
+        pinMode(VALVE_FB_CLOSED_PIN, INPUT_PULLUP);
+        attachInterrupt(VALVE_FB_CLOSED_PIN, valveEndStopIsr, FALLING);
+#endif
+#ifdef VALVE_CURRENT_PIN
+        pinMode(VALVE_CURRENT_PIN, ANALOG);
+#endif
+    }
 
-uint8_t addr = 0;
-uint8_t isValveOn;
+    /**
+     * Requests a position.
+     * @param userRetry True for an explicit user/console command, which
+     *                  also clears a stuck latch and drives again.
+     * @return True if this changed the target position or was a user
+     *         retry of a stuck valve; false if the valve is already at (or
+     *         moving to) the requested position. A close repeated on a
+     *         stuck valve drives again but returns false, so callers do
+     *         not re-alert.
+     */
+    bool command(bool open, bool userRetry = false)
+    {
+        bool retarget = open != target;
+        if (!retarget && (state != VALVE_STUCK || (open && !userRetry))) {
+            return false;
+        }
+        debugln(open ? "on message received" : "off message received");
+        if (retarget) {
+            stuckReported = false;
+        }
+        target = open;
+        digitalWrite(SERVOPIN, open ? HIGH : LOW);
+        state = open ? VALVE_OPENING : VALVE_CLOSING;
+        moveStartMs = millis();
+        return retarget || userRetry;
+    }
 
+    /* Tracks pending motion and flushes the position cache */
+    void run()
+    {
+        if (!isMoving() && state != VALVE_STUCK) {
+            return;
+        }
+        uint32_t now = millis();
+        uint32_t arrivedMs = now;
+        switch (checkPosition(now, arrivedMs)) {
+        case POSITION_PENDING:
+            if (state != VALVE_STUCK && now - moveStartMs >= VALVE_STUCK_TIMEOUT_MS) {
+                state = VALVE_STUCK;
+                stuckCount++;
+                stuckPending = !stuckReported;
+                stuckReported = true;
+                debugln("Valve did not reach position, flagged as stuck");
+            }
+            return;
+        case POSITION_CONFIRMED:
+            if (state == VALVE_STUCK) {
+                debugln("Stuck valve reached position late, latch cleared");
+            }
+            latency.record(arrivedMs - moveStartMs);
+            break;
+        case POSITION_ASSUMED:
+            unconfirmedCount++;
+            break;
+        }
+        state = target ? VALVE_OPEN : VALVE_CLOSED;
+        if (storedOpen != target) {
+            storedOpen = target;
+            stateStore.writeValue(LOG_KEY_VALVE, (uint8_t)storedOpen);
+            commits++;
+        }
+    }
 
-void valveOn()
+    State    getState()  const { return state; }
+    bool     isOpen()    const { return state == VALVE_OPEN; }
+    bool     isMoving()  const { return state == VALVE_OPENING || state == VALVE_CLOSING; }
+    bool     targetOpen() const { return target; }
+    uint32_t flashCommits() const { return commits; }
+    uint32_t stuckEvents() const { return stuckCount; }
+    uint32_t unconfirmedMoves() const { return unconfirmedCount; }
+
+    /* Returns true once for every new stuck detection */
+    bool takeStuckEvent()
+    {
+        bool pending = stuckPending;
+        stuckPending = false;
+        return pending;
+    }
+
+    // Command-to-confirmed-position latency in ms (moves confirmed by feedback)
+    LatencyHistogram<64> latency;
+
+private:
+    enum PositionCheck : uint8_t
+    {
+        POSITION_PENDING,
+        POSITION_CONFIRMED,     // feedback saw the valve arrive at arrivedMs
+        POSITION_ASSUMED        // no feedback for this direction, settle time elapsed
+    };
+
+    PositionCheck checkPosition(uint32_t now, uint32_t &arrivedMs)
+    {
+        int endStop = -1;
+        (void)endStop;
+        (void)arrivedMs;
+#ifdef VALVE_FB_OPEN_PIN
+        if (target) endStop = VALVE_FB_OPEN_PIN;
+#endif
+#ifdef VALVE_FB_CLOSED_PIN
+        if (!target) endStop = VALVE_FB_CLOSED_PIN;
+#endif
+#if defined(VALVE_FB_OPEN_PIN) || defined(VALVE_FB_CLOSED_PIN)
+        if (endStop >= 0) {
+            if (digitalRead(endStop) != LOW) {
+                return POSITION_PENDING;
+            }
+            // Prefer the ISR edge time when it belongs to this move
+            uint32_t edge = valveEdgeMs;
+            arrivedMs = (edge - moveStartMs <= now - moveStartMs) ? edge : now;
+            return POSITION_CONFIRMED;
+        }
+#endif
+#ifdef VALVE_CURRENT_PIN
+        if (now - moveStartMs < VALVE_CURRENT_INRUSH_MS ||
+            analogRead(VALVE_CURRENT_PIN) >= VALVE_CURRENT_IDLE_ADC) {
+            return POSITION_PENDING;
+        }
+        arrivedMs = now;
+        return POSITION_CONFIRMED;
+#else
+        return (now - moveStartMs >= VALVE_SETTLE_MS) ? POSITION_ASSUMED : POSITION_PENDING;
+#endif
+    }
+
+    State    state = VALVE_CLOSED;
+    bool     target = false;
+    bool     storedOpen = false;
+    uint32_t moveStartMs = 0;
+    uint32_t commits = 0;
+    uint32_t stuckCount = 0;
+    uint32_t unconfirmedCount = 0;
+    bool     stuckPending = false;
+    bool     stuckReported = false;  // event already raised for this target
+};
+
+ValveActuator valve;
+
+bool valveOn()
 {
-    debugln("on message received");
-    //myservo.writeMicroseconds(1900);
-    pinMode(SERVOPIN, OUTPUT);
-    digitalWrite(SERVOPIN, HIGH);
-    delay(500);
-    isValveOn = 1;
-    EEPROM.writeBool(addr, isValveOn);
-    EEPROM.commit();
+    return valve.command(true);
 }
 
-void valveOff()
+bool valveOff()
 {
-    debugln("off message received");
-    //myservo.writeMicroseconds(900);
-    pinMode(SERVOPIN, OUTPUT);
-    digitalWrite(SERVOPIN, LOW);
-    delay(500);
-    isValveOn = 0;
-    EEPROM.writeBool(addr, isValveOn);
-    EEPROM.commit();
-}
\ No newline at end of file
+    return valve.command(false);
+}
+
+#endif // SERVO_H
@@ -0,0 +1,137 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Destructive-interference distance: 32 B data cache lines on the ESP32
+   family, 64 B on desktop x86/ARM where the host tools run. */
+#if defined(__XTENSA__) || defined(__riscv)
+constexpr size_t SPSC_CACHE_LINE = 32;
+#else
+constexpr size_t SPSC_CACHE_LINE = 64;
+#endif
+
+/**
+ * Lock-free single-producer/single-consumer ring buffer.
+ *
+ * Exactly one context may push and exactly one may pop; neither side ever
+ * blocks or takes a lock, so it is safe between tasks on different cores
+ * and from an ISR on either side. Indices are free-running 32-bit counters
+ * (masked on access), each side keeps a private cached copy of the other
+ * side's index so the shared line is only re-read when the ring looks
+ * full/empty, and producer and consumer state live on separate cache lines.
+ *
+ * @tparam T Trivially copyable element type.
+ * @tparam N Capacity, a power of two.
+ */
+template <typename T, size_t N>
+class SpscRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity() { return N; }
+
+    /* Producer side */
+    bool push(const T &item)
+    {
+        return pushBatch(&item, 1) == 1;
+    }
+
+    /* Producer side: copies up to n items, returns how many fit */
+    size_t pushBatch(const T *items, size_t n)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        size_t free = N - (h - cachedTail);
+        if (free < n) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            free = N - (h - cachedTail);
+        }
+        if (n > free) {
+            n = free;
+        }
+        for (size_t i = 0; i < n; i++) {
+            slots[(h + i) & (N - 1)] = items[i];
+        }
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    /* Consumer side */
+    bool pop(T &item)
+    {
+        return popBatch(&item, 1) == 1;
+    }
+
+    /* Consumer side: copies the oldest item without removing it */
+    bool peek(T &item)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (cachedHead == t) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (cachedHead == t) {
+                return false;
+            }
+        }
+        item = slots[t & (N - 1)];
+        return true;
+    }
+
+    /* Consumer side: copies the i-th oldest item without removing it */
+    bool peekAt(size_t i, T &item)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (cachedHead - t <= i) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (cachedHead - t <= i) {
+                return false;
+            }
+        }
+        item = slots[(t + i) & (N - 1)];
+        return true;
+    }
+
+    /* Consumer side: moves up to max items out, returns how many */
+    size_t popBatch(T *out, size_t max)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        size_t avail = cachedHead - t;
+        if (avail < max) {
+            cachedHead = head.load(std::memory_order_acquire);
+            avail = cachedHead - t;
+        }
+        if (max > avail) {
+            max = avail;
+        }
+        for (size_t i = 0; i < max; i++) {
+            out[i] = slots[(t + i) & (N - 1)];
+        }
+        tail.store(t + max, std::memory_order_release);
+        return max;
+    }
+
+    /* Either side; exact only when called from one of the two owners */
+    size_t size() const
+    {
+        // Tail first: a third-party reader then never sees tail pass head,
+        // though both ends may move between the loads, hence the clamp
+        uint32_t t = tail.load(std::memory_order_acquire);
+        size_t n = head.load(std::memory_order_acquire) - t;
+        return n < N ? n : N;
+    }
+    bool empty() const { return size() == 0; }
+
+private:
+    // Producer-owned line
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> head{0};
+    uint32_t cachedTail = 0;
+    // Consumer-owned line
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> tail{0};
+    uint32_t cachedHead = 0;
+
+    alignas(SPSC_CACHE_LINE) T slots[N];
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,92 @@
+#ifndef STAGE_PROFILER_H
+#define STAGE_PROFILER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "LatencyHistogram.h"
+
+/* ─── Profiled stages ──────────────────────────────────────────────────── */
+enum PerfStage : uint8_t
+{
+    PERF_EDGENT,          // BlynkEdgent.run(), cloud task
+    PERF_FLOW_READ,       // readFlowSensorData(), acquisition task
+    PERF_ANALOG_READ,     // UV and both pressure channels, acquisition task
+    PERF_PROCESS_DATA,    // processData(), safety task
+    PERF_SHUTOFF,         // checkShutoff(), safety task
+    PERF_SEND,            // sendDatatoBlynk(), cloud task
+    PERF_STAGES
+};
+
+constexpr const char *PERF_STAGE_NAMES[PERF_STAGES] = {
+    "edgent", "flow_read", "analog_read", "process", "shutoff", "send"};
+constexpr uint8_t  PERF_BUCKETS    = 96;       // µs, up to ~33 s before clamping
+constexpr uint32_t PERF_PUBLISH_MS = 300000;   // summary pushed to the cloud this often
+
+/**
+ * Per-stage execution time histograms in µs. Each stage is timed by the one
+ * task that runs it, on either core; a short critical section around each
+ * record lets the console copy a consistent histogram (counts, 64-bit sum
+ * and max together) with snapshot(), and reset from any task.
+ */
+class StageProfiler
+{
+public:
+    static int64_t now() { return esp_timer_get_time(); }
+
+    void record(PerfStage s, uint32_t us)
+    {
+        portENTER_CRITICAL(&mux);
+        stages[s].record(us);
+        portEXIT_CRITICAL(&mux);
+    }
+
+    /**
+     * Records the time since mark and moves mark to now, so back-to-back
+     * stages cost one timer read each.
+     */
+    void lap(PerfStage s, int64_t &mark)
+    {
+        int64_t t = now();
+        record(s, (uint32_t)(t - mark));
+        mark = t;
+    }
+
+    void reset()
+    {
+        portENTER_CRITICAL(&mux);
+        for (uint8_t i = 0; i < PERF_STAGES; i++) {
+            stages[i].reset();
+        }
+        portEXIT_CRITICAL(&mux);
+    }
+
+    /* Consistent copy of one stage for a reader on another task */
+    void snapshot(PerfStage s, LatencyHistogram<PERF_BUCKETS> &out)
+    {
+        portENTER_CRITICAL(&mux);
+        out = stages[s];
+        portEXIT_CRITICAL(&mux);
+    }
+
+    /* Stage with the most accumulated time: the first thing worth optimising */
+    PerfStage heaviest()
+    {
+        uint8_t best = 0;
+        portENTER_CRITICAL(&mux);
+        for (uint8_t i = 1; i < PERF_STAGES; i++) {
+            if (stages[i].total() > stages[best].total()) {
+                best = i;
+            }
+        }
+        portEXIT_CRITICAL(&mux);
+        return (PerfStage)best;
+    }
+
+private:
+    LatencyHistogram<PERF_BUCKETS> stages[PERF_STAGES];
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+StageProfiler stageProfiler;
+
+#endif // STAGE_PROFILER_H
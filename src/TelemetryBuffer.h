@@ -0,0 +1,456 @@
+#ifndef TELEMETRY_BUFFER_H
+#define TELEMETRY_BUFFER_H
+
+#include <Arduino.h>
+#include "HistoryCodec.h"
+#include "LogStore.h"
+#include "Pipeline.h"
+#include "SpscRing.h"
+
+/* ─── Budget and backfill pacing ───────────────────────────────────────── */
+constexpr size_t   TELEMETRY_RAM_SAMPLES      = 64;    // newest samples kept in RAM
+constexpr size_t   TELEMETRY_SPILL_BATCH      = 16;    // moved to flash when RAM is full
+constexpr uint8_t  TELEMETRY_BACKFILL_BATCH   = 4;     // samples per backfill pass
+constexpr uint32_t TELEMETRY_BACKFILL_MS      = 1000;  // ≈ 4 samples/s beside the live stream
+constexpr uint32_t TELEMETRY_SECTOR_MAGIC     = 0x42544748;  // "HGTB"
+
+/**
+ * Compact fixed-point copy of the charted values of one sample (24 bytes).
+ * In flash, `state` starts erased (0xFF) and is programmed to 0 once the
+ * sample has been delivered, so consumption needs no erase.
+ */
+struct BufferedSample
+{
+    uint32_t epochS;          // UTC seconds, 0xFFFFFFFF = empty slot
+    uint16_t epochMsPart;
+    uint8_t  state;           // 0xFF = pending, 0x00 = delivered
+    uint8_t  crc;             // over everything except state and crc
+    uint32_t cumulativeDl;    // 0.1 L
+    uint16_t flowCentiLpm;    // 0.01 L/min
+    uint16_t irradianceCenti; // 0.01 mW/cm²
+    uint16_t doseDeci;        // 0.1 mJ/cm²
+    int16_t  pressure1Deci;   // 0.1 kPa
+    int16_t  pressure2Deci;   // 0.1 kPa
+    uint16_t blockageDeci;    // 0.1 %
+
+    static BufferedSample fromReport(const Report_t &r)
+    {
+        BufferedSample s = {};
+        s.epochS = (uint32_t)(r.epochMs / 1000);
+        s.epochMsPart = (uint16_t)(r.epochMs % 1000);
+        s.state = 0xFF;
+        s.cumulativeDl = (uint32_t)constrain(r.cumulativeflow * 10.0, 0.0, 4294967295.0);
+        s.flowCentiLpm = (uint16_t)constrain(r.flowrate * 100.0f, 0.0f, 65535.0f);
+        s.irradianceCenti = (uint16_t)constrain(r.irradiance * 100.0f, 0.0f, 65535.0f);
+        s.doseDeci = (uint16_t)constrain(r.dosage * 10.0f, 0.0f, 65535.0f);
+        s.pressure1Deci = (int16_t)constrain(r.pressure1 * 10.0f, -32768.0f, 32767.0f);
+        s.pressure2Deci = (int16_t)constrain(r.pressure2 * 10.0f, -32768.0f, 32767.0f);
+        s.blockageDeci = (uint16_t)constrain(r.blockagePercentage * 10.0f, 0.0f, 65535.0f);
+        s.crc = s.checksum();
+        return s;
+    }
+
+    uint64_t epochMs() const { return (uint64_t)epochS * 1000 + epochMsPart; }
+
+    HistoryRow historyRow() const
+    {
+        HistoryRow row;
+        row.v[HIST_TIME] = (int64_t)epochMs();
+        row.v[HIST_FLOW] = flowCentiLpm;
+        row.v[HIST_TOTAL] = cumulativeDl;
+        row.v[HIST_PRESSURE1] = pressure1Deci;
+        row.v[HIST_PRESSURE2] = pressure2Deci;
+        row.v[HIST_UV] = irradianceCenti;
+        row.v[HIST_DOSE] = doseDeci;
+        row.v[HIST_BLOCKAGE] = blockageDeci;
+        return row;
+    }
+
+    uint8_t checksum() const
+    {
+        const uint8_t *p = (const uint8_t *)this;
+        uint8_t crc = 0;
+        for (size_t i = 0; i < sizeof(*this); i++) {
+            if (i == offsetof(BufferedSample, state) || i == offsetof(BufferedSample, crc)) {
+                continue;
+            }
+            crc ^= p[i];
+            for (uint8_t k = 0; k < 8; k++) {
+                crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    bool valid() const { return epochS != 0xFFFFFFFF && crc == checksum(); }
+};
+
+static_assert(sizeof(BufferedSample) == 24, "BufferedSample must stay 24 bytes");
+
+/**
+ * FIFO of BufferedSample records over a ring of flash sectors. Records are
+ * appended into erased slots and marked delivered in place; a sector is only
+ * erased when the head wraps onto it. When the ring is full the oldest
+ * sector is dropped (drop-oldest). Boot recovery scans the sector headers
+ * and slot states, so no read pointer needs to be persisted.
+ */
+class FlashSampleRing
+{
+public:
+    static constexpr uint16_t SLOTS = (LOG_SECTOR_SIZE - 8) / sizeof(BufferedSample);
+
+    bool begin(LogFlash *dev)
+    {
+        flash = dev;
+        sectorCount = flash ? flash->size() / LOG_SECTOR_SIZE : 0;
+        pending = 0;
+        if (sectorCount < 2) {
+            sectorCount = 0;
+            return false;
+        }
+        return recover();
+    }
+
+    bool push(const BufferedSample &s)
+    {
+        if (!sectorCount) {
+            return false;
+        }
+        if (headSlot >= SLOTS && !advance()) {
+            return false;
+        }
+        if (!flash->write(slotAddr(headSector, headSlot), &s, sizeof(s))) {
+            headSlot = SLOTS;       // do not reuse a possibly torn slot
+            return false;
+        }
+        headSlot++;
+        pending++;
+        return true;
+    }
+
+    /* Oldest undelivered sample, skipping delivered and corrupt slots */
+    bool peek(BufferedSample &s)
+    {
+        while (pending) {
+            if (tailSector == headSector && tailSlot >= headSlot) {
+                pending = 0;        // count drifted (corrupt slots), ring is empty
+                return false;
+            }
+            if (tailSlot >= SLOTS) {
+                tailSector = next(tailSector);
+                tailSlot = 0;
+                continue;
+            }
+            flash->read(slotAddr(tailSector, tailSlot), &s, sizeof(s));
+            if (s.state == 0xFF && s.valid()) {
+                return true;
+            }
+            tailSlot++;
+        }
+        return false;
+    }
+
+    /* Marks the sample returned by peek() as delivered */
+    void pop()
+    {
+        uint8_t delivered = 0;
+        flash->write(slotAddr(tailSector, tailSlot) + offsetof(BufferedSample, state), &delivered, 1);
+        tailSlot++;
+        pending--;
+    }
+
+    /**
+     * Calls fn(sample) for up to max pending samples, oldest first, without
+     * consuming them; fn returns false to stop early.
+     * @return Samples visited.
+     */
+    template <typename Fn>
+    uint32_t visit(Fn fn, uint32_t max)
+    {
+        uint32_t n = 0;
+        uint16_t sector = tailSector;
+        uint16_t slot = tailSlot;
+        while (pending && n < max && !(sector == headSector && slot >= headSlot)) {
+            if (slot >= SLOTS) {
+                sector = next(sector);
+                slot = 0;
+                continue;
+            }
+            BufferedSample s;
+            flash->read(slotAddr(sector, slot++), &s, sizeof(s));
+            if (s.state == 0xFF && s.valid()) {
+                n++;
+                if (!fn(s)) {
+                    break;
+                }
+            }
+        }
+        return n;
+    }
+
+    uint32_t size() const { return pending; }
+    uint32_t capacity() const { return (uint32_t)sectorCount * SLOTS; }
+    uint32_t dropped() const { return droppedCount; }
+    uint32_t erases() const { return eraseCount; }
+
+private:
+    struct SectorHeader
+    {
+        uint32_t magic;
+        uint32_t seq;
+    };
+
+    uint16_t next(uint16_t s) const { return (s + 1) % sectorCount; }
+
+    static uint32_t slotAddr(uint16_t sector, uint16_t slot)
+    {
+        return sector * LOG_SECTOR_SIZE + sizeof(SectorHeader) + slot * sizeof(BufferedSample);
+    }
+
+    /* Moves the head into the next sector, dropping it first if still pending */
+    bool advance()
+    {
+        uint16_t s = next(headSector);
+        if (pending && s == tailSector) {
+            uint16_t lost = countPending(s, tailSlot, SLOTS);
+            droppedCount += lost;
+            pending -= lost;
+            tailSector = next(s);
+            tailSlot = 0;
+        }
+        if (!erased(s)) {
+            if (!flash->eraseSector(s * LOG_SECTOR_SIZE)) {
+                return false;
+            }
+            eraseCount++;
+        }
+        SectorHeader sh = {TELEMETRY_SECTOR_MAGIC, ++sectorSeq};
+        if (!flash->write(s * LOG_SECTOR_SIZE, &sh, sizeof(sh))) {
+            return false;
+        }
+        if (!pending) {
+            tailSector = s;
+            tailSlot = 0;
+        }
+        headSector = s;
+        headSlot = 0;
+        return true;
+    }
+
+    bool erased(uint16_t s)
+    {
+        uint32_t word = 0;
+        flash->read(s * LOG_SECTOR_SIZE, &word, sizeof(word));
+        return word == 0xFFFFFFFF;
+    }
+
+    uint16_t countPending(uint16_t sector, uint16_t from, uint16_t to)
+    {
+        uint16_t n = 0;
+        for (uint16_t i = from; i < to; i++) {
+            BufferedSample s;
+            flash->read(slotAddr(sector, i), &s, sizeof(s));
+            if (s.state == 0xFF && s.valid()) {
+                n++;
+            }
+        }
+        return n;
+    }
+
+    /* First erased slot of a sector (SLOTS if full) */
+    uint16_t findEnd(uint16_t sector)
+    {
+        for (uint16_t i = 0; i < SLOTS; i++) {
+            uint32_t epochS;
+            flash->read(slotAddr(sector, i), &epochS, sizeof(epochS));
+            if (epochS == 0xFFFFFFFF) {
+                return i;
+            }
+        }
+        return SLOTS;
+    }
+
+    bool recover()
+    {
+        bool found = false;
+        sectorSeq = 0;
+        for (uint16_t s = 0; s < sectorCount; s++) {
+            SectorHeader sh;
+            flash->read(s * LOG_SECTOR_SIZE, &sh, sizeof(sh));
+            if (sh.magic == TELEMETRY_SECTOR_MAGIC && (!found || sh.seq > sectorSeq)) {
+                found = true;
+                sectorSeq = sh.seq;
+                headSector = s;
+            }
+        }
+        if (!found) {
+            headSector = sectorCount - 1;
+            headSlot = SLOTS;       // first push opens sector 0
+            tailSector = 0;
+            tailSlot = 0;
+            return true;
+        }
+        headSlot = findEnd(headSector);
+
+        // Sectors follow the head in ring order; the oldest pending one is the tail
+        tailSector = headSector;
+        tailSlot = headSlot;
+        bool tailFound = false;
+        for (uint16_t i = 1; i <= sectorCount; i++) {
+            uint16_t s = (headSector + i) % sectorCount;
+            SectorHeader sh;
+            flash->read(s * LOG_SECTOR_SIZE, &sh, sizeof(sh));
+            if (sh.magic != TELEMETRY_SECTOR_MAGIC) {
+                continue;
+            }
+            uint16_t end = (s == headSector) ? headSlot : SLOTS;
+            for (uint16_t slot = 0; slot < end; slot++) {
+                BufferedSample rec;
+                flash->read(slotAddr(s, slot), &rec, sizeof(rec));
+                if (rec.state == 0xFF && rec.valid()) {
+                    if (!tailFound) {
+                        tailFound = true;
+                        tailSector = s;
+                        tailSlot = slot;
+                    }
+                    pending++;
+                }
+            }
+        }
+        return true;
+    }
+
+    LogFlash *flash = nullptr;
+    uint16_t  sectorCount = 0;
+    uint16_t  headSector = 0;
+    uint16_t  headSlot = 0;
+    uint16_t  tailSector = 0;
+    uint16_t  tailSlot = 0;
+    uint32_t  sectorSeq = 0;
+    uint32_t  pending = 0;
+    uint32_t  droppedCount = 0;
+    uint32_t  eraseCount = 0;
+};
+
+/**
+ * Store-and-forward buffer for samples produced while the cloud is
+ * unreachable. New samples go into a RAM ring; when it fills, its oldest
+ * samples spill to the flash ring in batches. Delivery is strictly oldest
+ * first (flash, then RAM) and paced by the caller so backfill never crowds
+ * out the live stream. Without a flash partition the RAM ring drops oldest.
+ */
+class TelemetryBuffer
+{
+public:
+    struct Stats
+    {
+        uint32_t buffered;      // samples accepted while offline
+        uint32_t spilled;       // samples moved RAM → flash
+        uint32_t delivered;     // samples backfilled to the cloud
+        uint32_t ramDropped;    // lost because RAM was full and flash unavailable
+        uint32_t spillFailed;   // lost because the flash ring rejected the write
+    };
+
+    bool begin(LogFlash *dev)
+    {
+        memset(&stats, 0, sizeof(stats));
+        hasFlash = flashRing.begin(dev);
+        return hasFlash;
+    }
+
+    void push(const BufferedSample &s)
+    {
+        stats.buffered++;
+        if (ram.size() >= TELEMETRY_RAM_SAMPLES) {
+            spill();
+        }
+        if (!ram.push(s)) {
+            BufferedSample oldest;
+            ram.pop(oldest);
+            stats.ramDropped++;
+            ram.push(s);
+        }
+    }
+
+    /* Oldest undelivered sample */
+    bool peek(BufferedSample &s)
+    {
+        fromFlash = flashRing.size() && flashRing.peek(s);
+        return fromFlash || ram.peek(s);
+    }
+
+    /* Confirms delivery of the sample returned by peek() */
+    void pop()
+    {
+        if (fromFlash) {
+            flashRing.pop();
+        } else {
+            BufferedSample s;
+            ram.pop(s);
+        }
+        stats.delivered++;
+    }
+
+    /* Calls fn(sample) for up to max pending samples in delivery order, without consuming them */
+    template <typename Fn>
+    uint32_t visit(Fn fn, uint32_t max)
+    {
+        bool more = true;
+        auto each = [&](const BufferedSample &s) { return more = fn(s); };
+        uint32_t n = flashRing.size() ? flashRing.visit(each, max) : 0;
+        BufferedSample s;
+        for (size_t i = 0; more && n < max && ram.peekAt(i, s); i++, n++) {
+            more = fn(s);
+        }
+        return n;
+    }
+
+    /* Moves the whole RAM backlog to flash, e.g. before RAM is lost to deep sleep */
+    void flushToFlash()
+    {
+        while (hasFlash && ram.size()) {
+            spill();
+        }
+    }
+
+    uint32_t backlog() const { return ram.size() + flashRing.size(); }
+    uint32_t ramBacklog() const { return ram.size(); }
+    uint32_t flashBacklog() const { return flashRing.size(); }
+    uint32_t flashCapacity() const { return flashRing.capacity(); }
+    uint32_t flashDropped() const { return flashRing.dropped(); }
+    uint32_t dropped() const { return stats.ramDropped + stats.spillFailed + flashRing.dropped(); }
+    uint32_t flashErases() const { return flashRing.erases(); }
+    bool     flashReady() const { return hasFlash; }
+    const Stats &getStats() const { return stats; }
+
+    static constexpr size_t ramBudgetBytes() { return TELEMETRY_RAM_SAMPLES * sizeof(BufferedSample); }
+
+private:
+    void spill()
+    {
+        if (!hasFlash) {
+            return;     // push() will drop the oldest
+        }
+        BufferedSample batch[TELEMETRY_SPILL_BATCH];
+        size_t n = ram.popBatch(batch, TELEMETRY_SPILL_BATCH);
+        for (size_t i = 0; i < n; i++) {
+            // Already out of RAM, so a rejected write is a lost sample
+            if (flashRing.push(batch[i])) {
+                stats.spilled++;
+            } else {
+                stats.spillFailed++;
+            }
+        }
+    }
+
+    SpscRing<BufferedSample, TELEMETRY_RAM_SAMPLES> ram;
+    FlashSampleRing flashRing;
+    Stats stats = {};
+    bool  hasFlash = false;
+    bool  fromFlash = false;
+};
+
+PartitionFlash bufferPartition;
+TelemetryBuffer telemetryBuffer;
+
+#endif // TELEMETRY_BUFFER_H
@@ -0,0 +1,233 @@
+#ifndef TELEMETRY_PUBLISHER_H
+#define TELEMETRY_PUBLISHER_H
+
+#include <Arduino.h>
+#include <math.h>
+
+/**
+ * Per-pin telemetry filter in front of the cloud connection.
+ *
+ * Values offered between beginSample() and endSample() belong to one
+ * sample: whatever passes the filter is written as a single group stamped
+ * with the sample's acquisition time, and a sample where nothing changed
+ * sends nothing at all.
+ *
+ * Each channel keeps a shadow of the value the cloud last accepted and only
+ * re-sends when the new value leaves its deadband, never faster than
+ * minIntervalMs and at least every maxIntervalMs as a heartbeat (0 = none).
+ * A change that arrives inside the minimum interval is held and sent by
+ * flush() once the interval has passed, so the latest value always gets
+ * through. Alerts and one-off writes go through send(), which bypasses the
+ * filter. A write the sink rejects (e.g. while offline) leaves the shadow
+ * untouched so the value is retried on the next offer.
+ *
+ * @tparam CHANNELS Maximum number of filtered pins.
+ */
+template <uint8_t CHANNELS>
+class TelemetryPublisher
+{
+public:
+    /* Returns false when the value could not be handed to the cloud */
+    typedef bool (*WriteFn)(uint8_t pin, double value);
+    /* Opens (open = true, stamped with epochMs or 0 for "now") or closes a group */
+    typedef void (*GroupFn)(bool open, uint64_t epochMs);
+
+    struct Stats
+    {
+        uint32_t offered;       // values presented to offer()
+        uint32_t sent;          // filtered writes accepted by the sink
+        uint32_t deadband;      // offers dropped as unchanged
+        uint32_t deferred;      // offers held back by the minimum interval
+        uint32_t heartbeats;    // sends forced only by the maximum interval
+        uint32_t bypassed;      // unfiltered writes via send()
+        uint32_t failed;        // writes the sink rejected
+        uint32_t groups;        // grouped messages carrying the filtered writes
+    };
+
+    void begin(WriteFn fn, GroupFn groupFn = nullptr)
+    {
+        write = fn;
+        group = groupFn;
+    }
+
+    /* Starts a sample; writes until endSample() share one group */
+    void beginSample(uint64_t epochMs)
+    {
+        sampleEpochMs = epochMs;
+        inSample = true;
+    }
+
+    void endSample()
+    {
+        closeGroup();
+        inSample = false;
+    }
+
+    bool addChannel(uint8_t pin, float deadband, uint32_t minIntervalMs, uint32_t maxIntervalMs)
+    {
+        if (count >= CHANNELS || find(pin)) {
+            return false;
+        }
+        Channel &c = channels[count++];
+        memset(&c, 0, sizeof(c));
+        c.pin = pin;
+        c.deadband = deadband;
+        c.minIntervalMs = minIntervalMs;
+        c.maxIntervalMs = maxIntervalMs;
+        return true;
+    }
+
+    /* Presents a new value; writes it only if the channel's policy allows */
+    void offer(uint8_t pin, double value, uint32_t now)
+    {
+        Channel *c = find(pin);
+        if (!c) {
+            send(pin, value);
+            return;
+        }
+        stats.offered++;
+        bool changed = !c->hasShadow || fabs(value - c->shadow) >= c->deadband;
+        bool heartbeat = c->maxIntervalMs && (now - c->lastSentMs >= c->maxIntervalMs);
+        if (!changed && !heartbeat) {
+            c->pending = false;     // drifted back to what the cloud already shows
+            stats.deadband++;
+            return;
+        }
+        if (c->hasShadow && now - c->lastSentMs < c->minIntervalMs) {
+            c->pending = true;
+            c->pendingValue = value;
+            c->pendingEpochMs = inSample ? sampleEpochMs : 0;
+            stats.deferred++;
+            return;
+        }
+        if (!changed) {
+            stats.heartbeats++;
+        }
+        publish(*c, value, now);
+    }
+
+    /* Sends changes held back by the minimum interval, grouped by the time
+       they were measured; call periodically outside a sample */
+    void flush(uint32_t now)
+    {
+        for (uint8_t i = 0; i < count; i++) {
+            if (!due(channels[i], now)) {
+                continue;
+            }
+            uint64_t epochMs = channels[i].pendingEpochMs;
+            beginSample(epochMs);
+            for (uint8_t j = i; j < count; j++) {
+                Channel &c = channels[j];
+                if (due(c, now) && c.pendingEpochMs == epochMs) {
+                    publish(c, c.pendingValue, now);
+                }
+            }
+            endSample();
+        }
+    }
+
+    /* Unfiltered write for alerts and state changes */
+    bool send(uint8_t pin, double value)
+    {
+        stats.bypassed++;
+        if (!write || !write(pin, value)) {
+            stats.failed++;
+            return false;
+        }
+        Channel *c = find(pin);
+        if (c) {
+            c->shadow = value;
+            c->hasShadow = true;
+            c->pending = false;
+        }
+        return true;
+    }
+
+    /* Forgets every shadow so the next offers are all sent (e.g. after reconnect) */
+    void invalidate()
+    {
+        for (uint8_t i = 0; i < count; i++) {
+            channels[i].hasShadow = false;
+        }
+    }
+
+    const Stats &getStats() const { return stats; }
+
+    /* Writes avoided by the filter so far */
+    uint32_t saved() const { return stats.offered > stats.sent ? stats.offered - stats.sent : 0; }
+
+    uint8_t channelCount() const { return count; }
+    uint8_t channelPin(uint8_t i) const { return channels[i].pin; }
+    double  channelShadow(uint8_t i) const { return channels[i].shadow; }
+    uint32_t channelSends(uint8_t i) const { return channels[i].sends; }
+
+private:
+    struct Channel
+    {
+        uint8_t  pin;
+        bool     hasShadow;
+        bool     pending;
+        float    deadband;
+        uint32_t minIntervalMs;
+        uint32_t maxIntervalMs;
+        uint32_t lastSentMs;
+        uint32_t sends;
+        double   shadow;
+        double   pendingValue;
+        uint64_t pendingEpochMs;
+    };
+
+    static bool due(const Channel &c, uint32_t now)
+    {
+        return c.pending && now - c.lastSentMs >= c.minIntervalMs;
+    }
+
+    void closeGroup()
+    {
+        if (groupOpen) {
+            group(false, 0);
+            groupOpen = false;
+        }
+    }
+
+    Channel *find(uint8_t pin)
+    {
+        for (uint8_t i = 0; i < count; i++) {
+            if (channels[i].pin == pin) {
+                return &channels[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void publish(Channel &c, double value, uint32_t now)
+    {
+        if (inSample && group && !groupOpen && write) {
+            group(true, sampleEpochMs);
+            groupOpen = true;
+            stats.groups++;
+        }
+        if (!write || !write(c.pin, value)) {
+            stats.failed++;
+            c.pending = false;
+            return;     // keep the old shadow, next offer retries
+        }
+        c.shadow = value;
+        c.hasShadow = true;
+        c.pending = false;
+        c.lastSentMs = now;
+        c.sends++;
+        stats.sent++;
+    }
+
+    Channel  channels[CHANNELS] = {};
+    uint8_t  count = 0;
+    WriteFn  write = nullptr;
+    GroupFn  group = nullptr;
+    Stats    stats = {};
+    uint64_t sampleEpochMs = 0;
+    bool     inSample = false;
+    bool     groupOpen = false;
+};
+
+#endif // TELEMETRY_PUBLISHER_H
@@ -0,0 +1,164 @@
+#ifndef TELEMETRY_SINK_H
+#define TELEMETRY_SINK_H
+
+#include <Arduino.h>
+#include "Pipeline.h"
+
+constexpr uint8_t TELEMETRY_MAX_SINKS = 4;
+
+/**
+ * A destination for reports and events. The safety task hands every
+ * record to each active sink through report()/event(), which only copy it
+ * into the sink's own queue and never block; each sink drains its queue
+ * on its own task, batching as suits its transport. Sensors are read once
+ * and a slow or offline sink only fills (and then drops from) its own
+ * queue. Counters have one writer each: offered/dropped the producer,
+ * sent/failed the sink's task.
+ */
+class TelemetrySink
+{
+public:
+    struct Stats
+    {
+        uint32_t offered;       // records presented while active
+        uint32_t dropped;       // sink queue full
+        uint32_t sent;          // handed to the transport
+        uint32_t failed;        // given up by the transport
+    };
+
+    explicit TelemetrySink(const char *name) : sinkName(name) {}
+    virtual ~TelemetrySink() {}
+
+    const char *name() const { return sinkName; }
+
+    /* Producer side */
+    bool report(const Report_t &r)
+    {
+        return count(enqueueReport(r));
+    }
+
+    bool event(const CloudEvent_t &e)
+    {
+        return count(enqueueEvent(e));
+    }
+
+    /* Sink side */
+    void noteSent(uint32_t n = 1) { stat.sent += n; }
+    void noteFailed(uint32_t n = 1) { stat.failed += n; }
+    void setConnected(bool up) { linkUp = up; }
+    void setActive(bool on) { isActive = on; }
+
+    bool active() const { return isActive; }
+    bool connected() const { return linkUp; }
+    const Stats &stats() const { return stat; }
+
+protected:
+    virtual bool enqueueReport(const Report_t &r) = 0;
+    virtual bool enqueueEvent(const CloudEvent_t &e) = 0;
+
+private:
+    bool count(bool queued)
+    {
+        stat.offered++;
+        if (!queued) {
+            stat.dropped++;
+        }
+        return queued;
+    }
+
+    const char   *sinkName;
+    volatile bool isActive = true;
+    volatile bool linkUp = false;
+    Stats         stat = {};
+};
+
+/* Blynk: the pipeline queues to the cloud task, which owns the connection */
+class CloudQueueSink : public TelemetrySink
+{
+public:
+    CloudQueueSink() : TelemetrySink("blynk") {}
+
+protected:
+    bool enqueueReport(const Report_t &r) override { return reportQueue.push(r); }
+    bool enqueueEvent(const CloudEvent_t &e) override { return eventQueue.push(e); }
+};
+
+/* Fans each record out to every attached, active sink */
+class TelemetryFanout
+{
+public:
+    bool attach(TelemetrySink *sink)
+    {
+        if (count >= TELEMETRY_MAX_SINKS) {
+            return false;
+        }
+        sinks[count++] = sink;
+        return true;
+    }
+
+    void report(const Report_t &r)
+    {
+        for (uint8_t i = 0; i < count; i++) {
+            if (sinks[i]->active()) {
+                sinks[i]->report(r);
+            }
+        }
+    }
+
+    void event(const CloudEvent_t &e)
+    {
+        for (uint8_t i = 0; i < count; i++) {
+            if (sinks[i]->active()) {
+                sinks[i]->event(e);
+            }
+        }
+    }
+
+    uint8_t size() const { return count; }
+    const TelemetrySink &sink(uint8_t i) const { return *sinks[i]; }
+
+private:
+    TelemetrySink *sinks[TELEMETRY_MAX_SINKS] = {};
+    uint8_t        count = 0;
+};
+
+CloudQueueSink  blynkSink;
+TelemetryFanout telemetrySinks;
+
+/* ─── Helpers for producers off the cloud task ─────────────────────────── */
+void postEvent(const char *name, const String &msg = String())
+{
+    CloudEvent_t e = {};
+    e.type = CLOUD_LOG_EVENT;
+    e.name = name;
+    strlcpy(e.msg, msg.c_str(), sizeof(e.msg));
+    telemetrySinks.event(e);
+}
+
+void postResolve(const char *name)
+{
+    CloudEvent_t e = {};
+    e.type = CLOUD_RESOLVE_EVENT;
+    e.name = name;
+    telemetrySinks.event(e);
+}
+
+void postPin(uint8_t pin, float value)
+{
+    CloudEvent_t e = {};
+    e.type = CLOUD_WRITE_PIN;
+    e.pin = pin;
+    e.value = value;
+    telemetrySinks.event(e);
+}
+
+void postText(uint8_t pin, const String &msg)
+{
+    CloudEvent_t e = {};
+    e.type = CLOUD_WRITE_TEXT;
+    e.pin = pin;
+    strlcpy(e.msg, msg.c_str(), sizeof(e.msg));
+    telemetrySinks.event(e);
+}
+
+#endif // TELEMETRY_SINK_H
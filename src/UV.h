@@ -5,6 +5,8 @@
 
 #define UVPIN 7
 
+constexpr uint16_t UV_LAMP_ON_ADC = 650;   // ≈ 6 mW/cm², lamp considered lit above this
+
 void UV_init();
 uint16_t readUV();
 
@@ -28,6 +30,12 @@ uint16_t readUV()
 }
 
 
+/* ADC counts → irradiance in mW/cm² */
+inline float uvIrradiance(uint16_t adcCounts)
+{
+    return 10 * (adcCounts * 3.3 / 4095.0) * 1.515;
+}
+
 float calculateUVDosage(float *flowrate, float *irradiance) {
     float volume = 0.0007; // Volume in cubic meters (m³)
 
@@ -0,0 +1,147 @@
+#ifndef UV_DOSE_LEDGER_H
+#define UV_DOSE_LEDGER_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+/* ─── Dose histogram layout ────────────────────────────────────────────── */
+constexpr uint8_t UV_DOSE_BUCKETS     = 8;
+// Upper edges (mJ/cm²) of every bucket but the last, which is open-ended
+constexpr float   UV_DOSE_EDGES[UV_DOSE_BUCKETS - 1] = {10, 20, 30, 40, 60, 80, 120};
+constexpr float   UV_DOSE_TARGET_MJ   = 40.0f;  // NSF/ANSI 55 Class A minimum
+constexpr uint8_t UV_DOSE_HISTORY     = 7;      // daily summaries kept in flash
+constexpr float   UV_DOSE_MAX_DT_PERIODS = 1.5f; // cap integration gap after a stall, in sample periods
+
+/* One day of volume-weighted dose accounting */
+struct UVDoseDay
+{
+    uint32_t date;                      // yyyymmdd, 0 = unused slot
+    float    litres[UV_DOSE_BUCKETS];   // volume delivered per dose bucket
+    float    totalLitres;
+    float    underDosedLitres;          // volume below UV_DOSE_TARGET_MJ
+    float    minDose;                   // lowest dose seen while water flowed, valid once totalLitres > 0
+};
+
+/**
+ * Integrates flow against the instantaneous UV dose at sample rate, so the
+ * ledger answers "how many litres were under-dosed" rather than "what was
+ * the dose at report time". Today's ledger is checkpointed hourly and
+ * archived into a small ring of daily summaries in NVS at midnight.
+ */
+class UVDoseLedger
+{
+public:
+    void begin()
+    {
+        Preferences prefs;
+        memset(&today, 0, sizeof(today));
+        memset(history, 0, sizeof(history));
+        historyHead = 0;
+        if (prefs.begin("uvdose", true)) {
+            prefs.getBytes("today", &today, sizeof(today));
+            prefs.getBytes("hist", history, sizeof(history));
+            historyHead = prefs.getUChar("head", 0) % UV_DOSE_HISTORY;
+            prefs.end();
+        }
+        lastSampleMs = 0;
+    }
+
+    /* Acquisition period in use; a stall longer than 1.5 periods is not integrated */
+    void setSamplePeriod(uint32_t periodMs)
+    {
+        maxDtMs = (uint32_t)(periodMs * UV_DOSE_MAX_DT_PERIODS);
+    }
+
+    /**
+     * Accounts the volume that flowed since the previous sample at the dose
+     * measured now.
+     * @param flowLpm Flow rate in L/min.
+     * @param doseMj  Instantaneous dose in mJ/cm².
+     * @param nowMs   Sample time in milliseconds.
+     */
+    void addSample(float flowLpm, float doseMj, uint32_t nowMs)
+    {
+        uint32_t dt = lastSampleMs ? nowMs - lastSampleMs : 0;
+        lastSampleMs = nowMs;
+        if (dt == 0 || flowLpm <= 0.0f) {
+            return;
+        }
+        if (dt > maxDtMs) {
+            dt = maxDtMs;
+        }
+
+        // Volume is only ever added here, so none yet means minDose is unset;
+        // a real 0 mJ/cm² (lamp off while flowing) must stay the minimum
+        bool first = today.totalLitres <= 0.0f;
+        float litres = flowLpm * (dt / 60000.0f);
+        today.litres[bucketFor(doseMj)] += litres;
+        today.totalLitres += litres;
+        if (doseMj < UV_DOSE_TARGET_MJ) {
+            today.underDosedLitres += litres;
+        }
+        if (first || doseMj < today.minDose) {
+            today.minDose = doseMj;
+        }
+    }
+
+    /**
+     * Moves the ledger to a new calendar day, archiving the previous one.
+     * Safe to call every sample; it only writes flash when the date changes.
+     */
+    void setDate(uint32_t date)
+    {
+        if (date == today.date) {
+            return;
+        }
+        if (today.date != 0) {
+            history[historyHead] = today;
+            historyHead = (historyHead + 1) % UV_DOSE_HISTORY;
+        }
+        memset(&today, 0, sizeof(today));
+        today.date = date;
+        save(true);
+    }
+
+    /* Persists today's running ledger (call at hour boundaries) */
+    void checkpoint() { save(false); }
+
+    const UVDoseDay &current() const { return today; }
+
+    /* i = 0 is yesterday, i = UV_DOSE_HISTORY - 1 the oldest summary */
+    const UVDoseDay &day(uint8_t i) const
+    {
+        return history[(historyHead + UV_DOSE_HISTORY - 1 - i) % UV_DOSE_HISTORY];
+    }
+
+    static uint8_t bucketFor(float doseMj)
+    {
+        uint8_t i = 0;
+        while (i < UV_DOSE_BUCKETS - 1 && doseMj >= UV_DOSE_EDGES[i]) {
+            ++i;
+        }
+        return i;
+    }
+
+private:
+    void save(bool withHistory)
+    {
+        Preferences prefs;
+        if (!prefs.begin("uvdose", false)) {
+            return;
+        }
+        prefs.putBytes("today", &today, sizeof(today));
+        if (withHistory) {
+            prefs.putBytes("hist", history, sizeof(history));
+            prefs.putUChar("head", historyHead);
+        }
+        prefs.end();
+    }
+
+    UVDoseDay today;
+    UVDoseDay history[UV_DOSE_HISTORY];
+    uint8_t   historyHead = 0;
+    uint32_t  lastSampleMs = 0;
+    uint32_t  maxDtMs = 7500;           // 1.5 × the 5 s always-on period until set
+};
+
+#endif // UV_DOSE_LEDGER_H
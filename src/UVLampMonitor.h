@@ -0,0 +1,202 @@
+#ifndef UV_LAMP_MONITOR_H
+#define UV_LAMP_MONITOR_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <math.h>
+
+/* ─── Lamp model tuning ────────────────────────────────────────────────── */
+constexpr uint32_t UV_LAMP_WARMUP_MS      = 5UL * 60 * 1000;  // output unstable after strike
+constexpr uint32_t UV_LAMP_FIT_PERIOD_S   = 60;        // one fit point per lit minute
+constexpr float    UV_LAMP_EOL_FRACTION   = 0.70f;     // replace at 70 % of new-lamp output
+constexpr uint32_t UV_LAMP_SAVE_RUN_S     = 15 * 60;   // persist after this much extra on-time
+constexpr uint32_t UV_LAMP_SAVE_MIN_MS    = 10UL * 60 * 1000; // rate limit for cycle-only saves
+constexpr float    UV_LAMP_MAX_DT_PERIODS = 1.5f;      // cap integration gap after a stall, in sample periods
+
+/**
+ * Tracks UV lamp run-hours and switch cycles and fits an exponential
+ * intensity decay I(h) = I0 · e^(b·h) over lamp run-hours, as a linear
+ * least-squares fit of ln(I) against h kept in running sums (O(1) state).
+ * Samples taken during warm-up after each strike are excluded so that
+ * start-up ramps do not read as ageing.
+ */
+class UVLampMonitor
+{
+public:
+    struct Persisted
+    {
+        uint32_t runSeconds;
+        uint32_t switchCycles;
+        double   n, sx, sy, sxx, sxy;   // regression sums of (hours, ln irradiance)
+    };
+
+    void begin()
+    {
+        Preferences prefs;
+        memset(&state, 0, sizeof(state));
+        if (prefs.begin("uvlamp", true)) {
+            prefs.getBytes("state", &state, sizeof(state));
+            prefs.end();
+        }
+        saved = state;
+    }
+
+    /* Acquisition period in use; a stall longer than 1.5 periods is not counted */
+    void setSamplePeriod(uint32_t periodMs)
+    {
+        maxDtMs = (uint32_t)(periodMs * UV_LAMP_MAX_DT_PERIODS);
+    }
+
+    /**
+     * Feeds one lamp sample.
+     * @param lampOn     Lamp state derived from the UV sensor.
+     * @param irradiance Irradiance in mW/cm².
+     * @param nowMs      Sample time in milliseconds.
+     */
+    void update(bool lampOn, float irradiance, uint32_t nowMs)
+    {
+        if (lastSampleMs == 0) {
+            // First sample after boot: lamp state is unknown history, not a strike
+            wasOn = lampOn;
+            onSinceMs = nowMs;
+        }
+        uint32_t dt = lastSampleMs ? nowMs - lastSampleMs : 0;
+        lastSampleMs = nowMs;
+        if (dt > maxDtMs) {
+            dt = maxDtMs;
+        }
+
+        if (lampOn && !wasOn) {
+            state.switchCycles++;
+            onSinceMs = nowMs;
+            resetFitPoint();
+        }
+        wasOn = lampOn;
+
+        if (lampOn) {
+            runMs += dt;
+            state.runSeconds += runMs / 1000;
+            runMs %= 1000;
+
+            if (nowMs - onSinceMs >= UV_LAMP_WARMUP_MS && irradiance > 0.0f) {
+                pointSum += irradiance;
+                pointSamples++;
+                pointMs += dt;
+                if (pointMs >= UV_LAMP_FIT_PERIOD_S * 1000UL) {
+                    addFitPoint(runHours(), pointSum / pointSamples);
+                    resetFitPoint();
+                }
+            }
+        }
+
+        maybeSave(nowMs);
+    }
+
+    /* Call after a lamp replacement */
+    void reset()
+    {
+        memset(&state, 0, sizeof(state));
+        resetFitPoint();
+        onSinceMs = lastSampleMs;
+        save(lastSampleMs);
+    }
+
+    float runHours() const { return state.runSeconds / 3600.0f; }
+    uint32_t switchCycles() const { return state.switchCycles; }
+
+    /* Fitted new-lamp irradiance (mW/cm²), 0 until enough data */
+    float initialIrradiance() const
+    {
+        double b;
+        double a = fit(b);
+        return (a == 0.0 && b == 0.0) ? 0.0f : (float)exp(a);
+    }
+
+    /* Decay rate in %/1000 h (positive = losing output) */
+    float decayPerKHour() const
+    {
+        double b;
+        fit(b);
+        return (float)((1.0 - exp(b * 1000.0)) * 100.0);
+    }
+
+    /**
+     * Predicted run-hours left until output falls to UV_LAMP_EOL_FRACTION of
+     * the fitted new-lamp irradiance; negative when already past it and NAN
+     * while the trend is not yet decaying.
+     */
+    float hoursRemaining() const
+    {
+        double b;
+        fit(b);
+        if (b >= 0.0) {
+            return NAN;
+        }
+        double eolHours = log(UV_LAMP_EOL_FRACTION) / b;
+        return (float)(eolHours - runHours());
+    }
+
+private:
+    double fit(double &slope) const
+    {
+        slope = 0.0;
+        double denom = state.n * state.sxx - state.sx * state.sx;
+        if (state.n < 2 || fabs(denom) < 1e-9) {
+            return 0.0;
+        }
+        slope = (state.n * state.sxy - state.sx * state.sy) / denom;
+        return (state.sy - slope * state.sx) / state.n;
+    }
+
+    void addFitPoint(float hours, float irradiance)
+    {
+        double y = log(irradiance);
+        state.n   += 1.0;
+        state.sx  += hours;
+        state.sy  += y;
+        state.sxx += (double)hours * hours;
+        state.sxy += hours * y;
+    }
+
+    void resetFitPoint()
+    {
+        pointSum = 0.0f;
+        pointSamples = 0;
+        pointMs = 0;
+    }
+
+    void maybeSave(uint32_t nowMs)
+    {
+        bool runDue   = state.runSeconds - saved.runSeconds >= UV_LAMP_SAVE_RUN_S;
+        bool cycleDue = state.switchCycles != saved.switchCycles &&
+                        nowMs - lastSaveMs >= UV_LAMP_SAVE_MIN_MS;
+        if (runDue || cycleDue) {
+            save(nowMs);
+        }
+    }
+
+    void save(uint32_t nowMs)
+    {
+        Preferences prefs;
+        if (prefs.begin("uvlamp", false)) {
+            prefs.putBytes("state", &state, sizeof(state));
+            prefs.end();
+        }
+        saved = state;
+        lastSaveMs = nowMs;
+    }
+
+    Persisted state;
+    Persisted saved;
+    bool      wasOn = false;
+    uint32_t  onSinceMs = 0;
+    uint32_t  lastSampleMs = 0;
+    uint32_t  maxDtMs = 7500;   // 1.5 × the 5 s always-on period until set
+    uint32_t  lastSaveMs = 0;
+    uint32_t  runMs = 0;
+    float     pointSum = 0.0f;
+    uint16_t  pointSamples = 0;
+    uint32_t  pointMs = 0;
+};
+
+#endif // UV_LAMP_MONITOR_H
@@ -0,0 +1,261 @@
+#ifndef WALL_CLOCK_H
+#define WALL_CLOCK_H
+
+#include <Arduino.h>
+#include <esp_sntp.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+#include <time.h>
+#include "FlowRollup.h"   // daysFromCivil()
+
+/* ─── Time sources ─────────────────────────────────────────────────────── */
+constexpr const char *WALLCLOCK_DEFAULT_TZ  = "NZST-12NZDT,M9.5.0,M4.1.0/3";
+constexpr const char *WALLCLOCK_NTP_SERVER  = "pool.ntp.org";
+constexpr const char *WALLCLOCK_NTP_SERVER2 = "time.google.com";
+constexpr uint32_t WALLCLOCK_RESYNC_MS      = 3600000;      // SNTP poll interval
+constexpr time_t   WALLCLOCK_VALID_AFTER    = 1600000000;   // earlier = RTC never set
+constexpr uint8_t  WALLCLOCK_TZ_LEN         = 48;
+
+/* ─── Correction policy ────────────────────────────────────────────────── */
+constexpr int64_t  WALLCLOCK_STEP_US        = 1000000;      // larger errors step, smaller ones slew
+constexpr int64_t  WALLCLOCK_SLEW_PPM       = 500;          // 0.5 ms per second
+
+/**
+ * UTC wall clock derived from the monotonic esp_timer. SNTP runs in the
+ * lwIP task and only moves the mapping (UTC - monotonic offset); reads
+ * never block on the network. Small corrections are slewed and large ones
+ * stepped, and the returned time never goes backwards, so samples stamped
+ * from it keep their order across resyncs. The oscillator's drift against
+ * UTC is estimated at each sync and extrapolated between them. Local time
+ * comes from the POSIX TZ rules, DST included.
+ */
+class WallClock
+{
+public:
+    struct Zone
+    {
+        char tz[WALLCLOCK_TZ_LEN];
+    };
+
+    struct Stats
+    {
+        uint32_t syncs;
+        uint32_t steps;            // corrections too large to slew
+        int64_t  lastSyncUs;       // monotonic time of the last sync, 0 if none
+        int64_t  lastErrorUs;      // last sync vs. the extrapolated mapping
+        float    driftPpm;         // esp_timer rate error, positive = running slow
+    };
+
+    /**
+     * Applies the timezone and, if the RTC kept UTC through a deep sleep
+     * or soft reset, seeds the mapping from it until the first sync.
+     */
+    void begin(const char *tz)
+    {
+        setTimezone(tz);
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        if (tv.tv_sec > WALLCLOCK_VALID_AFTER) {
+            int64_t offset = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - esp_timer_get_time();
+            portENTER_CRITICAL(&lock);
+            offsetUs = baseOffsetUs = offset;
+            baseMonoUs = slewMonoUs = esp_timer_get_time();
+            isValid = true;
+            portEXIT_CRITICAL(&lock);
+        }
+    }
+
+    /* Starts background SNTP; call once the network is up */
+    void start()
+    {
+        if (running) {
+            return;
+        }
+        running = true;
+        sntp_setoperatingmode(SNTP_OPMODE_POLL);
+        sntp_setservername(0, (char *)WALLCLOCK_NTP_SERVER);
+        sntp_setservername(1, (char *)WALLCLOCK_NTP_SERVER2);
+        sntp_set_sync_interval(WALLCLOCK_RESYNC_MS);
+        sntp_set_time_sync_notification_cb(onSync);
+        sntp_init();
+    }
+
+    bool started() const { return running; }
+
+    /**
+     * Sets the POSIX TZ rule, e.g. "NZST-12NZDT,M9.5.0,M4.1.0/3", on the
+     * calling task; see requestTimezone() once the pipeline is running.
+     * @return False if the string is not a plausible TZ rule.
+     */
+    bool setTimezone(const char *tz)
+    {
+        if (!validTimezone(tz)) {
+            return false;
+        }
+        strlcpy(zone.tz, tz, sizeof(zone.tz));
+        setenv("TZ", zone.tz, 1);
+        tzset();
+        return true;
+    }
+
+    /**
+     * Queues a TZ rule from another task. TZ is process-wide, so it is
+     * only switched by the task that converts sample times, via
+     * applyPendingTimezone().
+     * @return False if the string is not a plausible TZ rule.
+     */
+    bool requestTimezone(const char *tz)
+    {
+        if (!validTimezone(tz)) {
+            return false;
+        }
+        portENTER_CRITICAL(&lock);
+        strlcpy(pending.tz, tz, sizeof(pending.tz));
+        portEXIT_CRITICAL(&lock);
+        return true;
+    }
+
+    /* @return True if a queued rule was applied */
+    bool applyPendingTimezone()
+    {
+        Zone z;
+        portENTER_CRITICAL(&lock);
+        z = pending;
+        pending.tz[0] = '\0';
+        portEXIT_CRITICAL(&lock);
+        return z.tz[0] && setTimezone(z.tz);
+    }
+
+    const Zone &timezone() const { return zone; }
+
+    bool valid() const { return isValid; }       // has a UTC mapping
+    bool synced() const { return stat.syncs; }   // from SNTP this boot
+
+    /* UTC milliseconds since the epoch, never decreasing; 0 while invalid */
+    uint64_t utcMillis()
+    {
+        if (!isValid) {
+            return 0;
+        }
+        int64_t mono = esp_timer_get_time();
+        portENTER_CRITICAL(&lock);
+        int64_t target = baseOffsetUs + (int64_t)(stat.driftPpm * (mono - baseMonoUs) / 1e6f);
+        int64_t maxSlew = (mono - slewMonoUs) * WALLCLOCK_SLEW_PPM / 1000000;
+        int64_t diff = target - offsetUs;
+        offsetUs += diff > maxSlew ? maxSlew : (diff < -maxSlew ? -maxSlew : diff);
+        slewMonoUs = mono;
+        int64_t utc = mono + offsetUs;
+        if (utc < lastUtcUs) {
+            utc = lastUtcUs;   // held after a backward step until real time catches up
+        }
+        lastUtcUs = utc;
+        portEXIT_CRITICAL(&lock);
+        return (uint64_t)utc / 1000;
+    }
+
+    /* Local-time epoch seconds (calendar fields as if UTC) for a UTC instant */
+    static uint32_t localSeconds(uint64_t utcMs)
+    {
+        time_t t = (time_t)(utcMs / 1000);
+        struct tm tm;
+        localtime_r(&t, &tm);
+        return (uint32_t)daysFromCivil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) * 86400 +
+               tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+    }
+
+    /**
+     * The later of the held local time and a new reading, so the hour
+     * repeated when DST ends does not step back. Compared modulo 2^32:
+     * local seconds wrap in 2106, sooner in zones ahead of UTC.
+     * @param held 0 while nothing is held yet.
+     */
+    static uint32_t holdLocal(uint32_t held, uint32_t localS)
+    {
+        return !held || (int32_t)(localS - held) > 0 ? localS : held;
+    }
+
+    const Stats &stats() const { return stat; }
+
+private:
+    static bool validTimezone(const char *tz)
+    {
+        size_t len = tz ? strlen(tz) : 0;
+        if (!len || len >= WALLCLOCK_TZ_LEN) {
+            return false;
+        }
+        // std name: three or more letters, or <quoted>; then a UTC offset
+        const char *p = tz;
+        if (*p == '<') {
+            p = strchr(p, '>');
+            if (!p) {
+                return false;
+            }
+            p++;
+        } else {
+            while (isalpha((unsigned char)*p)) {
+                p++;
+            }
+            if (p - tz < 3) {
+                return false;
+            }
+        }
+        if (*p == '+' || *p == '-') {
+            p++;
+        }
+        return isdigit((unsigned char)*p);
+    }
+
+    static void onSync(struct timeval *tv);
+
+    /* Runs in the lwIP task after SNTP has set the system time */
+    void applySync()
+    {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        int64_t mono = esp_timer_get_time();
+        int64_t offset = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - mono;
+
+        portENTER_CRITICAL(&lock);
+        if (isValid) {
+            int64_t predicted = baseOffsetUs + (int64_t)(stat.driftPpm * (mono - baseMonoUs) / 1e6f);
+            stat.lastErrorUs = offset - predicted;
+            if (stat.syncs && mono > baseMonoUs) {
+                float ppm = (float)(offset - baseOffsetUs) * 1e6f / (mono - baseMonoUs);
+                stat.driftPpm = stat.syncs == 1 ? ppm : 0.75f * stat.driftPpm + 0.25f * ppm;
+            }
+        }
+        if (!isValid || llabs(offset - offsetUs) > WALLCLOCK_STEP_US) {
+            offsetUs = offset;
+            if (isValid) {
+                stat.steps++;
+            }
+        }
+        baseOffsetUs = offset;
+        baseMonoUs = slewMonoUs = mono;
+        stat.lastSyncUs = mono;
+        stat.syncs++;
+        isValid = true;
+        portEXIT_CRITICAL(&lock);
+    }
+
+    portMUX_TYPE  lock = portMUX_INITIALIZER_UNLOCKED;
+    Zone          zone = {};
+    Zone          pending = {};
+    volatile bool isValid = false;
+    bool          running = false;
+    int64_t       offsetUs = 0;        // applied UTC - monotonic
+    int64_t       baseOffsetUs = 0;    // measured at the last sync
+    int64_t       baseMonoUs = 0;
+    int64_t       slewMonoUs = 0;
+    int64_t       lastUtcUs = 0;
+    Stats         stat = {};
+};
+
+WallClock wallClock;
+
+inline void WallClock::onSync(struct timeval *)
+{
+    wallClock.applySync();
+}
+
+#endif // WALL_CLOCK_H
@@ -6,119 +6,550 @@ void setup()
   Serial.begin(115200);
   Serial1.setRxFIFOFull(32);
   Serial1.begin(115200, SERIAL_8N1);
-  EEPROM.begin(512);
-  // Initialize ADC and mark filter monitor as uninitialized
-  analogSetAttenuation(ADC_11db);
+  powerManager.begin(TIME_TO_SLEEP);
+  powerManager.addWakePin((gpio_num_t)BOARD_BUTTON_PIN, WAKE_BUTTON, true);
+#ifdef FLOW_WAKE_PIN
+  powerManager.addWakePin((gpio_num_t)FLOW_WAKE_PIN, WAKE_FLOW, false);
+#endif
+  if (!statePartition.begin("hglog") || !stateStore.begin(statePartition))
+  {
+    debugln("State log partition unavailable, keeping state in NVS");
+    if (!stateStore.beginNvs(LOG_NVS_NAMESPACE))
+    {
+      debugln("State store unavailable, running without persistence");
+    }
+  }
+  migrateLegacyValveState();
+  wallClock.begin(WALLCLOCK_DEFAULT_TZ); // the RTC keeps UTC through deep sleep and soft resets
+  // Safe state first: valve at its last position, lockouts and detector state restored
+  valve.begin();
+  powerManager.releaseHold((gpio_num_t)SERVOPIN); // latched through deep sleep, driven again now
   filterMonitor.reset(); // Reset to uninitialized state
-  delay(100); // Give ADC time to stabilize
-
-  // Then initialize pressure sensors
-  init_pressure_ch1();
-  init_pressure_ch2();
+  flowThreshold = 30.0;
+  restoreState();
+  bootTiming.safeUs = esp_timer_get_time();
+  debugln("Safe state after " + String((uint32_t)(bootTiming.safeUs / 1000)) + " ms");
 
-  // Take a few initial readings to prime the moving average
-  for (int i = 0; i < WINDOW_SIZE; i++)
+  if (!telemetryBuffer.begin(bufferPartition.begin("hgtlm") ? &bufferPartition : nullptr))
   {
-    readPressureRaw_ch1();
-    readPressureRaw_ch2();
-    delay(10);
+    debugln("Telemetry flash buffer unavailable, offline data kept in RAM only");
   }
-  flowThreshold = 30.0;
+  analogSetAttenuation(ADC_11db);
+  init_pressure_ch1();
+  init_pressure_ch2();
+  primePressureFilters();
+  uvLedger.begin();
+  uvLamp.begin();
+  applySamplePeriod();
   BlynkEdgent.begin();
+  powerManager.noteBootWake();
+  initConsoleCommands();
+  initTelemetry();
   // enableOTA();
   debugln("Setup complete");
 
-  readFlowSensorData(readflowCommand, sizeof(readflowCommand), flowrate, cumulativeFlow, *pData, sizeof(*pData));
-  initFlowThreshold();
-  pressureCH1 = readPressureRaw_ch1();
-  pressureCH2 = readPressureRaw_ch2();
+  // The first meter reading arrives with the first sample
+  startPipeline();
 }
 
 void loop()
-{ 
-  BlynkEdgent.run();
-  // server.handleClient();
-  memset(*pData, 0, sizeof(*pData));
-  uint32_t now = millis();
+{
+  // All work runs in the pipeline tasks started from setup()
+  vTaskDelete(NULL);
+}
+
+/**
+ * Wires the bounded SPSC queues and telemetry sinks and starts the pinned
+ * tasks: acquisition → safety on the sensor core; cloud, MQTT and LAN
+ * streaming on the Wi-Fi core.
+ */
+void startPipeline()
+{
+  // The safety task sleeps until a sample or a control command arrives
+  sampleQueue.attach(&safetyTaskHandle);
+  controlQueue.attach(&safetyTaskHandle);
+  telemetrySinks.attach(&blynkSink);
+  telemetrySinks.attach(&mqttSink);
 
-  if (!isTimeSet && WiFi.status() == WL_CONNECTED)
+  xTaskCreatePinnedToCore(safetyTask, "safety", SAFETY_STACK, NULL, SAFETY_PRIORITY, &safetyTaskHandle, SENSOR_CORE);
+  xTaskCreatePinnedToCore(acquisitionTask, "acquire", ACQ_STACK, NULL, ACQ_PRIORITY, &acquisitionTaskHandle, SENSOR_CORE);
+  xTaskCreatePinnedToCore(cloudTask, "cloud", CLOUD_STACK, NULL, CLOUD_PRIORITY, &cloudTaskHandle, CLOUD_CORE);
+  xTaskCreatePinnedToCore(mqttTask, "mqtt", MQTT_STACK, NULL, MQTT_PRIORITY, &mqttTaskHandle, CLOUD_CORE);
+  xTaskCreatePinnedToCore(lanTask, "lan", LAN_STACK, NULL, LAN_PRIORITY, &lanTaskHandle, CLOUD_CORE);
+  if (!powerManager.wokeFromDeepSleep())
   {
-    setupTime();
+    reportMissingPartitions();
   }
+}
 
-  if (now - flowTime > 5000)
+/*
+ * hglog and hgtlm only exist on units whose partition table was flashed
+ * over serial; an OTA update keeps the old table. Raised once per power-on
+ * so the installer knows persistence is degraded.
+ */
+void reportMissingPartitions()
+{
+  const bool noLog = !statePartition.size();
+  const bool noBuffer = !bufferPartition.size();
+  if (!noLog && !noBuffer)
   {
-    flowTime = millis();
-    isFlowAvailable = readFlowSensorData(readflowCommand, sizeof(readflowCommand), flowrate, cumulativeFlow, *pData, sizeof(*pData));
-    debugln(isFlowAvailable ? "Flow data available" : "Flow data not available");
-    flowusage.currentHour = (uint8_t)rtc.getHour();
-    flowusage.today = (uint8_t)rtc.getDay();
-    flowusage.currentMonth = (uint8_t)rtc.getMonth();
+    return;
   }
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%s%sReflash partitions.csv over serial",
+           noLog ? (stateStore.usesNvs() ? "hglog missing: state in NVS. " : "hglog missing: state not saved. ") : "",
+           noBuffer ? "hgtlm missing: backlog in RAM. " : "");
+  debugln(msg);
+  postEvent("partition_missing", msg);
+}
 
-  if ((now - reportTime >= UPDATE_FREQ) || (isFlowAvailable && (flowrate != lastReportedFlowrate)))
+/* Owns Serial1 and the ADC; produces one Sample_t per poll period */
+void acquisitionTask(void *)
+{
+  TickType_t lastWake = xTaskGetTickCount();
+  uint32_t pushed = 0;
+  for (;;)
   {
-    reportTime = now;
-    lastReportedFlowrate = flowrate;
-    // Reset filters when there's no flow or at heartbeat interval
-    // if (flowrate == 0 || now - reportTime >= UPDATE_FREQ)
-    // {
-    //   resetPressureFilters();
-    // }
-    pressureCH1 = readPressureRaw_ch1();
-    pressureCH2 = readPressureRaw_ch2();
-    UVVoltage = readUV();
-    displayFlow();
-    sendESPdata();
-    processData();
-    checkBurst();
-    checkShutoff();
-    checkhourlyFlow();
-    checkdailyFlow();
-    checkmonthlyFlow();
-    sendDatatoBlynk();
-    memset(*pData, 0, sizeof(*pData)); // Clear the array after use
+    if (resetTotalRequested)
+    {
+      resetTotalRequested = false;
+      debugln("Resetting Cumulative Flow");
+      resetTotalFlow(rstCFlowCommand, sizeof(rstCFlowCommand));
+    }
+
+    Sample_t sample = {};
+    int64_t mark = StageProfiler::now();
+    sample.flowValid = readFlowSensorData(readflowCommand, sizeof(readflowCommand),
+                                          sample.flowrate, sample.cumulativeFlow, *pData, sizeof(*pData));
+    stageProfiler.lap(PERF_FLOW_READ, mark);
+    sample.uvAdc = readUV();
+    sample.pressure1 = readPressureKpa_ch1();
+    sample.pressure2 = readPressureKpa_ch2();
+    stageProfiler.lap(PERF_ANALOG_READ, mark);
+    sample.acquiredUs = esp_timer_get_time();
+    sample.acquiredMs = millis();
+    sample.epochMs = wallClock.utcMillis();
+    if (sampleQueue.push(sample))
+    {
+      pushed++;
+    }
+    sampleTap.publish(sample);
+
+    if (!powerManager.lowPower())
+    {
+      powerManager.account(esp_timer_get_time());
+      tracePressure(lastWake + pdMS_TO_TICKS(ACQ_PERIOD_MS));
+      vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(ACQ_PERIOD_MS));
+      continue;
+    }
+    int64_t cycleUs = (int64_t)powerManager.config().periodS * uS_TO_S_FACTOR;
+    idleUntil(sample.acquiredUs + cycleUs, pushed);
+    lastWake = xTaskGetTickCount(); // the tick count does not advance through light sleep
+  }
+}
+
+/**
+ * While a LAN client is streaming, reads both pressure channels every
+ * TRACE_PERIOD_MS until the next meter poll is due. The readings bypass
+ * the moving average, which stays with the once-per-poll samples, so
+ * transients such as water hammer show up in the trace.
+ */
+void tracePressure(TickType_t until)
+{
+  TickType_t wake = xTaskGetTickCount();
+  while (lanStream.tracing() && (int32_t)(until - wake) > (int32_t)pdMS_TO_TICKS(TRACE_PERIOD_MS))
+  {
+    PressurePoint_t point;
+    point.pressure1 = adcToKpa(analogRead(PRESSCH1));
+    point.pressure2 = adcToKpa(analogRead(PRESSCH2));
+    point.acquiredUs = esp_timer_get_time();
+    point.epochMs = wallClock.utcMillis();
+    pressureTrace.publish(point);
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(TRACE_PERIOD_MS));
   }
 }
+
+/* Nothing left for the safety or cloud task to do with the last sample */
+bool pipelineQuiet(uint32_t pushed)
+{
+  return samplesProcessed == pushed && sampleQueue.empty() && controlQueue.empty() &&
+         !valve.isMoving() && powerManager.cloudIdleThrough() == pushed;
+}
+
+/**
+ * Low-power wait for the next acquisition deadline. Once the pipeline is
+ * quiet the unit light-sleeps, or in deep-sleep mode deep-sleeps if no
+ * flow event or night window is in progress (their state is not retained
+ * and a restart would cut them short). Anything still busy falls back to
+ * an ordinary delay.
+ */
+void idleUntil(int64_t deadlineUs, uint32_t pushed)
+{
+  int64_t settleUs = esp_timer_get_time() + POWER_SETTLE_MS * 1000LL;
+  while (!pipelineQuiet(pushed) && esp_timer_get_time() < settleUs)
+  {
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+  int64_t now = esp_timer_get_time();
+  powerManager.account(now);
+  int64_t remainingUs = deadlineUs - now;
+  if (remainingUs < (int64_t)POWER_MIN_SLEEP_MS * 1000)
+  {
+    return;
+  }
+  if (!pipelineQuiet(pushed))
+  {
+    vTaskDelay(pdMS_TO_TICKS(remainingUs / 1000));
+    return;
+  }
+  if (powerManager.config().mode == POWER_DEEP_SLEEP && !flowGuard.inEvent() && !flowEvents.inEvent() &&
+      !nightFlow.active())
+  {
+    powerManager.deepSleep(remainingUs, (gpio_num_t)SERVOPIN);
+  }
+  powerManager.lightSleep(remainingUs);
+}
+
+/* Owns the valve and all detection state; never touches the network */
+void safetyTask(void *)
+{
+  for (;;)
+  {
+    Control_t control;
+    while (controlQueue.pop(control))
+    {
+      applyControl(control);
+    }
+
+    Sample_t sample;
+    if (sampleQueue.pop(sample, pdMS_TO_TICKS(SAFETY_TICK_MS)))
+    {
+      processSample(sample);
+    }
+
+    valve.run();
+    if (valve.takeStuckEvent())
+    {
+      postEvent("valve_stuck", valve.targetOpen() ? "Valve failed to open" : "Valve failed to close");
+    }
+  }
+}
+
+/* Runs Edgent, the console and everything that talks to Blynk */
+void cloudTask(void *)
+{
+  for (;;)
+  {
+    netHoldDown = outageProbe.simulating();
+    outageProbe.cloudPass(Blynk.connected());
+    blynkSink.setConnected(Blynk.connected());
+
+    // In the sleep modes the radio is only up for batched uploads and alerts
+    uint32_t seen = samplesProcessed;
+    uint32_t now = millis();
+    bool drained = Blynk.connected() && eventQueue.empty() && reportQueue.empty() &&
+                   !telemetryBuffer.backlog();
+    bool radio = edgentNeedsRadio() || powerManager.radioWanted(now, !eventQueue.empty(), drained);
+    powerManager.noteRadio(radio, now);
+
+    int64_t mark = StageProfiler::now();
+    if (radio)
+    {
+      AllocScope scope(ALLOC_EDGENT);
+      BlynkEdgent.run();
+    }
+    else
+    {
+      radioOff();
+      app_loop(); // console and Edgent timers keep running offline
+    }
+    stageProfiler.lap(PERF_EDGENT, mark);
+    if (!bootTiming.cloudUs && Blynk.connected())
+    {
+      reportBootTiming();
+    }
+
+    if (!wallClock.started() && WiFi.status() == WL_CONNECTED)
+    {
+      wallClock.start(); // SNTP resyncs in the background from here on
+    }
+
+    // While the radio is down alerts wait in the queue for the window they open
+    CloudEvent_t event;
+    while ((!powerManager.lowPower() || Blynk.connected()) && eventQueue.pop(event))
+    {
+      dispatchEvent(event);
+      blynkSink.noteSent();
+    }
+
+    // Everything queued since the last pass goes out back to back, one group per sample
+    Report_t reports[REPORT_BATCH];
+    size_t n = reportQueue.popBatch(reports, REPORT_BATCH);
+    for (size_t i = 0; i < n; i++)
+    {
+      mark = StageProfiler::now();
+      sendDatatoBlynk(reports[i]);
+      stageProfiler.lap(PERF_SEND, mark);
+    }
+    blynkSink.noteSent(n);
+    telemetry.flush(millis());
+    backfillTelemetry();
+    publishPerf();
+    publishEnergy();
+    sampleHeap();
+
+    if (!radio && powerManager.config().mode == POWER_DEEP_SLEEP)
+    {
+      telemetryBuffer.flushToFlash(); // RAM does not survive deep sleep
+    }
+    powerManager.setCloudIdle(!radio && reportQueue.empty() && eventQueue.empty(), seen);
+
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+/* Drains the MQTT sink beside the cloud task, so a slow broker or cloud never holds up the other */
+void mqttTask(void *)
+{
+  for (;;)
+  {
+    mqttSink.run(millis(), WiFi.status() == WL_CONNECTED && !outageProbe.simulating());
+    vTaskDelay(pdMS_TO_TICKS(MQTT_POLL_MS));
+  }
+}
+
+/* Serves the local streaming endpoint while the station link is up */
+void lanTask(void *)
+{
+  for (;;)
+  {
+    lanStream.poll(millis(), WiFi.status() == WL_CONNECTED && !outageProbe.simulating());
+    vTaskDelay(pdMS_TO_TICKS(LAN_POLL_MS));
+  }
+}
+
+void processSample(const Sample_t &sample)
+{
+  uint32_t now = sample.acquiredMs;
+
+  isFlowAvailable = sample.flowValid;
+  if (sample.epochMs)
+  {
+    // Local time repeats an hour when DST ends; holding it keeps rollups from rebasing
+    sampleLocalS = WallClock::holdLocal(sampleLocalS, WallClock::localSeconds(sample.epochMs));
+  }
+  if (sample.flowValid)
+  {
+    flowrate = sample.flowrate;
+    cumulativeFlow = sample.cumulativeFlow;
+    if (totaliser.update(cumulativeFlow, now))
+    {
+      saveTotaliserState(); // meter reset/rollover: the old baseline is gone
+    }
+    initFlowThreshold();
+  }
+  UVVoltage = sample.uvAdc;
+  pressureCH1 = sample.pressure1;
+  pressureCH2 = sample.pressure2;
+  debugln(isFlowAvailable ? "Flow data available" : "Flow data not available");
+
+  // Safety decisions first, so their latency excludes reporting work
+  blynk_data.flowrate = flowrate / 60.0; // Convert L/hr to L/min
+  checkBurst();
+  checkContinuousFlow(now);
+  int64_t mark = StageProfiler::now();
+  checkShutoff();
+  stageProfiler.lap(PERF_SHUTOFF, mark);
+  uint32_t latencyUs = (uint32_t)(esp_timer_get_time() - sample.acquiredUs);
+  safetyLatency.record(latencyUs);
+  if (latencyUs > SAFETY_BUDGET_US)
+  {
+    safetyBudgetMisses++;
+  }
+  outageProbe.recordSample(sample.acquiredUs, latencyUs, latencyUs > SAFETY_BUDGET_US);
+
+  accountUVDose(now);
+  uvLamp.update(UVVoltage >= UV_LAMP_ON_ADC, uvIrradiance(UVVoltage), now);
+
+  displayFlow();
+  sendESPdata();
+  mark = StageProfiler::now();
+  processData();
+  stageProfiler.lap(PERF_PROCESS_DATA, mark);
+  if (sampleLocalS && isFlowAvailable) // rollup boundaries are meaningless before the clock is set
+  {
+    updateRollups();
+    checkNightFlow();
+  }
+  trackFlowEvents(now);
+  if (isUsageDirty)
+  {
+    saveUsageState();
+  }
+
+  // Every sample goes to every sink; the Blynk-side publisher decides what it sends
+  Report_t report = {};
+  report.epochMs = sample.epochMs;
+  report.flowrate = blynk_data.flowrate;
+  report.cumulativeflow = blynk_data.cumulativeflow;
+  report.irradiance = blynk_data.irradiance;
+  report.dosage = blynk_data.dosage;
+  report.pressure1 = blynk_data.pressure1;
+  report.pressure2 = blynk_data.pressure2;
+  report.blockagePercentage = blockagePercentage;
+  report.underDosedLitres = uvLedger.current().underDosedLitres;
+  report.lampHours = uvLamp.runHours();
+  report.lampHoursLeft = uvLamp.hoursRemaining();
+  report.hasValveLatency = valve.latency.samples() > 0;
+  report.valveLatencyMs = valve.latency.last();
+  report.safetyP99Us = safetyLatency.percentile(99);
+  telemetrySinks.report(report);
+
+  saveRtcSnapshot();
+  samplesProcessed++;
+}
+
+/* Applies a command raised by a Blynk handler or the console */
+void applyControl(const Control_t &control)
+{
+  switch (control.type)
+  {
+  case CTRL_VALVE_MANUAL:
+    if (control.value)
+    {
+      blynk_data.userUpdate = 1;
+      valve.command(false, true);
+    }
+    else
+    {
+      blynk_data.userUpdate = 0;
+      burstData.valveLockedDueToLeak = false;
+      burstData.burstDetection = false;
+      burstData.leakConfirmed = false;
+      saveBurstState();
+      valve.command(true, true);
+    }
+    break;
+  case CTRL_SHUTOFF_OVERRIDE:
+    disableShutoff = control.value ? 1 : 0;
+    saveSettings();
+    break;
+  case CTRL_FLOW_THRESHOLD:
+    flowThreshold = control.value;
+    saveSettings();
+    debugln("Flow threshold updated to: " + String(flowThreshold) + " L/min");
+    break;
+  case CTRL_LAMP_RESET:
+    debugln("UV lamp replaced, resetting run-hours");
+    uvLamp.reset();
+    break;
+  case CTRL_FLOW_LIMITS:
+  {
+    ContinuousFlowGuard::Limits limits = {(uint16_t)control.value, 0, control.args[0]};
+    flowGuard.setLimits(limits);
+    stateStore.writeValue(LOG_KEY_FLOW_LIMITS, limits);
+    break;
+  }
+  case CTRL_POWER_CONFIG:
+  {
+    PowerManager::Config config = {(uint8_t)control.value, 0, (uint16_t)control.args[0], (uint16_t)control.args[1], 0};
+    powerManager.configure(config);
+    applySamplePeriod();
+    stateStore.writeValue(LOG_KEY_POWER, powerManager.config());
+    break;
+  }
+  case CTRL_TIMEZONE:
+    if (wallClock.applyPendingTimezone())
+    {
+      stateStore.writeValue(LOG_KEY_TIMEZONE, wallClock.timezone());
+    }
+    break;
+  case CTRL_MQTT_CONFIG:
+    stateStore.writeValue(LOG_KEY_MQTT, mqttSink.config());
+    break;
+  case CTRL_NIGHTFLOW_CONFIG:
+    if (nightFlow.configure((uint8_t)control.value, (uint8_t)control.args[0], control.args[1], (uint8_t)control.args[2]))
+    {
+      saveNightFlowState();
+    }
+    break;
+  }
+}
+
+void dispatchEvent(const CloudEvent_t &event)
+{
+  AllocScope scope(ALLOC_CLOUD);
+  switch (event.type)
+  {
+  case CLOUD_LOG_EVENT:
+    if (event.msg[0])
+    {
+      Blynk.logEvent(event.name, event.msg);
+    }
+    else
+    {
+      Blynk.logEvent(event.name);
+    }
+    break;
+  case CLOUD_RESOLVE_EVENT:
+    Blynk.resolveEvent(event.name);
+    break;
+  case CLOUD_WRITE_PIN:
+    telemetry.send(event.pin, event.value);
+    break;
+  case CLOUD_WRITE_TEXT:
+    if (Blynk.connected())
+    {
+      Blynk.virtualWrite(event.pin, event.msg);
+    }
+    break;
+  }
+}
+
 void checkShutoff()
 {
-  UVLampOn = (UVVoltage >= 650) ? "On" : "Off"; // Example threshold for 6 mW/cm²
+  UVLampOn = (UVVoltage >= UV_LAMP_ON_ADC) ? "On" : "Off";
 
   if (disableShutoff == 0 && !burstData.valveLockedDueToLeak)
   {
+    // Only report on an actual transition; repeated commands are no-ops
     if (UVLampOn.equals("Off"))
     {
-      Blynk.virtualWrite(V5, 1);
-      valveOff();
-      Blynk.logEvent("flostop_event");
+      if (valveOff())
+      {
+        postPin(V5, 1);
+        postEvent("flostop_event");
+      }
     }
     else if (!blynk_data.userUpdate)
     {
-      Blynk.virtualWrite(V5, 0);
-      valveOn();
+      if (valveOn())
+      {
+        postPin(V5, 0);
+      }
     }
   }
 }
 void displayFlow()
 {
-  char *msg = new char[255];
-  sprintf(msg, "Flowrate: %.3f", flowrate);
+  AllocScope scope(ALLOC_DISPLAY);
+  char msg[32];
+  snprintf(msg, sizeof(msg), "Flowrate: %.3f", flowrate);
   debugln(msg);
-  free(msg);
 }
 
 void processData()
 {
+  AllocScope scope(ALLOC_BLOCKAGE);
   blynk_data.flowrate = flowrate / 60.0; // Convert L/hr to L/min
   debugln(blynk_data.flowrate);
-  blynk_data.cumulativeflow = cumulativeFlow;
+  blynk_data.cumulativeflow = totaliser.litres();
   debugln(blynk_data.cumulativeflow);
-  blynk_data.irradiance = 10 * (UVVoltage * 3.3 / 4095.0) * 1.515;
+  blynk_data.irradiance = uvIrradiance(UVVoltage);
   debugln(blynk_data.irradiance);
-  blynk_data.pressure1 = readPressureKpa_ch1();
+  blynk_data.pressure1 = pressureCH1;
   debugln(blynk_data.pressure1);
-  blynk_data.pressure2 = readPressureKpa_ch2();
-  //blynk_data.pressure2 = 208.333 * (((3.30 * analogRead(6))/4095.0) - 0.6);
+  blynk_data.pressure2 = pressureCH2;
   debugln(blynk_data.pressure2);
   blynk_data.dosage = calculateUVDosage(&blynk_data.flowrate, &blynk_data.irradiance);
   debugln(blynk_data.dosage);
@@ -129,57 +560,714 @@ void processData()
   if (status.requiresAttention && blynk_data.flowrate > 2.0f)
   {
     String message = "Filter blockage at " + String(status.blockagePercentage, 1) + "% - " + status.message.c_str();
-    Blynk.logEvent("filter_blockage", message);
+    postEvent("filter_blockage", message);
+  }
+
+  blockagePercentage = status.blockagePercentage;
+}
+/**
+ * Registers the published pins with their deadband, minimum and heartbeat
+ * intervals. Anything not registered here (alerts, rollups, V5) bypasses
+ * the filter.
+ */
+void initTelemetry()
+{
+  telemetry.begin(blynkWritePin, blynkGroup);
+  //                  pin  deadband  min ms  heartbeat ms
+  telemetry.addChannel(V0,  0.1f,     1000,   UPDATE_FREQ); // flow L/min
+  telemetry.addChannel(V9,  1.0f,     60000,  UPDATE_FREQ); // cumulative L
+  telemetry.addChannel(V1,  0.5f,     10000,  UPDATE_FREQ); // irradiance mW/cm²
+  telemetry.addChannel(V2,  2.0f,     10000,  UPDATE_FREQ); // inlet kPa
+  telemetry.addChannel(V3,  2.0f,     10000,  UPDATE_FREQ); // outlet kPa
+  telemetry.addChannel(V4,  2.0f,     10000,  UPDATE_FREQ); // dose mJ/cm²
+  telemetry.addChannel(V14, 1.0f,     30000,  UPDATE_FREQ); // blockage %
+  telemetry.addChannel(V15, 0.5f,     60000,  UPDATE_FREQ); // under-dosed L
+  telemetry.addChannel(V16, 0.1f,     60000,  UPDATE_FREQ); // lamp hours
+  telemetry.addChannel(V17, 10.0f,    60000,  UPDATE_FREQ); // lamp hours left
+  telemetry.addChannel(V19, 0.5f,     0,      0);           // valve latency ms
+  telemetry.addChannel(V20, 5.0f,     60000,  UPDATE_FREQ); // safety p99 ms
+}
+
+bool blynkWritePin(uint8_t pin, double value)
+{
+  if (!Blynk.connected())
+  {
+    return false;
+  }
+  Blynk.virtualWrite(pin, value);
+  return true;
+}
+
+/* Wraps one sample's pins in a Blynk group stamped with its acquisition time */
+void blynkGroup(bool open, uint64_t epochMs)
+{
+  if (!open)
+  {
+    Blynk.endGroup();
+  }
+  else if (epochMs)
+  {
+    Blynk.beginGroup(epochMs);
+  }
+  else
+  {
+    Blynk.beginGroup();
+  }
+}
+
+void sendDatatoBlynk(const Report_t &report)
+{
+  AllocScope scope(ALLOC_CLOUD);
+  if (!Blynk.connected())
+  {
+    // Without a timestamp a backfilled sample could not be placed on the charts
+    if (report.epochMs)
+    {
+      telemetryBuffer.push(BufferedSample::fromReport(report));
+    }
+    return;
+  }
+  uint32_t now = millis();
+  telemetry.beginSample(report.epochMs);
+  telemetry.offer(V0, report.flowrate, now);
+  telemetry.offer(V9, report.cumulativeflow, now);
+  telemetry.offer(V1, report.irradiance, now);
+  telemetry.offer(V2, report.pressure1, now);
+  telemetry.offer(V3, report.pressure2, now);
+  telemetry.offer(V4, report.dosage, now);
+  telemetry.offer(V14, report.blockagePercentage, now);
+  telemetry.offer(V15, report.underDosedLitres, now);
+  if (report.hasValveLatency)
+  {
+    telemetry.offer(V19, report.valveLatencyMs, now);
+  }
+  telemetry.offer(V16, report.lampHours, now);
+  if (!isnan(report.lampHoursLeft))
+  {
+    telemetry.offer(V17, report.lampHoursLeft, now);
+  }
+  telemetry.offer(V20, report.safetyP99Us / 1000.0f, now);
+  telemetry.endSample();
+}
+
+/**
+ * Publishes the per-stage p99/max on V22 every PERF_PUBLISH_MS, heaviest
+ * stage first, so field units report where their time goes.
+ */
+void publishPerf()
+{
+  AllocScope scope(ALLOC_CLOUD);
+  static uint32_t lastPublishMs = 0;
+  uint32_t now = millis();
+  if (!Blynk.connected() || now - lastPublishMs < PERF_PUBLISH_MS)
+  {
+    return;
+  }
+  lastPublishMs = now;
+
+  static LatencyHistogram<PERF_BUCKETS> h; // one stage at a time, off the task stack
+  PerfStage heaviest = stageProfiler.heaviest();
+  char summary[192];
+  int len = snprintf(summary, sizeof(summary), "heaviest %s;", PERF_STAGE_NAMES[heaviest]);
+  for (uint8_t i = 0; i < PERF_STAGES && len > 0 && len < (int)sizeof(summary); i++)
+  {
+    stageProfiler.snapshot((PerfStage)i, h);
+    len += snprintf(summary + len, sizeof(summary) - len, " %s %.1f/%.1f ms", PERF_STAGE_NAMES[i],
+                    h.percentile(99) / 1000.0f, h.max() / 1000.0f);
+  }
+  Blynk.virtualWrite(V22, summary);
+}
+
+/**
+ * Publishes the energy budget on V23 once an hour (in the sleep modes, in
+ * the first upload window after the hour).
+ */
+void publishEnergy()
+{
+  static uint32_t lastPublishMs = 0;
+  uint32_t now = millis();
+  if (!Blynk.connected() || (lastPublishMs && now - lastPublishMs < POWER_HOUR_MS))
+  {
+    return;
   }
+  lastPublishMs = now;
+
+  const EnergyLedger &l = powerManager.ledger();
+  EnergyHour w = l.window();
+  char summary[96];
+  snprintf(summary, sizeof(summary), "%s: awake %.0f s/h, radio %.0f s/h, %u wakes, %.1f mAh/day",
+           POWER_MODE_NAMES[powerManager.config().mode], l.awakeMsPerHour() / 1000.0f,
+           w.elapsedMs() ? w.radioMs * 3600.0f / w.elapsedMs() : 0.0f, (unsigned)w.wakes, l.mAhPerDay());
+  Blynk.virtualWrite(V23, summary);
+}
 
-  Blynk.virtualWrite(V14, status.blockagePercentage);
+/* Records boot-to-cloud and publishes both boot milestones once on V24 */
+void reportBootTiming()
+{
+  bootTiming.cloudUs = esp_timer_get_time();
+  char summary[80];
+  snprintf(summary, sizeof(summary), "safe %u ms, cloud %.2f s (%s%s)",
+           (unsigned)(bootTiming.safeUs / 1000), bootTiming.cloudUs / 1e6f,
+           netFastConnected ? "fast connect" : "scan",
+           netLeaseReused ? ", cached lease" : "");
+  debugln(String("Boot timing: ") + summary);
+  Blynk.virtualWrite(V24, summary);
 }
-void sendDatatoBlynk()
+
+/* Provisioning, OTA and reset flows need the radio whatever the power mode */
+bool edgentNeedsRadio()
 {
-  Blynk.virtualWrite(V0, blynk_data.flowrate);
-  Blynk.virtualWrite(V9, blynk_data.cumulativeflow);
-  Blynk.virtualWrite(V1, blynk_data.irradiance);
-  Blynk.virtualWrite(V2, blynk_data.pressure1);
-  Blynk.virtualWrite(V3, blynk_data.pressure2);
-  Blynk.virtualWrite(V4, blynk_data.dosage);
+  return !BlynkState::is(MODE_RUNNING) && !BlynkState::is(MODE_CONNECTING_NET) &&
+         !BlynkState::is(MODE_CONNECTING_CLOUD);
+}
+
+/* Ends an upload window; the next one reconnects from scratch */
+void radioOff()
+{
+  if (WiFi.getMode() == WIFI_OFF)
+  {
+    return;
+  }
+  connectivityLeave(BlynkState::get(), MODE_CONNECTING_NET); // drop any attempt in flight
+  reconnect.pause(); // radio off by choice is not downtime
+  Blynk.disconnect();
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  BlynkState::set(MODE_CONNECTING_NET);
+}
+
+/**
+ * Adds a point to the heap trend every HEAP_TREND_PERIOD_MS and raises
+ * heap_fragmentation once per boot if the largest free block is on course
+ * to fall below what a TLS reconnect needs within HEAP_WARN_DAYS.
+ */
+void sampleHeap()
+{
+  static bool warned = false;
+  if (!heapTrend.sample(millis(), heap_caps_get_free_size(MALLOC_CAP_8BIT),
+                        heap_caps_get_largest_free_block(MALLOC_CAP_8BIT)))
+  {
+    return;
+  }
+  float days = heapTrend.daysUntil(HEAP_LARGEST_FLOOR);
+  if (warned || days >= HEAP_WARN_DAYS || !Blynk.connected())
+  {
+    return;
+  }
+  warned = true;
+  char msg[96];
+  snprintf(msg, sizeof(msg), "Largest free block %u B, falling %.0f B/day: %.1f days to %u B",
+           (unsigned)heapTrend.latest().largestBlock, -heapTrend.largestSlopePerDay(), days,
+           (unsigned)HEAP_LARGEST_FLOOR);
+  debugln(msg);
+  Blynk.logEvent("heap_fragmentation", msg);
+}
+
+/**
+ * Replays samples buffered while offline, oldest first, a small batch per
+ * TELEMETRY_BACKFILL_MS so the live stream keeps its share of the link.
+ * Each sample goes out as its own group at its original timestamp and
+ * bypasses the publisher's shadow (it is history, not the current value).
+ */
+void backfillTelemetry()
+{
+  AllocScope scope(ALLOC_CLOUD);
+  static uint32_t lastBackfillMs = 0;
+  uint32_t now = millis();
+  if (!Blynk.connected() || !telemetryBuffer.backlog() || now - lastBackfillMs < TELEMETRY_BACKFILL_MS)
+  {
+    return;
+  }
+  lastBackfillMs = now;
+
+  BufferedSample s;
+  for (uint8_t i = 0; i < TELEMETRY_BACKFILL_BATCH && telemetryBuffer.peek(s); i++)
+  {
+    blynkGroup(true, s.epochMs());
+    bool ok = blynkWritePin(V0, s.flowCentiLpm / 100.0) &&
+              blynkWritePin(V9, s.cumulativeDl / 10.0) &&
+              blynkWritePin(V1, s.irradianceCenti / 100.0) &&
+              blynkWritePin(V2, s.pressure1Deci / 10.0) &&
+              blynkWritePin(V3, s.pressure2Deci / 10.0) &&
+              blynkWritePin(V4, s.doseDeci / 10.0) &&
+              blynkWritePin(V14, s.blockageDeci / 10.0);
+    blynkGroup(false, 0);
+    if (!ok)
+    {
+      return; // link dropped mid-sample; keep it for the next attempt
+    }
+    telemetryBuffer.pop();
+  }
+}
+
+/* The dose and lamp-hour integrators cap gaps against the period in use */
+void applySamplePeriod()
+{
+  uint32_t periodMs = powerManager.lowPower() ? powerManager.periodMs() : ACQ_PERIOD_MS;
+  uvLedger.setSamplePeriod(periodMs);
+  uvLamp.setSamplePeriod(periodMs);
+}
+
+/**
+ * Integrates the volume that passed since the last flow poll into the
+ * UV dose ledger, and rolls/checkpoints the ledger on calendar boundaries.
+ */
+void accountUVDose(uint32_t now)
+{
+  static uint8_t ledgerHour = 0xFF;
+
+  if (isFlowAvailable)
+  {
+    float flowLpm = flowrate / 60.0; // L/hr -> L/min
+    float irradiance = uvIrradiance(UVVoltage);
+    uvLedger.addSample(flowLpm, calculateUVDosage(&flowLpm, &irradiance), now);
+  }
+
+  if (sampleLocalS)
+  {
+    time_t local = sampleLocalS;
+    struct tm tm;
+    gmtime_r(&local, &tm); // local-time seconds, so UTC conversion yields local fields
+    uvLedger.setDate((uint32_t)(tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday);
+    uint8_t hour = (uint8_t)tm.tm_hour;
+    if (hour != ledgerHour)
+    {
+      ledgerHour = hour;
+      uvLedger.checkpoint();
+    }
+  }
+}
+
+void printDoseDay(const UVDoseDay &d)
+{
+  edgentConsole.printf(R"json({"date":%u,"litres":%.1f,"under_dosed":%.1f,"min_dose":%.1f,"buckets":[)json",
+                       (unsigned)d.date, d.totalLitres, d.underDosedLitres, d.minDose);
+  for (uint8_t i = 0; i < UV_DOSE_BUCKETS; i++)
+  {
+    edgentConsole.printf(i ? ",%.1f" : "%.1f", d.litres[i]);
+  }
+  edgentConsole.print("]}\n");
+}
+
+void initConsoleCommands()
+{
+  edgentConsole.addCommand("uvdose", []() {
+    printDoseDay(uvLedger.current());
+    for (uint8_t i = 0; i < UV_DOSE_HISTORY; i++)
+    {
+      if (uvLedger.day(i).date)
+      {
+        printDoseDay(uvLedger.day(i));
+      }
+    }
+  });
+
+  edgentConsole.addCommand("store", []() {
+    const LogStore::Stats st = stateStore.getStats();
+    edgentConsole.printf(R"json({"ready":%d,"backend":"%s","sectors":%u,"payload":%u,"flash":%u,"wa":%.2f,"erases":%u,"coalesced":%u,"recovery_us":%u,"live":%u,"capacity":%u,"failed":%u,"failed_key":%u,"valve_commits":%u})json" "\n",
+                         stateStore.isReady(), stateStore.usesNvs() ? "nvs" : "hglog", (unsigned)st.sectors, (unsigned)st.payloadBytes, (unsigned)st.flashBytes,
+                         st.payloadBytes ? (float)st.flashBytes / st.payloadBytes : 0.0f, (unsigned)st.erases, (unsigned)st.coalesced,
+                         (unsigned)st.recoveryUs, (unsigned)st.liveBytes, (unsigned)LOG_LIVE_CAPACITY, (unsigned)st.failed,
+                         (unsigned)st.lastFailedKey, (unsigned)valve.flashCommits());
+  });
+
+  edgentConsole.addCommand("valve", [](int argc, const char** argv) {
+    // Same as the app's V5 switch; also the way to retry a valve latched stuck
+    if (argc >= 1 && (0 == strcmp(argv[0], "open") || 0 == strcmp(argv[0], "close")))
+    {
+      postControl(CTRL_VALVE_MANUAL, 0 == strcmp(argv[0], "close") ? 1 : 0);
+      edgentConsole.print(R"json({"status":"OK"})json" "\n");
+      return;
+    }
+    static const char *states[] = {"closed", "opening", "open", "closing", "stuck"};
+    const LatencyHistogram<64> &h = valve.latency;
+    edgentConsole.printf(R"json({"state":"%s","moves":%u,"unconfirmed":%u,"stuck":%u,"last_ms":%u,"p50_ms":%u,"p90_ms":%u,"p99_ms":%u,"max_ms":%u})json" "\n",
+                         states[valve.getState()], (unsigned)h.samples(), (unsigned)valve.unconfirmedMoves(),
+                         (unsigned)valve.stuckEvents(), (unsigned)h.last(), (unsigned)h.percentile(50),
+                         (unsigned)h.percentile(90), (unsigned)h.percentile(99), (unsigned)h.max());
+    for (uint8_t i = 0; i < 64; i++)
+    {
+      if (h.bucketCount(i))
+      {
+        edgentConsole.printf(" %6u ms+ %u\n", (unsigned)h.lowerBound(i), (unsigned)h.bucketCount(i));
+      }
+    }
+  });
+
+  edgentConsole.addCommand("telemetry", []() {
+    const TelemetryPublisher<12>::Stats &st = telemetry.getStats();
+    edgentConsole.printf(R"json({"offered":%u,"sent":%u,"saved":%u,"deadband":%u,"deferred":%u,"heartbeats":%u,"bypassed":%u,"failed":%u,"groups":%u})json" "\n",
+                         (unsigned)st.offered, (unsigned)st.sent, (unsigned)telemetry.saved(), (unsigned)st.deadband,
+                         (unsigned)st.deferred, (unsigned)st.heartbeats, (unsigned)st.bypassed, (unsigned)st.failed,
+                         (unsigned)st.groups);
+    for (uint8_t i = 0; i < telemetry.channelCount(); i++)
+    {
+      edgentConsole.printf(" V%-3u %10.3f sent %u\n", (unsigned)telemetry.channelPin(i),
+                           telemetry.channelShadow(i), (unsigned)telemetry.channelSends(i));
+    }
+  });
+
+  edgentConsole.addCommand("buffer", []() {
+    const TelemetryBuffer::Stats &st = telemetryBuffer.getStats();
+    edgentConsole.printf(R"json({"backlog":%u,"ram":%u,"ram_cap":%u,"ram_bytes":%u,"flash":%u,"flash_cap":%u,"flash_bytes":%u,"flash_ready":%d,"buffered":%u,"spilled":%u,"delivered":%u,"dropped":%u,"spill_failed":%u,"erases":%u})json" "\n",
+                         (unsigned)telemetryBuffer.backlog(), (unsigned)telemetryBuffer.ramBacklog(),
+                         (unsigned)TELEMETRY_RAM_SAMPLES, (unsigned)TelemetryBuffer::ramBudgetBytes(),
+                         (unsigned)telemetryBuffer.flashBacklog(), (unsigned)telemetryBuffer.flashCapacity(),
+                         (unsigned)(telemetryBuffer.flashCapacity() * sizeof(BufferedSample)), telemetryBuffer.flashReady(),
+                         (unsigned)st.buffered, (unsigned)st.spilled, (unsigned)st.delivered,
+                         (unsigned)telemetryBuffer.dropped(), (unsigned)st.spillFailed, (unsigned)telemetryBuffer.flashErases());
+  });
+
+  // Exports the pending backlog, without consuming it, as base64 lines for tools/history_decode.cpp
+  edgentConsole.addCommand("history", [](int argc, const char** argv) {
+    struct Export
+    {
+      uint32_t printUs;
+    } exp = {0};
+    auto emit = [](void *ctx, const uint8_t *data, size_t len) {
+      uint32_t start = micros();
+      unsigned char line[4 * ((HIST_OUT_CHUNK + 2) / 3) + 1];
+      size_t n = 0;
+      bool ok = !mbedtls_base64_encode(line, sizeof(line), &n, data, len);
+      if (ok)
+      {
+        edgentConsole.printf(R"json({"hist":"%s"})json" "\n", (const char *)line);
+      }
+      ((Export *)ctx)->printUs += micros() - start;
+      return ok;
+    };
+    uint32_t max = argc > 0 ? strtoul(argv[0], nullptr, 10) : UINT32_MAX;
+    static HistoryEncoder enc; // ~1 KB block buffer, kept off the cloud task stack
+    uint32_t start = micros();
+    enc.begin(emit, &exp);
+    telemetryBuffer.visit([&](const BufferedSample &s) { return enc.add(s.historyRow()); }, max);
+    bool ok = enc.finish();
+    uint32_t encodeUs = micros() - start - exp.printUs;
+    uint32_t raw = enc.rows() * sizeof(BufferedSample);
+    edgentConsole.printf(R"json({"ok":%d,"samples":%u,"bytes":%u,"raw_bytes":%u,"ratio":%.2f,"encode_us":%u})json" "\n",
+                         ok, (unsigned)enc.rows(), (unsigned)enc.bytes(), (unsigned)raw,
+                         enc.bytes() ? (float)raw / enc.bytes() : 0.0f, (unsigned)encodeUs);
+  });
+
+  edgentConsole.addCommand("usage", [](int argc, const char** argv) {
+    uint8_t first = 0, last = ROLLUP_LEVELS - 1;
+    for (uint8_t l = 0; argc > 0 && l < ROLLUP_LEVELS; l++)
+    {
+      if (!strcmp(argv[0], ROLLUP_NAMES[l]))
+      {
+        first = last = l;
+      }
+    }
+    for (uint8_t l = first; l <= last; l++)
+    {
+      float series[60];
+      uint8_t n = flowRollup.series((RollupLevel)l, series, 60);
+      edgentConsole.printf(R"json({"level":"%s","period":%d,"current":%.1f,"buckets":[)json",
+                           ROLLUP_NAMES[l], (int)flowRollup.openPeriod((RollupLevel)l),
+                           flowRollup.current((RollupLevel)l));
+      for (uint8_t i = 0; i < n; i++)
+      {
+        edgentConsole.printf(i ? ",%.1f" : "%.1f", series[i]);
+      }
+      edgentConsole.print("]}\n");
+    }
+  });
+
+  edgentConsole.addCommand("total", []() {
+    edgentConsole.printf(R"json({"litres":%.3f,"meter":%.3f,"resets":%u,"rollovers":%u,"rejected":%u,"rebases":%u})json" "\n",
+                         totaliser.litres(), totaliser.persisted().lastMeter, (unsigned)totaliser.resets(),
+                         (unsigned)totaliser.rollovers(), (unsigned)totaliser.rejectedReads(), (unsigned)totaliser.rebases());
+  });
+
+  edgentConsole.addCommand("nightflow", [](int argc, const char** argv) {
+    if (argc >= 4)
+    {
+      postControl(CTRL_NIGHTFLOW_CONFIG, atoi(argv[0]), atoi(argv[1]), atof(argv[2]), atoi(argv[3]));
+      edgentConsole.print(R"json({"status":"OK"})json" "\n");
+      return;
+    }
+    const NightFlowMonitor::Config &c = nightFlow.config();
+    const NightFlowMonitor::Persisted &p = nightFlow.persisted();
+    edgentConsole.printf(R"json({"start":%u,"end":%u,"threshold_lph":%.2f,"nights":%u,"streak":%u,"flagged":%d,"baseline_lph":%.2f,"p10_lph":%.2f,"litres_day":%.1f,"evaluated":%u,"active":%d,"tonight_lph":%.2f})json" "\n",
+                         c.startHour, c.endHour, c.thresholdLph, c.nights, p.streak, p.flagged,
+                         p.lastBaselineLph, p.lastP10Lph, nightFlow.litresPerDay(), (unsigned)p.nightsEvaluated,
+                         nightFlow.active(), isnan(nightFlow.tonightLph()) ? -1.0f : nightFlow.tonightLph());
+  });
+
+  edgentConsole.addCommand("boot", [](int argc, const char** argv) {
+    edgentConsole.printf(R"json({"safe_ms":%.1f,"cloud_ms":%.1f,"fast_connect":%d,"cached_lease":%d,"reset_reason":%d})json" "\n",
+                         bootTiming.safeUs / 1000.0f, bootTiming.cloudUs ? bootTiming.cloudUs / 1000.0f : -1.0f,
+                         netFastConnected, netLeaseReused, (int)esp_reset_reason());
+  });
+
+  edgentConsole.addCommand("clock", [](int argc, const char** argv) {
+    if (argc >= 1)
+    {
+      if (!wallClock.requestTimezone(argv[0]))
+      {
+        edgentConsole.print(R"json({"status":"error","msg":"invalid TZ rule"})json" "\n");
+        return;
+      }
+      postControl(CTRL_TIMEZONE);
+      edgentConsole.print(R"json({"status":"OK"})json" "\n");
+      return;
+    }
+    const WallClock::Stats &s = wallClock.stats();
+    uint64_t utcMs = wallClock.utcMillis();
+    time_t local = WallClock::localSeconds(utcMs);
+    struct tm tm;
+    gmtime_r(&local, &tm);
+    edgentConsole.printf(R"json({"valid":%d,"synced":%d,"tz":"%s","local":"%04d-%02d-%02d %02d:%02d:%02d","utc_ms":%llu,"syncs":%u,"steps":%u,"since_sync_s":%d,"last_error_ms":%.1f,"drift_ppm":%.2f})json" "\n",
+                         wallClock.valid(), wallClock.synced(), wallClock.timezone().tz, tm.tm_year + 1900, tm.tm_mon + 1,
+                         tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned long long)utcMs, (unsigned)s.syncs,
+                         (unsigned)s.steps, s.lastSyncUs ? (int)((esp_timer_get_time() - s.lastSyncUs) / 1000000) : -1,
+                         s.lastErrorUs / 1000.0f, s.driftPpm);
+  });
+
+  edgentConsole.addCommand("link", [](int argc, const char** argv) {
+    uint32_t now = millis();
+    edgentConsole.printf(R"json({"state":%d,"tracked_s":%u,"stages":{)json", (int)BlynkState::get(),
+                         (unsigned)(reconnect.trackedMs() / 1000));
+    for (uint8_t i = 0; i < LINK_STAGES; i++)
+    {
+      const ReconnectScheduler::StageStats &s = reconnect.stage((LinkStage)i);
+      edgentConsole.printf(R"json(%s"%s":{"uptime":%.4f,"attempts":%u,"ok":%u,"failed":%u,"streak":%u,"backoff_ms":%u,"next_in_ms":%u,"connect_ms":{"last":%u,"p50":%u,"p90":%u,"max":%u}})json",
+                           i ? "," : "", LINK_STAGE_NAMES[i], reconnect.uptime((LinkStage)i), (unsigned)s.attempts,
+                           (unsigned)s.successes, (unsigned)s.failures, (unsigned)s.failStreak, (unsigned)s.waitMs,
+                           (unsigned)reconnect.waitLeft((LinkStage)i, now), (unsigned)s.lastConnectMs,
+                           (unsigned)s.connectMs.percentile(50), (unsigned)s.connectMs.percentile(90),
+                           (unsigned)s.connectMs.max());
+    }
+    edgentConsole.print("}}\n");
+  });
+
+  edgentConsole.addCommand("outage", [](int argc, const char** argv) {
+    if (argc >= 1)
+    {
+      uint32_t seconds = atoi(argv[0]);
+      if (!seconds || seconds > OUTAGE_MAX_S || outageProbe.running())
+      {
+        edgentConsole.print(R"json({"status":"error","msg":"usage: outage <1-600 s>, one run at a time"})json" "\n");
+        return;
+      }
+      outageProbe.start(seconds, reportQueue.drops, eventQueue.drops);
+      Blynk.disconnect();
+      WiFi.disconnect();
+      edgentConsole.print(R"json({"status":"OK"})json" "\n");
+      return;
+    }
+    OutageProbe::Result r = outageProbe.result(reportQueue.drops, eventQueue.drops);
+    edgentConsole.printf(R"json({"running":%d,"elapsed_s":%u,"samples":%u,"acq_gap_p99_ms":%.1f,"acq_gap_max_ms":%.1f,"safety_p99_us":%u,"safety_max_us":%u,"budget_misses":%u,"cloud_gap_max_ms":%.1f,"report_drops":%u,"event_drops":%u,"reconnect_ms":%d})json" "\n",
+                         outageProbe.running(), (unsigned)outageProbe.elapsedS(), (unsigned)r.samples,
+                         r.acqGapP99Us / 1000.0f, r.acqGapMaxUs / 1000.0f, (unsigned)r.safetyP99Us, (unsigned)r.safetyMaxUs,
+                         (unsigned)r.budgetMisses, r.cloudGapMaxUs / 1000.0f, (unsigned)r.reportDrops,
+                         (unsigned)r.eventDrops, (int)r.reconnectMs);
+  });
+
+  edgentConsole.addCommand("mqtt", [](int argc, const char** argv) {
+    if (argc >= 1)
+    {
+      MqttConfig c = mqttSink.config();
+      if (!strcmp(argv[0], "off"))
+      {
+        c.enabled = 0;
+      }
+      else
+      {
+        uint8_t qos = argc >= 3 ? atoi(argv[2]) : 1;
+        if (strlen(argv[0]) >= sizeof(c.host) || qos > 1)
+        {
+          edgentConsole.print(R"json({"status":"error","msg":"usage: mqtt <host|off> [port] [qos 0|1] [user] [pass]"})json" "\n");
+          return;
+        }
+        c = {};
+        c.enabled = 1;
+        c.qos = qos;
+        c.port = argc >= 2 ? atoi(argv[1]) : MQTT_DEFAULT_PORT;
+        strlcpy(c.host, argv[0], sizeof(c.host));
+        strlcpy(c.user, argc >= 4 ? argv[3] : "", sizeof(c.user));
+        strlcpy(c.pass, argc >= 5 ? argv[4] : "", sizeof(c.pass));
+      }
+      mqttSink.requestConfig(c);
+      postControl(CTRL_MQTT_CONFIG);
+      edgentConsole.print(R"json({"status":"OK"})json" "\n");
+      return;
+    }
+    MqttConfig c = mqttSink.config();
+    MqttSink::Session s = mqttSink.session();
+    edgentConsole.printf(R"json({"enabled":%d,"host":"%s","port":%u,"qos":%u,"connected":%d,"connects":%u,"disconnects":%u,"inflight":%u,"resent":%u,"sent_per_s":%.2f})json" "\n",
+                         c.enabled, c.host, (unsigned)c.port, (unsigned)c.qos, mqttSink.connected(),
+                         (unsigned)s.connects, (unsigned)s.disconnects, (unsigned)s.inflight, (unsigned)s.resent,
+                         s.sentPerS);
+  });
+
+  edgentConsole.addCommand("sinks", []() {
+    edgentConsole.print("[");
+    for (uint8_t i = 0; i < telemetrySinks.size(); i++)
+    {
+      const TelemetrySink &sink = telemetrySinks.sink(i);
+      const TelemetrySink::Stats &s = sink.stats();
+      edgentConsole.printf(R"json(%s{"name":"%s","active":%d,"connected":%d,"offered":%u,"dropped":%u,"sent":%u,"failed":%u})json",
+                           i ? "," : "", sink.name(), sink.active(), sink.connected(), (unsigned)s.offered,
+                           (unsigned)s.dropped, (unsigned)s.sent, (unsigned)s.failed);
+    }
+    edgentConsole.print("]\n");
+  });
+
+  edgentConsole.addCommand("lan", []() {
+    const LanStream::Stats &st = lanStream.stats();
+    edgentConsole.printf(R"json({"listening":%d,"port":%u,"tracing":%d,"trace_hz":%u,"accepted":%u,"rejected":%u,"stalled":%u,"gaps":%u,"clients":[)json",
+                         lanStream.listening(), (unsigned)LAN_STREAM_PORT, lanStream.tracing(),
+                         (unsigned)(1000 / TRACE_PERIOD_MS), (unsigned)st.accepted, (unsigned)st.rejected,
+                         (unsigned)st.stalled, (unsigned)st.gaps);
+    bool first = true;
+    for (uint8_t i = 0; i < LAN_MAX_CLIENTS; i++)
+    {
+      LanStream::ClientInfo c;
+      if (!lanStream.client(i, c))
+      {
+        continue;
+      }
+      edgentConsole.printf(R"json(%s{"ip":"%s","streaming":%d,"format":"%s","age_s":%u,"bytes":%u,"lag":%u,"gaps":%u})json",
+                           first ? "" : ",", IPAddress(c.ip).toString().c_str(), c.streaming,
+                           c.binary ? "bin" : "ndjson", (unsigned)c.ageS, (unsigned)c.bytes, (unsigned)c.lag,
+                           (unsigned)c.gaps);
+      first = false;
+    }
+    edgentConsole.print("]}\n");
+  });
+
+  edgentConsole.addCommand("power", [](int argc, const char** argv) {
+    for (uint8_t m = 0; argc >= 1 && m < POWER_MODES; m++)
+    {
+      if (!strcmp(argv[0], POWER_MODE_NAMES[m]))
+      {
+        postControl(CTRL_POWER_CONFIG, m, argc >= 2 ? atoi(argv[1]) : 0, argc >= 3 ? atoi(argv[2]) : 0, 0);
+        edgentConsole.print(R"json({"status":"OK"})json" "\n");
+        return;
+      }
+    }
+    const PowerManager::Config &c = powerManager.config();
+    const EnergyLedger &l = powerManager.ledger();
+    edgentConsole.printf(R"json({"mode":"%s","period_s":%u,"upload_min":%u,"radio":%d,"windows":%u,"failed_windows":%u,"awake_s_per_h":%.1f,"mah_day":%.2f,"wakes":{)json",
+                         POWER_MODE_NAMES[c.mode], c.periodS, c.uploadMin, powerManager.radioOn(),
+                         (unsigned)powerManager.uploadWindows(), (unsigned)powerManager.failedUploadWindows(),
+                         l.awakeMsPerHour() / 1000.0f, l.mAhPerDay());
+    for (uint8_t i = 0; i < WAKE_CAUSES; i++)
+    {
+      edgentConsole.printf(R"json(%s"%s":%u)json", i ? "," : "", WAKE_CAUSE_NAMES[i], (unsigned)l.wakesByCause[i]);
+    }
+    edgentConsole.print("}}\n");
+    for (uint8_t i = 0; i < l.filled; i++)
+    {
+      const EnergyHour &h = l.hour(i);
+      edgentConsole.printf(" -%2uh awake %6.1f s radio %6.1f s light %6.1f s deep %6.1f s wakes %4u %.2f mAh\n",
+                           (unsigned)(l.filled - i), h.awakeMs / 1000.0f, h.radioMs / 1000.0f, h.lightMs / 1000.0f,
+                           h.deepMs / 1000.0f, (unsigned)h.wakes, h.mAh());
+    }
+  });
+
+  edgentConsole.addCommand("flowlimits", [](int argc, const char** argv) {
+    if (argc >= 2)
+    {
+      postControl(CTRL_FLOW_LIMITS, atoi(argv[0]), atof(argv[1]), 0, 0);
+      edgentConsole.print(R"json({"status":"OK"})json" "\n");
+      return;
+    }
+    const ContinuousFlowGuard::Limits &l = flowGuard.getLimits();
+    edgentConsole.printf(R"json({"max_minutes":%u,"max_litres":%.0f,"in_event":%d,"event_s":%u,"event_litres":%.1f,"events":%u})json" "\n",
+                         l.maxMinutes, l.maxLitres, flowGuard.inEvent(), (unsigned)(flowGuard.durationMs(millis()) / 1000),
+                         flowGuard.volume(totaliser.litres()), (unsigned)flowGuard.eventCount());
+  });
+
+  edgentConsole.addCommand("events", []() {
+    for (uint8_t i = 0; i < flowEvents.eventCount(); i++)
+    {
+      const FlowEvent &e = flowEvents.event(i);
+      edgentConsole.printf(R"json({"start":%u,"use":"%s","seconds":%u,"litres":%.1f,"peak_lpm":%.1f,"mean_lpm":%.2f})json" "\n",
+                           (unsigned)e.startEpochS, END_USE_NAMES[e.use], (unsigned)e.durationS, e.volumeL,
+                           e.peakLpm, e.meanLpm());
+    }
+    edgentConsole.print(R"json({"today":{)json");
+    for (uint8_t u = 0; u < END_USE_CLASSES; u++)
+    {
+      edgentConsole.printf(R"json(%s"%s":[%u,%.1f])json", u ? "," : "", END_USE_NAMES[u],
+                           (unsigned)flowEvents.count((FlowEndUse)u), flowEvents.litres((FlowEndUse)u));
+    }
+    edgentConsole.print("}}\n");
+  });
+
+  edgentConsole.addCommand("tasks", []() {
+    TaskHandle_t tasks[] = {safetyTaskHandle, acquisitionTaskHandle, cloudTaskHandle, mqttTaskHandle, lanTaskHandle};
+    for (TaskHandle_t t : tasks)
+    {
+      if (t)
+      {
+        edgentConsole.printf(" %-8s prio:%u stack free:%u\n", pcTaskGetName(t),
+                             (unsigned)uxTaskPriorityGet(t), (unsigned)uxTaskGetStackHighWaterMark(t));
+      }
+    }
+    const QueueStats *queues[] = {&sampleQueue, &reportQueue, &eventQueue, &controlQueue};
+    const char *names[] = {"sample", "report", "event", "control"};
+    for (uint8_t i = 0; i < 4; i++)
+    {
+      edgentConsole.printf(" %-8s queue peak:%u/%u drops:%u\n", names[i],
+                           (unsigned)queues[i]->peak, (unsigned)queues[i]->length, (unsigned)queues[i]->drops);
+    }
+    edgentConsole.printf(" safety latency p50:%uus p99:%uus max:%uus budget:%uus misses:%u\n",
+                         (unsigned)safetyLatency.percentile(50), (unsigned)safetyLatency.percentile(99),
+                         (unsigned)safetyLatency.max(), (unsigned)SAFETY_BUDGET_US, (unsigned)safetyBudgetMisses);
+  });
+
+  edgentConsole.addCommand("lamp", [](int argc, const char** argv) {
+    if (argc >= 1 && 0 == strcmp(argv[0], "reset"))
+    {
+      // Applied by the safety task; a later `lamp` shows the cleared stats
+      postControl(CTRL_LAMP_RESET);
+      edgentConsole.print(R"json({"status":"OK"})json" "\n");
+      return;
+    }
+    edgentConsole.printf(R"json({"run_hours":%.2f,"cycles":%u,"i0":%.2f,"decay_pct_per_kh":%.2f,"hours_left":%.0f})json" "\n",
+                         uvLamp.runHours(), (unsigned)uvLamp.switchCycles(), uvLamp.initialIrradiance(),
+                         uvLamp.decayPerKHour(), isnan(uvLamp.hoursRemaining()) ? -1.0f : uvLamp.hoursRemaining());
+  });
+}
+BLYNK_CONNECTED()
+{
+  Blynk.syncVirtual(V12); // Sync disable shutoff setting
+  telemetry.invalidate(); // refresh every published pin once after (re)connecting
 }
 BLYNK_WRITE(V5)
 {
   if (param.asInt() == 1)
   {
-    blynk_data.userUpdate = 1;
-    valveOff();
+    postControl(CTRL_VALVE_MANUAL, 1);
   }
   else if (param.asInt() == 0)
   {
     Blynk.resolveEvent("flostop_event");
     Blynk.resolveEvent("leak_detected");
-    blynk_data.userUpdate = 0;
-    burstData.valveLockedDueToLeak = false;
-    burstData.burstDetection = false;
-    burstData.leakConfirmed = false;
-    valveOn();
+    postControl(CTRL_VALVE_MANUAL, 0);
   }
 }
 BLYNK_WRITE(V11)
 {
   if (param.asInt() == 1)
   {
-    debugln("Resetting Cumulative Flow");
-    resetTotalFlow(rstCFlowCommand, sizeof(rstCFlowCommand));
+    resetTotalRequested = true; // Serial1 belongs to the acquisition task
   }
 }
 BLYNK_WRITE(V12)
 {
   if (param.asInt() == 1)
   {
-    disableShutoff = 1;
+    postControl(CTRL_SHUTOFF_OVERRIDE, 1);
     Blynk.logEvent("auto_flostop_disabled");
   }
   else
   {
     Blynk.resolveEvent("auto_flostop_disabled");
-    disableShutoff = 0;
+    postControl(CTRL_SHUTOFF_OVERRIDE, 0);
   }
 }
 BLYNK_WRITE(V13)
@@ -187,90 +1275,275 @@ BLYNK_WRITE(V13)
   float value = param.asFloat();
   if (value > 0)
   {
-    flowThreshold = value;
-    debugln("Flow threshold updated to: " + String(flowThreshold) + " L/min");
+    postControl(CTRL_FLOW_THRESHOLD, value);
   }
   else
   {
     debugln("Invalid threshold value received: " + String(value));
   }
 }
-void setupTime()
+BLYNK_WRITE(V18)
 {
-  timeClient.begin();
-  timeClient.setTimeOffset(46800);
-  timeClient.update();
-  auto nzTime = timeClient.getEpochTime();
-  debugln(timeClient.getFormattedTime());
-  rtc.setTime(nzTime);
-  flowusage.previousMonth = (uint8_t)rtc.getMonth();
-  flowusage.flowLastMonth = cumulativeFlow;
-  flowusage.yesterday = (uint8_t)rtc.getDay();
-  flowusage.yesterdaysFlow = cumulativeFlow;
-  flowusage.previousHour = (uint8_t)rtc.getHour();
-  flowusage.flowPreviousHour = cumulativeFlow;
-
-  isTimeSet = true;
+  if (param.asInt() == 1)
+  {
+    postControl(CTRL_LAMP_RESET);
+  }
 }
-void sendESPdata()
+BLYNK_WRITE(V25)
 {
+  if (wallClock.requestTimezone(param.asStr()))
+  {
+    postControl(CTRL_TIMEZONE);
+  }
+  else
+  {
+    Blynk.virtualWrite(V25, wallClock.timezone().tz); // rejected: show the rule in force
+  }
+}
+/**
+ * Restores runtime state from the state log before the network comes up.
+ * Restored rollups fill the gap since their checkpoint on the first sample.
+ */
+/*
+ * Firmware before the state log kept the valve position in EEPROM byte 0.
+ * The EEPROM library stores its image as one NVS blob, read here directly:
+ * EEPROM.begin() would create a zeroed image (valve closed) on units that
+ * never had one. Runs until LOG_KEY_VALVE exists, so at most once per unit.
+ */
+void migrateLegacyValveState()
+{
+  uint8_t open;
+  if (!stateStore.isReady() || stateStore.readValue(LOG_KEY_VALVE, open))
+  {
+    return;
+  }
+  Preferences prefs;
+  if (!prefs.begin("eeprom", true))
+  {
+    return;
+  }
+  uint8_t image[LEGACY_EEPROM_SIZE];
+  size_t len = prefs.getBytesLength("eeprom");
+  if (len && prefs.getBytes("eeprom", image, sizeof(image)) == len && image[0] <= 1)
+  {
+    stateStore.writeValue(LOG_KEY_VALVE, image[0]);
+    debugln(image[0] ? "Migrated legacy valve state: open" : "Migrated legacy valve state: closed");
+  }
+  prefs.end();
 }
 
-void checkdailyFlow()
+void restoreState()
 {
-  if (flowusage.today != flowusage.yesterday)
+  PersistedSettings_t settings;
+  if (stateStore.readValue(LOG_KEY_SETTINGS, settings))
+  {
+    flowThreshold = settings.flowThreshold;
+    disableShutoff = settings.disableShutoff;
+  }
+
+  BurstDetection_t burst;
+  if (stateStore.readValue(LOG_KEY_BURST, burst))
+  {
+    burstData.leakConfirmed = burst.leakConfirmed;
+    burstData.burstDetection = burst.burstDetection;
+    burstData.valveLockedDueToLeak = burst.valveLockedDueToLeak;
+  }
+
+  FlowTotaliser::Persisted total;
+  if (stateStore.readValue(LOG_KEY_TOTAL, total))
+  {
+    totaliser.restore(total);
+  }
+
+  ContinuousFlowGuard::Limits limits;
+  if (stateStore.readValue(LOG_KEY_FLOW_LIMITS, limits))
   {
-    // Calculate today's flow
-    flowusage.todaysFlow = cumulativeFlow - flowusage.yesterdaysFlow;
-    Blynk.virtualWrite(V7, flowusage.todaysFlow);
+    flowGuard.setLimits(limits);
+  }
 
-    // Store the cumulative flow for the next day's comparison
-    flowusage.yesterdaysFlow = cumulativeFlow;
-    flowusage.yesterday = flowusage.today;
+  NightFlowMonitor::Persisted night;
+  if (stateStore.readValue(LOG_KEY_NIGHTFLOW, night))
+  {
+    nightFlow.restore(night);
+  }
 
-    // Debugging
-    debugln("Daily Flow: " + String(flowusage.todaysFlow));
-    debugln("Cumulative Flow: " + String(cumulativeFlow));
-    debugln("Yesterday's Flow: " + String(flowusage.yesterdaysFlow));
+  static FlowRollup::Persisted usage;
+  if (stateStore.readValue(LOG_KEY_USAGE, usage))
+  {
+    flowRollup.restore(usage);
+  }
+
+  static AdvancedBlockageDetector::Snapshot detector;
+  if (stateStore.readValue(LOG_KEY_DETECTOR, detector))
+  {
+    filterMonitor.restore(detector);
+  }
+
+  PowerManager::Config power;
+  if (stateStore.readValue(LOG_KEY_POWER, power))
+  {
+    powerManager.configure(power);
   }
+
+  WallClock::Zone zone;
+  if (stateStore.readValue(LOG_KEY_TIMEZONE, zone))
+  {
+    zone.tz[sizeof(zone.tz) - 1] = '\0';
+    wallClock.setTimezone(zone.tz);
+  }
+
+  MqttConfig mqtt;
+  if (stateStore.readValue(LOG_KEY_MQTT, mqtt))
+  {
+    mqttSink.requestConfig(mqtt);   // picked up by the MQTT task's first pass
+  }
+
+  // Newer than any flash checkpoint after a deep sleep or soft reset
+  if (restoreRtcSnapshot())
+  {
+    debugln("Restored flow, rollup and detector state from RTC memory");
+  }
+  debugln("Restored state, recovery took " + String(stateStore.getStats().recoveryUs) + " us");
 }
 
-void checkmonthlyFlow()
+void saveSettings()
 {
-  if (flowusage.currentMonth != flowusage.previousMonth)
-  {
-    // Calculate this month's flow
-    flowusage.flowThisMonth = cumulativeFlow - flowusage.flowLastMonth;
-    Blynk.virtualWrite(V8, flowusage.flowThisMonth);
+  PersistedSettings_t settings = {flowThreshold, disableShutoff};
+  stateStore.writeValue(LOG_KEY_SETTINGS, settings);
+}
+
+void saveBurstState()
+{
+  BurstDetection_t burst = burstData;
+  burst.consecutiveHighFlowCount = 0; // transient, keep it out of the record
+  stateStore.writeValue(LOG_KEY_BURST, burst);
+}
 
-    // Store the cumulative flow for the next month's comparison
-    flowusage.flowLastMonth = cumulativeFlow;
-    flowusage.previousMonth = flowusage.currentMonth;
+void saveTotaliserState()
+{
+  stateStore.writeValue(LOG_KEY_TOTAL, totaliser.persisted());
+}
+
+void saveNightFlowState()
+{
+  stateStore.writeValue(LOG_KEY_NIGHTFLOW, nightFlow.persisted());
+}
+
+/* Mirrors the flow state to RTC memory; cheap enough for every sample */
+void saveRtcSnapshot()
+{
+  rtcSnapshot.magic = RTC_SNAPSHOT_MAGIC;
+  rtcSnapshot.size = sizeof(RtcSnapshot_t);
+  rtcSnapshot.total = totaliser.persisted();
+  rtcSnapshot.night = nightFlow.persisted();
+  rtcSnapshot.usage = flowRollup.persisted();
+  filterMonitor.snapshot(rtcSnapshot.detector);
+  rtcSnapshot.crc = esp_rom_crc32_le(0, (const uint8_t *)&rtcSnapshot.reserved,
+                                     sizeof(RtcSnapshot_t) - offsetof(RtcSnapshot_t, reserved));
+}
 
-    // Debugging
-    debugln("Monthly Flow: " + String(flowusage.flowThisMonth));
-    debugln("Cumulative Flow: " + String(cumulativeFlow));
-    debugln("Last Month's Flow: " + String(flowusage.flowLastMonth));
+/* Restores the RTC mirror if it survived (deep sleep, soft reset) intact */
+bool restoreRtcSnapshot()
+{
+  if (esp_reset_reason() == ESP_RST_POWERON || rtcSnapshot.magic != RTC_SNAPSHOT_MAGIC ||
+      rtcSnapshot.size != sizeof(RtcSnapshot_t) ||
+      rtcSnapshot.crc != esp_rom_crc32_le(0, (const uint8_t *)&rtcSnapshot.reserved,
+                                          sizeof(RtcSnapshot_t) - offsetof(RtcSnapshot_t, reserved)))
+  {
+    return false;
   }
+  totaliser.restore(rtcSnapshot.total);
+  nightFlow.restore(rtcSnapshot.night);
+  flowRollup.restore(rtcSnapshot.usage);
+  filterMonitor.restore(rtcSnapshot.detector);
+  return true;
 }
 
-void checkhourlyFlow()
+/* Checkpoints rollup baselines and detector histories at bucket boundaries */
+void saveUsageState()
 {
-  if (flowusage.currentHour != flowusage.previousHour)
+  static AdvancedBlockageDetector::Snapshot detector;
+  saveTotaliserState();
+  stateStore.writeValue(LOG_KEY_USAGE, flowRollup.persisted());
+  filterMonitor.snapshot(detector);
+  stateStore.writeValue(LOG_KEY_DETECTOR, detector);
+  isUsageDirty = false;
+}
+void sendESPdata()
+{
+}
+
+/**
+ * Feeds the meter reading into the rollups and publishes every hour, day
+ * and month that closed. Checkpoints once per hour rather than per minute.
+ */
+void updateRollups()
+{
+  AllocScope scope(ALLOC_USAGE);
+  uint8_t closed = flowRollup.update(sampleLocalS, totaliser.litres());
+  if (closed & (1 << ROLLUP_HOUR))
+  {
+    postPin(V10, flowRollup.last(ROLLUP_HOUR));
+    isUsageDirty = true;
+    debugln("Hourly Flow: " + String(flowRollup.last(ROLLUP_HOUR)));
+  }
+  if (closed & (1 << ROLLUP_DAY))
   {
-    // Calculate this hour's flow
-    flowusage.flowThisHour = cumulativeFlow - flowusage.flowPreviousHour;
-    Blynk.virtualWrite(V10, flowusage.flowThisHour);
+    flowEvents.resetTotals(); // end-use totals are per day
+    postPin(V7, flowRollup.last(ROLLUP_DAY));
+    debugln("Daily Flow: " + String(flowRollup.last(ROLLUP_DAY)));
+  }
+  if (closed & (1 << ROLLUP_MONTH))
+  {
+    postPin(V8, flowRollup.last(ROLLUP_MONTH));
+    debugln("Monthly Flow: " + String(flowRollup.last(ROLLUP_MONTH)));
+  }
+}
 
-    // Store the cumulative flow for the next hour's comparison
-    flowusage.flowPreviousHour = cumulativeFlow;
-    flowusage.previousHour = flowusage.currentHour;
+/**
+ * Segments flow into events and publishes one classified summary per event
+ * on V21 instead of the raw samples behind it.
+ */
+void trackFlowEvents(uint32_t now)
+{
+  AllocScope scope(ALLOC_USAGE);
+  if (!isFlowAvailable)
+  {
+    return;
+  }
+  if (!flowEvents.update(blynk_data.flowrate, totaliser.litres(), now, sampleLocalS))
+  {
+    return;
+  }
+  const FlowEvent &e = flowEvents.last();
+  char summary[64];
+  snprintf(summary, sizeof(summary), "%s %.1f L, %u:%02u, peak %.1f L/min", END_USE_NAMES[e.use],
+           e.volumeL, (unsigned)(e.durationS / 60), (unsigned)(e.durationS % 60), e.peakLpm);
+  debugln(String("Flow event: ") + summary);
+  postText(V21, summary);
+}
 
-    // Debugging
-    debugln("Hourly Flow: " + String(flowusage.flowThisHour));
-    debugln("Cumulative Flow: " + String(cumulativeFlow));
-    debugln("Previous Hour's Flow: " + String(flowusage.flowPreviousHour));
+/* Evaluates the quiet-hours baseline once per night and reports slow leaks */
+void checkNightFlow()
+{
+  AllocScope scope(ALLOC_USAGE);
+  NightFlowMonitor::Verdict verdict = nightFlow.update(sampleLocalS, totaliser.litres(), blynk_data.flowrate);
+  if (verdict == NightFlowMonitor::NIGHT_NONE)
+  {
+    return;
+  }
+  debugln("Night baseline: " + String(nightFlow.lastBaselineLph(), 2) + " L/h, streak " + String(nightFlow.streak()));
+  if (verdict == NightFlowMonitor::NIGHT_LEAK)
+  {
+    String message = "Night baseline " + String(nightFlow.lastBaselineLph(), 1) + " L/h for " +
+                     String(nightFlow.streak()) + " nights, ~" + String(nightFlow.litresPerDay(), 0) + " L/day lost";
+    postEvent("slow_leak", message);
+  }
+  else if (verdict == NightFlowMonitor::NIGHT_CLEARED)
+  {
+    postResolve("slow_leak");
   }
+  saveNightFlowState();
 }
 
 void initFlowThreshold()
@@ -282,21 +1555,49 @@ void initFlowThreshold()
   }
 }
 
-void checkBurst()
+/* Latches the leak lockout, alerts and (unless overridden) closes the valve */
+void lockoutForLeak(const String &alertMsg)
 {
-  static bool initialSettingsReceived = false;
+  burstData.leakConfirmed = true;
+  burstData.burstDetection = true;
+  burstData.valveLockedDueToLeak = true;
+
+  debugln("Leak confirmed! " + alertMsg);
+  postEvent("leak_detected", alertMsg);
+  saveBurstState();
 
-  // Wait for initial settings from Blynk
-  if (!initialSettingsReceived)
+  if (disableShutoff == 0)
+  {
+    postPin(V5, 1);
+    valveOff();
+    debugln("Valve closed due to leak detection");
+  }
+}
+
+/* Volume/duration limits on one uninterrupted flow event */
+void checkContinuousFlow(uint32_t now)
+{
+  AllocScope scope(ALLOC_SAFETY);
+  if (!isFlowAvailable)
+  {
+    return;
+  }
+  ContinuousFlowGuard::Verdict verdict = flowGuard.update(blynk_data.flowrate, totaliser.litres(), now);
+  if (verdict == ContinuousFlowGuard::CONT_FLOW_OK || burstData.leakConfirmed)
   {
-    if (Blynk.connected())
-    {
-      Blynk.syncVirtual(V12); // Sync disable shutoff setting
-      initialSettingsReceived = true;
-    }
     return;
   }
+  const ContinuousFlowGuard::Limits &limits = flowGuard.getLimits();
+  String alertMsg = "Continuous flow for " + String(flowGuard.durationMs(now) / 60000) + " min, " +
+                    String(flowGuard.volume(totaliser.litres()), 0) + " L (limit " +
+                    (verdict == ContinuousFlowGuard::CONT_FLOW_DURATION ? String(limits.maxMinutes) + " min)"
+                                                                         : String(limits.maxLitres, 0) + " L)");
+  lockoutForLeak(alertMsg);
+}
 
+void checkBurst()
+{
+  AllocScope scope(ALLOC_SAFETY);
   if (!isFlowAvailable || flowThreshold <= 0)
   {
     return;
@@ -314,20 +1615,7 @@ void checkBurst()
 
     if (burstData.consecutiveHighFlowCount >= burstData.requiredCount && !burstData.leakConfirmed)
     {
-      burstData.leakConfirmed = true;
-      burstData.burstDetection = true;
-      burstData.valveLockedDueToLeak = true;
-
-      String alertMsg = "Flow rate (" + String(blynk_data.flowrate) + ") exceeded threshold (" + String(flowThreshold) + ")";
-      debugln("Leak confirmed! " + alertMsg);
-      Blynk.logEvent("leak_detected", alertMsg);
-
-      if (disableShutoff == 0)
-      {
-        Blynk.virtualWrite(V5, 1);
-        valveOff();
-        debugln("Valve closed due to leak detection");
-      }
+      lockoutForLeak("Flow rate (" + String(blynk_data.flowrate) + ") exceeded threshold (" + String(flowThreshold) + ")");
     }
   }
   else
@@ -3,20 +3,40 @@
 #include <Arduino.h>
 #include "debug.h"
 #include <esp_sleep.h>
+#include <esp_rom_crc.h>
+#include <mbedtls/base64.h>
 #include <WiFiClient.h>
 #include "BlynkEdgent.h"
-#include <ESP32Time.h>
-#include <NTPClient.h>
 #include "FlowSensor.h"
+#include "LogStore.h"
 #include "Servo.h"
 #include "PressureSensor.h"
 #include "UV.h"
 #include "AdvancedBlockageDetector.h"
+#include "UVDoseLedger.h"
+#include "UVLampMonitor.h"
+#include "Pipeline.h"
+#include "TelemetryPublisher.h"
+#include "TelemetryBuffer.h"
+#include "FlowRollup.h"
+#include "FlowTotaliser.h"
+#include "NightFlowMonitor.h"
+#include "ContinuousFlowGuard.h"
+#include "FlowEvents.h"
+#include "StageProfiler.h"
+#include "HeapTracker.h"
+#include "PowerManager.h"
+#include "WallClock.h"
+#include "OutageProbe.h"
+#include "LanStream.h"
+#include "TelemetrySink.h"
+#include "MqttSink.h"
 
 //system defines
 #define uS_TO_S_FACTOR 1000000 /* Conversion factor for micro seconds to seconds */
 #define TIME_TO_SLEEP 20       /* Time ESP32 will go to sleep (in seconds) */
 #define UPDATE_FREQ 600000
+#define LEGACY_EEPROM_SIZE 512 /* EEPROM.begin() size of the pre-log firmware */
 //Blynk defines
 #define BLYNK_TEMPLATE_ID "TMPL64xy5PU3f"
 #define BLYNK_TEMPLATE_NAME "Hydroguard"
@@ -25,10 +45,6 @@
 
 #define APP_DEBUG
 
-//Objects
-WiFiUDP Udp;
-NTPClient timeClient(Udp);
-ESP32Time rtc;
 //Structs
 typedef struct
 {
@@ -41,22 +57,6 @@ typedef struct
     uint8_t userUpdate;
 }pload_t;
 
-typedef struct
-{
-    uint8_t today;          // Current day
-    uint8_t yesterday;      // Previous day
-    double todaysFlow;      // Flow recorded today
-    double yesterdaysFlow;  // Flow recorded yesterday
-    uint8_t currentMonth;   // Current month
-    uint8_t previousMonth;  // Last month
-    double flowThisMonth;   // Flow recorded this month
-    double flowLastMonth;   // Flow recorded last month
-    uint8_t currentHour;
-    uint8_t previousHour;
-    double flowThisHour;
-    double flowPreviousHour;
-}FlowUsage_t;
-
 typedef struct {
     uint8_t consecutiveHighFlowCount;  // Number of consecutive readings above threshold
     uint8_t requiredCount;             // Number of readings required to confirm a leak
@@ -65,29 +65,98 @@ typedef struct {
     bool valveLockedDueToLeak;
 } BurstDetection_t;
 
+typedef struct {
+    float flowThreshold;
+    uint8_t disableShutoff;
+} PersistedSettings_t;
+
+/* Flow, rollup and detector state mirrored to RTC memory after every sample */
+typedef struct {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t crc;                               // over everything after this field
+    uint8_t reserved[4];
+    FlowTotaliser::Persisted total;
+    NightFlowMonitor::Persisted night;
+    FlowRollup::Persisted usage;
+    AdvancedBlockageDetector::Snapshot detector;
+} RtcSnapshot_t;
+
+#define RTC_SNAPSHOT_MAGIC 0x48475253  /* "HGRS" */
+RTC_NOINIT_ATTR RtcSnapshot_t rtcSnapshot;
+
+/* Boot milestones, µs since the app started */
+typedef struct
+{
+    int64_t safeUs;     // valve driven and protection state restored
+    int64_t cloudUs;    // first cloud connection, 0 until then
+} BootTiming_t;
+static BootTiming_t bootTiming;
 
 // Function Prototypes
 void displayFlow();
 void sendESPdata();
 float flowToFloat(byte b1, byte b2, byte b3, byte b4);
 void checkBurst();
-void checkmonthlyFlow();
-void checkdailyFlow();
-void checkhourlyFlow();
+void checkContinuousFlow(uint32_t now);
+void lockoutForLeak(const String &alertMsg);
+void updateRollups();
+void checkNightFlow();
+void trackFlowEvents(uint32_t now);
 void processData();
-void sendDatatoBlynk();
-void setupTime();
+void checkShutoff();
+void sendDatatoBlynk(const Report_t &report);
+void initTelemetry();
+void backfillTelemetry();
+void publishPerf();
+void sampleHeap();
+bool blynkWritePin(uint8_t pin, double value);
+void blynkGroup(bool open, uint64_t epochMs);
+void startPipeline();
+void acquisitionTask(void *);
+void safetyTask(void *);
+void cloudTask(void *);
+void lanTask(void *);
+void mqttTask(void *);
+void tracePressure(TickType_t until);
+void processSample(const Sample_t &sample);
+void applyControl(const Control_t &control);
+void dispatchEvent(const CloudEvent_t &event);
 void initFlowThreshold();
+void accountUVDose(uint32_t now);
+void applySamplePeriod();
+void initConsoleCommands();
+void migrateLegacyValveState();
+void reportMissingPartitions();
+void restoreState();
+void saveSettings();
+void saveBurstState();
+void saveUsageState();
+void saveTotaliserState();
+void saveNightFlowState();
+void saveRtcSnapshot();
+bool restoreRtcSnapshot();
+bool pipelineQuiet(uint32_t pushed);
+void idleUntil(int64_t deadlineUs, uint32_t pushed);
+bool edgentNeedsRadio();
+void radioOff();
+void publishEnergy();
+void reportBootTiming();
 byte readflowCommand[] = {0x10, 0x5B, 0xFD, 0x58, 0x16};
 byte rstCFlowCommand[] = {0x10, 0x5A, 0xFD, 0x57, 0x16};
 
 //extern
 extern AdvancedBlockageDetector filterMonitor;
+FlowRollup flowRollup;
+FlowTotaliser totaliser;
+NightFlowMonitor nightFlow;
+ContinuousFlowGuard flowGuard;
+FlowEventSegmenter flowEvents;
+TelemetryPublisher<12> telemetry;
 
 // Global Variables
 uint32_t tempTime = millis();
 uint32_t flowTime = 0;
-uint32_t reportTime = 0; // Track the last report time
 uint32_t blereportTime = millis();
 
 byte data[32];
@@ -96,18 +165,19 @@ byte (*pData)[32] = &data; // Pointer to the array
 static float flowrate;
 static float flowThreshold = 25.0;
 static double cumulativeFlow;
-static uint16_t pressureCH1 = 0;
-static uint16_t pressureCH2 = 0;
+static float pressureCH1 = 0;   // kPa, latest sample
+static float pressureCH2 = 0;   // kPa, latest sample
+static float blockagePercentage = 0;
 static uint16_t UVVoltage = 0;
 static String UVLampOn;
-static float lastReportedFlowrate = 0.0; // Track the last reported flow rate
 static double cFlowThreshold;
 static bool isThresholdSet = false;
 static bool isFlowAvailable = false;
-static bool isTimeSet = false;
+static uint32_t sampleLocalS = 0;            // local-time epoch s of the current sample, 0 while the clock is unset
+static volatile bool resetTotalRequested = false;
+static bool isUsageDirty = false;
 static uint8_t disableShutoff;
 static pload_t blynk_data;
-static FlowUsage_t flowusage;
 static BurstDetection_t burstDetection;
 BurstDetection_t burstData = {
     0,      // consecutiveHighFlowCount
@@ -116,4 +186,6 @@ BurstDetection_t burstData = {
     false,  // burstDetection
     false   // valveLockedDueToLeak
 };
-AdvancedBlockageDetector filterMonitor;
\ No newline at end of file
+AdvancedBlockageDetector filterMonitor;
+UVDoseLedger uvLedger;
+UVLampMonitor uvLamp;
\ No newline at end of file
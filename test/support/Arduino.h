@@ -0,0 +1,123 @@
+#ifndef TEST_ARDUINO_H
+#define TEST_ARDUINO_H
+
+/*
+ * Host stand-in for the Arduino core, enough for the header-only modules
+ * under test. Time is the host's monotonic clock, which a test can skip
+ * forward; critical sections are plain mutexes. GPIO writes are recorded
+ * per pin and Serial output is discarded.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+
+/* Added to the host clock, so timeouts can be reached without waiting */
+inline uint64_t &hostSkewMicros()
+{
+    static uint64_t skew = 0;
+    return skew;
+}
+
+inline void hostAdvance(uint32_t ms) { hostSkewMicros() += (uint64_t)ms * 1000; }
+
+inline uint64_t hostMicros()
+{
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count() +
+           hostSkewMicros();
+}
+
+inline uint32_t millis() { return (uint32_t)(hostMicros() / 1000); }
+inline uint32_t micros() { return (uint32_t)hostMicros(); }
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline uint32_t esp_random() { return (uint32_t)rand(); }
+
+typedef enum { ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_SW, ESP_RST_BROWNOUT } esp_reset_reason_t;
+
+/* Every host run is a cold boot */
+inline esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+
+#define LOW           0
+#define HIGH          1
+#define INPUT         0x01
+#define OUTPUT        0x03
+#define INPUT_PULLUP  0x05
+#define ANALOG        0xC0
+#define FALLING       0x02
+
+constexpr uint8_t HOST_PINS = 64;
+
+/* Last level written to each pin, -1 until the pin is first written */
+inline int *hostPinLevels()
+{
+    static int levels[HOST_PINS];
+    static bool init = false;
+    if (!init) {
+        std::fill(levels, levels + HOST_PINS, -1);
+        init = true;
+    }
+    return levels;
+}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t level) { hostPinLevels()[pin % HOST_PINS] = level; }
+inline int digitalRead(uint8_t pin) { return hostPinLevels()[pin % HOST_PINS] > 0 ? HIGH : LOW; }
+inline uint16_t analogRead(uint8_t) { return 0; }
+inline void attachInterrupt(uint8_t, void (*)(), int) {}
+
+template <typename T>
+T constrain(T v, T lo, T hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+class String
+{
+public:
+    String() {}
+    String(const char *s) : str(s ? s : "") {}
+    String(const std::string &s) : str(s) {}
+    const char *c_str() const { return str.c_str(); }
+    size_t length() const { return str.size(); }
+    String operator+(const String &o) const { return String(str + o.str); }
+
+private:
+    std::string str;
+};
+
+struct HostSerial
+{
+    template <typename T> void print(const T &) const {}
+    template <typename T> void println(const T &) const {}
+    void println() const {}
+};
+
+const HostSerial Serial = {};
+
+/* FreeRTOS spinlock → mutex; portENTER_CRITICAL only ever guards short copies */
+typedef std::mutex portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->lock()
+#define portEXIT_CRITICAL(mux)  (mux)->unlock()
+
+#endif // TEST_ARDUINO_H
@@ -0,0 +1,65 @@
+#ifndef TEST_PREFERENCES_H
+#define TEST_PREFERENCES_H
+
+/*
+ * In-memory NVS: namespaces of byte blobs shared by every Preferences
+ * instance, like the real partition. A read-only begin() fails for a
+ * namespace that was never written, as on the device.
+ */
+#include <map>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+typedef std::map<std::string, std::vector<uint8_t>> HostNvsNamespace;
+
+inline std::map<std::string, HostNvsNamespace> &hostNvs()
+{
+    static std::map<std::string, HostNvsNamespace> nvs;
+    return nvs;
+}
+
+class Preferences
+{
+public:
+    bool begin(const char *name, bool readOnly = false, const char * = nullptr)
+    {
+        if (readOnly && !hostNvs().count(name)) {
+            return false;
+        }
+        ns = &hostNvs()[name];
+        return true;
+    }
+
+    void end() { ns = nullptr; }
+
+    bool isKey(const char *key) { return ns && ns->count(key); }
+
+    size_t putBytes(const char *key, const void *value, size_t len)
+    {
+        if (!ns) {
+            return 0;
+        }
+        const uint8_t *p = (const uint8_t *)value;
+        (*ns)[key].assign(p, p + len);
+        return len;
+    }
+
+    size_t getBytesLength(const char *key) { return isKey(key) ? (*ns)[key].size() : 0; }
+
+    /* Like the device: 0 if the blob does not fit */
+    size_t getBytes(const char *key, void *buf, size_t maxLen)
+    {
+        size_t len = getBytesLength(key);
+        if (!len || len > maxLen) {
+            return 0;
+        }
+        memcpy(buf, (*ns)[key].data(), len);
+        return len;
+    }
+
+private:
+    HostNvsNamespace *ns = nullptr;
+};
+
+#endif // TEST_PREFERENCES_H
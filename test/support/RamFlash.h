@@ -0,0 +1,71 @@
+#ifndef TEST_RAM_FLASH_H
+#define TEST_RAM_FLASH_H
+
+#include <vector>
+#include "LogStore.h"
+
+/**
+ * RAM-backed LogFlash with NOR semantics: erase sets a sector to 0xFF and
+ * programming can only clear bits. A write budget simulates power loss
+ * mid-write: once it runs out the write is torn and every later write
+ * and erase fails until the budget is lifted.
+ */
+class RamFlash : public LogFlash
+{
+public:
+    explicit RamFlash(uint32_t sectors) : mem(sectors * LOG_SECTOR_SIZE, 0xFF) {}
+
+    uint32_t size() const override { return (uint32_t)mem.size(); }
+
+    bool read(uint32_t addr, void *dst, size_t len) override
+    {
+        if (addr + len > mem.size()) {
+            return false;
+        }
+        memcpy(dst, &mem[addr], len);
+        reads += len;
+        return true;
+    }
+
+    bool write(uint32_t addr, const void *src, size_t len) override
+    {
+        if (addr + len > mem.size()) {
+            return false;
+        }
+        const uint8_t *p = (const uint8_t *)src;
+        for (size_t i = 0; i < len; i++) {
+            if (budget == 0) {
+                return false;
+            }
+            if (budget > 0) {
+                budget--;
+            }
+            mem[addr + i] &= p[i];
+            written++;
+        }
+        return true;
+    }
+
+    bool eraseSector(uint32_t addr) override
+    {
+        if (budget == 0 || addr % LOG_SECTOR_SIZE || addr >= mem.size()) {
+            return false;
+        }
+        memset(&mem[addr], 0xFF, LOG_SECTOR_SIZE);
+        erases++;
+        return true;
+    }
+
+    /* Bytes that may still be programmed, -1 = unlimited */
+    void setBudget(long bytes) { budget = bytes; }
+
+    uint64_t reads = 0;
+    uint64_t written = 0;
+    uint32_t erases = 0;
+
+private:
+    std::vector<uint8_t> mem;
+    long                 budget = -1;
+};
+
+#endif // TEST_RAM_FLASH_H
@@ -0,0 +1,166 @@
+#ifndef TEST_WIFI_H
+#define TEST_WIFI_H
+
+/*
+ * Host stand-in for the Wi-Fi library: WiFiClient and WiFiServer are plain
+ * TCP sockets on the loopback interface, so LanStream and MqttSink can be
+ * driven by test clients and brokers in the same process.
+ */
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <memory>
+
+constexpr int TEST_LWIP_SND_BUF = 5744;   // lwIP TCP_SND_BUF: slow readers back up as soon as on the device
+
+class WiFiClient
+{
+public:
+    WiFiClient() {}
+
+    explicit WiFiClient(int fd) : socket(std::make_shared<Socket>(fd)) {}
+
+    bool connect(const char *host, uint16_t port, int32_t timeoutMs)
+    {
+        stop();
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+            return false;
+        }
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        timeval tv = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+            ::close(fd);
+            return false;
+        }
+        socket = std::make_shared<Socket>(fd);
+        return true;
+    }
+
+    void setNoDelay(bool on)
+    {
+        int v = on;
+        setsockopt(fd(), IPPROTO_TCP, TCP_NODELAY, &v, sizeof(v));
+    }
+
+    /* Blocking, like the Arduino client: returns less than len only on error */
+    size_t write(const uint8_t *buf, size_t len)
+    {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::send(fd(), buf + done, len - done, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            done += n;
+        }
+        return done;
+    }
+
+    int available()
+    {
+        uint8_t peek[256];
+        ssize_t n = ::recv(fd(), peek, sizeof(peek), MSG_PEEK | MSG_DONTWAIT);
+        return n > 0 ? (int)n : 0;
+    }
+
+    int read(uint8_t *buf, size_t len) { return (int)::recv(fd(), buf, len, MSG_DONTWAIT); }
+
+    uint8_t connected()
+    {
+        uint8_t peek;
+        ssize_t n = ::recv(fd(), &peek, 1, MSG_PEEK | MSG_DONTWAIT);
+        return fd() >= 0 && (n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)));
+    }
+
+    void stop() { socket.reset(); }
+
+    uint32_t remoteIP() const
+    {
+        sockaddr_in addr = {};
+        socklen_t len = sizeof(addr);
+        getpeername(fd(), (sockaddr *)&addr, &len);
+        return addr.sin_addr.s_addr;
+    }
+
+    int fd() const { return socket ? socket->fd : -1; }
+
+    explicit operator bool() const { return (bool)socket; }
+
+private:
+    /* Copies share the connection, as on the device; the last one closes it */
+    struct Socket
+    {
+        int fd;
+        explicit Socket(int f) : fd(f) {}
+        ~Socket() { ::close(fd); }
+    };
+
+    std::shared_ptr<Socket> socket;
+};
+
+class WiFiServer
+{
+public:
+    ~WiFiServer()
+    {
+        if (listener >= 0) {
+            ::close(listener);
+        }
+    }
+
+    void begin(uint16_t port)
+    {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listener, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 4) < 0) {
+            perror("WiFiServer::begin");
+        }
+        fcntl(listener, F_SETFL, O_NONBLOCK);
+    }
+
+    void setNoDelay(bool on) { noDelay = on; }
+
+    WiFiClient available()
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            return WiFiClient();
+        }
+        int v = noDelay;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &v, sizeof(v));
+        v = TEST_LWIP_SND_BUF;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &v, sizeof(v));
+        return WiFiClient(fd);
+    }
+
+private:
+    int  listener = -1;
+    bool noDelay = false;
+};
+
+struct TestWiFi
+{
+    void macAddress(uint8_t *mac)
+    {
+        static const uint8_t addr[6] = {0x24, 0x6F, 0x28, 0x01, 0x02, 0x03};
+        memcpy(mac, addr, sizeof(addr));
+    }
+};
+
+TestWiFi WiFi;
+
+#endif // TEST_WIFI_H
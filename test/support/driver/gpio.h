@@ -0,0 +1,31 @@
+#ifndef TEST_DRIVER_GPIO_H
+#define TEST_DRIVER_GPIO_H
+
+/* Interrupt and hold configuration is accepted and ignored; levels come from Arduino.h */
+#include <Arduino.h>
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+
+typedef enum
+{
+    GPIO_INTR_DISABLE,
+    GPIO_INTR_POSEDGE,
+    GPIO_INTR_NEGEDGE,
+    GPIO_INTR_ANYEDGE,
+    GPIO_INTR_LOW_LEVEL,
+    GPIO_INTR_HIGH_LEVEL
+} gpio_int_type_t;
+
+inline int gpio_get_level(gpio_num_t pin) { return digitalRead(pin); }
+inline esp_err_t gpio_set_intr_type(gpio_num_t, gpio_int_type_t) { return ESP_OK; }
+inline esp_err_t gpio_intr_enable(gpio_num_t) { return ESP_OK; }
+inline esp_err_t gpio_intr_disable(gpio_num_t) { return ESP_OK; }
+inline esp_err_t gpio_wakeup_enable(gpio_num_t, gpio_int_type_t) { return ESP_OK; }
+inline esp_err_t gpio_wakeup_disable(gpio_num_t) { return ESP_OK; }
+inline esp_err_t gpio_hold_en(gpio_num_t) { return ESP_OK; }
+inline esp_err_t gpio_hold_dis(gpio_num_t) { return ESP_OK; }
+inline void gpio_deep_sleep_hold_en() {}
+inline void gpio_deep_sleep_hold_dis() {}
+
+#endif // TEST_DRIVER_GPIO_H
@@ -0,0 +1,12 @@
+#ifndef TEST_DRIVER_RTC_IO_H
+#define TEST_DRIVER_RTC_IO_H
+
+#include "driver/gpio.h"
+
+/* Same RTC-capable range as the ESP32-S3 */
+inline bool rtc_gpio_is_valid_gpio(gpio_num_t pin) { return pin >= 0 && pin <= 21; }
+inline esp_err_t rtc_gpio_deinit(gpio_num_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_pullup_en(gpio_num_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_pulldown_dis(gpio_num_t) { return ESP_OK; }
+
+#endif // TEST_DRIVER_RTC_IO_H
@@ -0,0 +1,8 @@
+#ifndef TEST_ESP_ATTR_H
+#define TEST_ESP_ATTR_H
+
+/* No RTC memory on the host: retained state is an ordinary global */
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+
+#endif // TEST_ESP_ATTR_H
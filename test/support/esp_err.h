@@ -0,0 +1,8 @@
+#ifndef TEST_ESP_ERR_H
+#define TEST_ESP_ERR_H
+
+typedef int esp_err_t;
+#define ESP_OK   0
+#define ESP_FAIL -1
+
+#endif // TEST_ESP_ERR_H
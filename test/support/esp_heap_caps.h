@@ -0,0 +1,13 @@
+#ifndef TEST_ESP_HEAP_CAPS_H
+#define TEST_ESP_HEAP_CAPS_H
+
+/* No heap introspection on the host: everything reads as empty */
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+inline size_t heap_caps_get_free_size(uint32_t) { return 0; }
+inline size_t heap_caps_get_largest_free_block(uint32_t) { return 0; }
+
+#endif // TEST_ESP_HEAP_CAPS_H
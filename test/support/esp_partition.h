@@ -0,0 +1,26 @@
+#ifndef TEST_ESP_PARTITION_H
+#define TEST_ESP_PARTITION_H
+
+/* No partitions on the host: PartitionFlash never finds one, tests use RamFlash */
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { ESP_PARTITION_TYPE_DATA = 1 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct
+{
+    uint32_t    size;
+    const char *label;
+} esp_partition_t;
+
+inline const esp_partition_t *esp_partition_find_first(esp_partition_type_t, esp_partition_subtype_t, const char *)
+{
+    return nullptr;
+}
+inline esp_err_t esp_partition_read(const esp_partition_t *, size_t, void *, size_t) { return ESP_FAIL; }
+inline esp_err_t esp_partition_write(const esp_partition_t *, size_t, const void *, size_t) { return ESP_FAIL; }
+inline esp_err_t esp_partition_erase_range(const esp_partition_t *, size_t, size_t) { return ESP_FAIL; }
+
+#endif // TEST_ESP_PARTITION_H
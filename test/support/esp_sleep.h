@@ -0,0 +1,66 @@
+#ifndef TEST_ESP_SLEEP_H
+#define TEST_ESP_SLEEP_H
+
+/*
+ * Light sleep skips the host clock forward by the armed timer and reports
+ * a timer wake. Deep sleep would restart the firmware, so on the host it
+ * ends the process.
+ */
+#include <Arduino.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+typedef enum
+{
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER,
+    ESP_SLEEP_WAKEUP_TOUCHPAD,
+    ESP_SLEEP_WAKEUP_ULP,
+    ESP_SLEEP_WAKEUP_GPIO
+} esp_sleep_wakeup_cause_t;
+
+typedef esp_sleep_wakeup_cause_t esp_sleep_source_t;
+
+typedef enum { ESP_PD_DOMAIN_RTC_PERIPH } esp_sleep_pd_domain_t;
+typedef enum { ESP_PD_OPTION_OFF, ESP_PD_OPTION_ON, ESP_PD_OPTION_AUTO } esp_sleep_pd_option_t;
+typedef enum { ESP_EXT1_WAKEUP_ALL_LOW, ESP_EXT1_WAKEUP_ANY_HIGH } esp_sleep_ext1_wakeup_mode_t;
+
+struct HostSleep
+{
+    uint64_t timerUs;
+    esp_sleep_wakeup_cause_t cause;
+};
+
+inline HostSleep &hostSleep()
+{
+    static HostSleep s = {0, ESP_SLEEP_WAKEUP_UNDEFINED};
+    return s;
+}
+
+inline esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us)
+{
+    hostSleep().timerUs = us;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_light_sleep_start()
+{
+    hostSkewMicros() += hostSleep().timerUs;
+    hostSleep().cause = ESP_SLEEP_WAKEUP_TIMER;
+    return ESP_OK;
+}
+
+inline void esp_deep_sleep_start() { exit(0); }
+
+inline esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return hostSleep().cause; }
+inline esp_err_t esp_sleep_enable_gpio_wakeup() { return ESP_OK; }
+inline esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t, int) { return ESP_OK; }
+inline esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t, esp_sleep_ext1_wakeup_mode_t) { return ESP_OK; }
+inline esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t) { return ESP_OK; }
+inline esp_err_t esp_sleep_pd_config(esp_sleep_pd_domain_t, esp_sleep_pd_option_t) { return ESP_OK; }
+inline uint64_t esp_sleep_get_ext1_wakeup_status() { return 0; }
+
+#endif // TEST_ESP_SLEEP_H
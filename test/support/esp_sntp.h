@@ -0,0 +1,39 @@
+#ifndef TEST_ESP_SNTP_H
+#define TEST_ESP_SNTP_H
+
+/*
+ * No network time on the host: the host's own clock is taken as correct
+ * UTC, and a test delivers a sync with hostSntpSync(). Skipping the host
+ * monotonic clock forward with hostAdvance() stands in for an oscillator
+ * that has drifted ahead of UTC.
+ */
+#include <Arduino.h>
+#include <sys/time.h>
+
+#define SNTP_OPMODE_POLL 0
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+inline sntp_sync_time_cb_t &hostSntpCallback()
+{
+    static sntp_sync_time_cb_t cb = nullptr;
+    return cb;
+}
+
+inline void sntp_setoperatingmode(uint8_t) {}
+inline void sntp_setservername(uint8_t, const char *) {}
+inline void sntp_set_sync_interval(uint32_t) {}
+inline void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t cb) { hostSntpCallback() = cb; }
+inline void sntp_init() {}
+
+/* What lwIP does once a server answers */
+inline void hostSntpSync()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (hostSntpCallback()) {
+        hostSntpCallback()(&tv);
+    }
+}
+
+#endif // TEST_ESP_SNTP_H
@@ -0,0 +1,8 @@
+#ifndef TEST_ESP_TIMER_H
+#define TEST_ESP_TIMER_H
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() { return (int64_t)hostMicros(); }
+
+#endif // TEST_ESP_TIMER_H
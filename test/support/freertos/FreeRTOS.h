@@ -0,0 +1,18 @@
+#ifndef TEST_FREERTOS_H
+#define TEST_FREERTOS_H
+
+#include <Arduino.h>
+
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE             1
+#define pdFALSE            0
+#define portMAX_DELAY      0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+
+inline BaseType_t xPortInIsrContext() { return pdFALSE; }
+
+#endif // TEST_FREERTOS_H
@@ -0,0 +1,35 @@
+#ifndef TEST_FREERTOS_SEMPHR_H
+#define TEST_FREERTOS_SEMPHR_H
+
+#include <new>
+#include "freertos/FreeRTOS.h"
+
+/* Mutex semaphores only, backed by std::timed_mutex */
+typedef std::timed_mutex *SemaphoreHandle_t;
+
+typedef struct
+{
+    alignas(std::timed_mutex) uint8_t storage[sizeof(std::timed_mutex)];
+} StaticSemaphore_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    return new (buffer->storage) std::timed_mutex();
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) {
+        m->lock();
+        return pdTRUE;
+    }
+    return m->try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t m)
+{
+    m->unlock();
+    return pdTRUE;
+}
+
+#endif // TEST_FREERTOS_SEMPHR_H
@@ -0,0 +1,24 @@
+#ifndef TEST_FREERTOS_TASK_H
+#define TEST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+/* Tasks are host threads that poll; notifications are not delivered */
+typedef void *TaskHandle_t;
+
+/* Each host thread gets its own handle */
+inline TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    static thread_local char self;
+    return &self;
+}
+
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+inline void xTaskNotifyGive(TaskHandle_t) {}
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(ticks == portMAX_DELAY ? 1000 : ticks * 1000));
+    return 0;
+}
+
+#endif // TEST_FREERTOS_TASK_H
@@ -0,0 +1,8 @@
+#ifndef TEST_LWIP_SOCKETS_H
+#define TEST_LWIP_SOCKETS_H
+
+/* lwIP's BSD socket API is the host's own */
+#include <errno.h>
+#include <sys/socket.h>
+
+#endif // TEST_LWIP_SOCKETS_H
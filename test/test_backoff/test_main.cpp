@@ -0,0 +1,192 @@
+/*
+ * ReconnectScheduler against virtual time: the backoff envelope, fast
+ * retry when the link comes back, adaptive attempt timeouts, and a fleet
+ * of devices riding out an access-point reboot. The fleet run prints how
+ * the retries spread, as a comparison point for policy changes.
+ *
+ *   pio test -e native -f test_backoff
+ */
+#include <unity.h>
+#include <vector>
+#include "ReconnectScheduler.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_backoff_doubles_with_equal_jitter_up_to_cap()
+{
+    ReconnectScheduler s;
+    s.begin(42);
+    uint32_t step = RECONNECT_BASE_MS;
+    for (uint32_t i = 0; i < 12; i++) {
+        s.started(LINK_CLOUD, 0);
+        s.failed(LINK_CLOUD, 0);
+        uint32_t wait = s.stage(LINK_CLOUD).waitMs;
+        TEST_ASSERT_GREATER_OR_EQUAL(step / 2, wait);
+        TEST_ASSERT_LESS_OR_EQUAL(step, wait);
+        TEST_ASSERT_FALSE(s.due(LINK_CLOUD, wait - 1));
+        TEST_ASSERT_TRUE(s.due(LINK_CLOUD, wait));
+        step = step * 2 > RECONNECT_CAP_MS ? RECONNECT_CAP_MS : step * 2;
+    }
+    TEST_ASSERT_EQUAL_UINT32(12, s.stage(LINK_CLOUD).failStreak);
+}
+
+void test_non_backoff_failure_retries_now()
+{
+    ReconnectScheduler s;
+    s.begin(7);
+    s.failed(LINK_CLOUD, 1000);
+    s.failed(LINK_CLOUD, 1000, false);
+    TEST_ASSERT_TRUE(s.due(LINK_CLOUD, 1000));
+    TEST_ASSERT_EQUAL_UINT32(1, s.stage(LINK_CLOUD).failStreak);
+}
+
+void test_link_up_clears_cloud_backoff()
+{
+    ReconnectScheduler s;
+    s.begin(42);
+    for (uint32_t i = 0; i < 6; i++) {
+        s.failed(LINK_CLOUD, 0);
+    }
+    TEST_ASSERT_FALSE(s.due(LINK_CLOUD, 1000));
+    s.started(LINK_NET, 1000);
+    s.succeeded(LINK_NET, 1800);
+    TEST_ASSERT_TRUE(s.due(LINK_CLOUD, 1800));
+    TEST_ASSERT_EQUAL_UINT32(0, s.stage(LINK_CLOUD).failStreak);
+    TEST_ASSERT_EQUAL_UINT32(800, s.stage(LINK_NET).lastConnectMs);
+}
+
+void test_attempt_timeout_follows_connect_times()
+{
+    ReconnectScheduler s;
+    TEST_ASSERT_EQUAL_UINT32(30000, s.attemptTimeout(LINK_NET, 30000));
+    s.started(LINK_NET, 0);
+    s.succeeded(LINK_NET, 800);
+    TEST_ASSERT_EQUAL_UINT32(RECONNECT_MIN_TIMEOUT_MS, s.attemptTimeout(LINK_NET, 30000));
+    for (uint32_t i = 0; i < 20; i++) {
+        s.started(LINK_NET, 0);
+        s.succeeded(LINK_NET, 5000);
+    }
+    uint32_t t = s.attemptTimeout(LINK_NET, 30000);
+    TEST_ASSERT_GREATER_THAN(RECONNECT_MIN_TIMEOUT_MS, t);
+    TEST_ASSERT_LESS_OR_EQUAL(30000, t);
+    TEST_ASSERT_EQUAL_UINT32(15000, s.attemptTimeout(LINK_NET, 15000));
+}
+
+void test_uptime_skips_paused_time()
+{
+    ReconnectScheduler s;
+    s.track(true, false, 0);
+    s.track(true, false, 1000);
+    s.track(true, true, 2000);
+    s.pause();
+    s.track(false, false, 60000);
+    s.track(false, false, 61000);
+    TEST_ASSERT_EQUAL_UINT64(3000, s.trackedMs());
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 2.0f / 3, s.uptime(LINK_NET));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f / 3, s.uptime(LINK_CLOUD));
+}
+
+/*
+ * The AP reboots at t = 0 and is back after FLEET_OUTAGE_MS; association
+ * takes FLEET_JOIN_MS once it is up. Attempts started while it is down
+ * run to their timeout.
+ */
+constexpr uint32_t FLEET_SIZE      = 200;
+constexpr uint32_t FLEET_OUTAGE_MS = 600000;
+constexpr uint32_t FLEET_JOIN_MS   = 1500;
+constexpr uint32_t FLEET_END_MS    = 1200000;
+constexpr uint32_t FLEET_TICK_MS   = 10;
+constexpr uint32_t FLEET_FIXED_RETRY_MS = 20000;   // attempt timeout, and the fixed retry compared against
+
+struct FleetDevice
+{
+    ReconnectScheduler sched;
+    bool     trying = false;
+    bool     up = false;
+    bool     joins = false;
+    uint32_t doneAt = 0;
+};
+
+void test_fleet_spreads_retries_after_ap_reboot()
+{
+    std::vector<FleetDevice> fleet(FLEET_SIZE);
+    for (uint32_t i = 0; i < FLEET_SIZE; i++) {
+        fleet[i].sched.begin(1000 + i * 7919);
+        fleet[i].sched.lost(LINK_NET, 0);
+    }
+
+    std::vector<uint32_t> perSecond(FLEET_END_MS / 1000);
+    uint32_t attempts = 0;
+    uint32_t lastUp = 0;
+    for (uint32_t now = 0; now < FLEET_END_MS; now += FLEET_TICK_MS) {
+        bool apUp = now >= FLEET_OUTAGE_MS;
+        for (FleetDevice &d : fleet) {
+            if (d.up) {
+                continue;
+            }
+            if (!d.trying) {
+                if (!d.sched.due(LINK_NET, now)) {
+                    continue;
+                }
+                d.sched.started(LINK_NET, now);
+                d.trying = true;
+                d.joins = apUp;
+                d.doneAt = now + (apUp ? FLEET_JOIN_MS : d.sched.attemptTimeout(LINK_NET, FLEET_FIXED_RETRY_MS));
+                attempts++;
+                perSecond[now / 1000]++;
+            } else if ((int32_t)(now - d.doneAt) >= 0) {
+                d.trying = false;
+                if (d.joins) {
+                    d.up = true;
+                    d.sched.succeeded(LINK_NET, now);
+                    lastUp = now;
+                } else {
+                    d.sched.failed(LINK_NET, now);
+                }
+            }
+        }
+    }
+
+    uint32_t upCount = 0;
+    for (const FleetDevice &d : fleet) {
+        upCount += d.up;
+    }
+    // Early rounds are bunched by design (jitter scales with the step); by
+    // the second half of the outage the retries should have spread out
+    uint32_t peak = 0;
+    uint32_t lastMinute = 0;
+    for (uint32_t sec = 0; sec < perSecond.size(); sec++) {
+        if (sec >= FLEET_OUTAGE_MS / 2000) {
+            peak = perSecond[sec] > peak ? perSecond[sec] : peak;
+        }
+        if (sec >= FLEET_OUTAGE_MS / 1000 - 60 && sec < FLEET_OUTAGE_MS / 1000) {
+            lastMinute += perSecond[sec];
+        }
+    }
+    uint32_t fixedLastMinute = FLEET_SIZE * 60000 / FLEET_FIXED_RETRY_MS;
+
+    char line[200];
+    snprintf(line, sizeof(line),
+             "fleet of %u: %u attempts over a %u s outage, peak %u/s from mid-outage on, %u in its last minute "
+             "(fixed retry: %u), all up %.1f s after the AP returned",
+             (unsigned)FLEET_SIZE, (unsigned)attempts, (unsigned)(FLEET_OUTAGE_MS / 1000), (unsigned)peak,
+             (unsigned)lastMinute, (unsigned)fixedLastMinute, (lastUp - FLEET_OUTAGE_MS) / 1000.0);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(FLEET_SIZE, upCount);
+    TEST_ASSERT_LESS_THAN(FLEET_SIZE / 10, peak);
+    TEST_ASSERT_LESS_THAN(fixedLastMinute / 2, lastMinute);
+    TEST_ASSERT_LESS_OR_EQUAL(RECONNECT_CAP_MS + FLEET_FIXED_RETRY_MS + FLEET_JOIN_MS, lastUp - FLEET_OUTAGE_MS);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_backoff_doubles_with_equal_jitter_up_to_cap);
+    RUN_TEST(test_non_backoff_failure_retries_now);
+    RUN_TEST(test_link_up_clears_cloud_backoff);
+    RUN_TEST(test_attempt_timeout_follows_connect_times);
+    RUN_TEST(test_uptime_skips_paused_time);
+    RUN_TEST(test_fleet_spreads_retries_after_ap_reboot);
+    return UNITY_END();
+}
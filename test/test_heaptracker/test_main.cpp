@@ -0,0 +1,164 @@
+/*
+ * HeapTracker's open-addressing table: frees found through a probe chain
+ * after backward-shift deletion has moved its neighbours, including
+ * chains that wrap from the last slot to the first. The pointers are
+ * fabricated addresses picked for where they hash; nothing is allocated.
+ *
+ *   pio test -e native -f test_heaptracker
+ */
+#include <unity.h>
+#include <vector>
+#include "HeapTracker.h"
+
+static HeapTracker *tracker;
+
+/* Same mixing as HeapTracker::hash() */
+static uint16_t homeSlot(const void *p)
+{
+    return (uint16_t)((((uintptr_t)p >> 3) * 2654435761u) >> 16) & (HEAP_TRACK_SLOTS - 1);
+}
+
+/* n distinct 8-byte aligned addresses whose home slot is home */
+static std::vector<void *> homedAt(uint16_t home, size_t n)
+{
+    static uintptr_t next = 0x3FC80000;
+    std::vector<void *> out;
+    while (out.size() < n) {
+        next += 8;
+        if (homeSlot((void *)next) == home) {
+            out.push_back((void *)next);
+        }
+    }
+    return out;
+}
+
+static void track(void *p, size_t size)
+{
+    tracker->onAlloc(p, size);
+}
+
+/* Frees p and checks it was found and credited back */
+static void release(void *p, size_t size)
+{
+    HeapTracker::TagStats before = tracker->tagStats(ALLOC_SAFETY);
+    uint16_t blocks = tracker->trackedBlocks();
+    tracker->onFree(p);
+    HeapTracker::TagStats after = tracker->tagStats(ALLOC_SAFETY);
+    TEST_ASSERT_EQUAL(before.frees + 1, after.frees);
+    TEST_ASSERT_EQUAL(before.liveBytes - size, after.liveBytes);
+    TEST_ASSERT_EQUAL(blocks - 1, tracker->trackedBlocks());
+}
+
+void setUp()
+{
+    tracker = new HeapTracker();
+    tracker->enter(ALLOC_SAFETY);
+}
+
+void tearDown()
+{
+    delete tracker;
+}
+
+void test_delete_shifts_a_collision_chain_back()
+{
+    // Three blocks share slot 40, a fourth homed at 41 lands behind them
+    // and one homed at 43 sits at home and must stay put
+    std::vector<void *> chain = homedAt(40, 3);
+    void *late = homedAt(41, 1)[0];
+    void *own = homedAt(43, 1)[0];
+    track(chain[0], 100);
+    track(chain[1], 200);
+    track(chain[2], 300);
+    track(late, 400);
+    track(own, 500);
+    TEST_ASSERT_EQUAL(5, tracker->trackedBlocks());
+    TEST_ASSERT_EQUAL(1500, tracker->tagStats(ALLOC_SAFETY).liveBytes);
+
+    release(chain[0], 100);
+    release(late, 400);
+    release(chain[2], 300);
+    release(own, 500);
+    release(chain[1], 200);
+    TEST_ASSERT_EQUAL(0, tracker->tagStats(ALLOC_SAFETY).liveBytes);
+    TEST_ASSERT_EQUAL(5, tracker->tagStats(ALLOC_SAFETY).allocs);
+}
+
+void test_freeing_an_untracked_block_changes_nothing()
+{
+    std::vector<void *> chain = homedAt(7, 3);
+    track(chain[0], 64);
+    track(chain[1], 64);
+    tracker->onFree(chain[2]);
+    TEST_ASSERT_EQUAL(0, tracker->tagStats(ALLOC_SAFETY).frees);
+    TEST_ASSERT_EQUAL(2, tracker->trackedBlocks());
+    release(chain[1], 64);
+    release(chain[0], 64);
+}
+
+void test_delete_shifts_across_the_table_end()
+{
+    // Slot 255 overflows into 0 and 1; a block homed at 0 ends up at 2
+    std::vector<void *> chain = homedAt(HEAP_TRACK_SLOTS - 1, 3);
+    void *wrapped = homedAt(0, 1)[0];
+    track(chain[0], 10);
+    track(chain[1], 20);
+    track(chain[2], 30);
+    track(wrapped, 40);
+
+    release(chain[0], 10);
+    release(wrapped, 40);
+    release(chain[1], 20);
+    release(chain[2], 30);
+    TEST_ASSERT_EQUAL(0, tracker->trackedBlocks());
+}
+
+void test_wrapped_block_is_not_moved_before_its_home()
+{
+    // Homed at 0 and sitting there; deleting 255 must not pull it back
+    // across the wrap, or later lookups starting at slot 0 miss it
+    void *last = homedAt(HEAP_TRACK_SLOTS - 1, 1)[0];
+    std::vector<void *> first = homedAt(0, 2);
+    track(last, 8);
+    track(first[0], 16);
+    track(first[1], 24);
+
+    release(last, 8);
+    release(first[1], 24);
+    release(first[0], 16);
+}
+
+void test_churn_keeps_every_block_findable()
+{
+    // Fill to the load cap with clustered homes, free in a scrambled
+    // order and check every free is still credited
+    const size_t n = HEAP_TRACK_SLOTS - HEAP_TRACK_SLOTS / 8;
+    std::vector<void *> blocks;
+    for (uint16_t h = 0; blocks.size() < n; h = (h + 37) & (HEAP_TRACK_SLOTS - 1)) {
+        std::vector<void *> some = homedAt(h, 3);
+        blocks.insert(blocks.end(), some.begin(), some.end());
+    }
+    blocks.resize(n);
+    for (void *p : blocks) {
+        track(p, 32);
+    }
+    TEST_ASSERT_EQUAL(n, tracker->trackedBlocks());
+    track(homedAt(5, 1)[0], 32);
+    TEST_ASSERT_EQUAL(1, tracker->overflows());
+
+    for (size_t step = 0; step < n; step++) {
+        release(blocks[(step * 97) % n], 32);
+    }
+    TEST_ASSERT_EQUAL(0, tracker->tagStats(ALLOC_SAFETY).liveBytes);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_delete_shifts_a_collision_chain_back);
+    RUN_TEST(test_freeing_an_untracked_block_changes_nothing);
+    RUN_TEST(test_delete_shifts_across_the_table_end);
+    RUN_TEST(test_wrapped_block_is_not_moved_before_its_home);
+    RUN_TEST(test_churn_keeps_every_block_findable);
+    return UNITY_END();
+}
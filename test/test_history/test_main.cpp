@@ -0,0 +1,185 @@
+/*
+ * HistoryCodec: bit-exact round trips across block boundaries, rejection
+ * of truncated streams, extreme deltas, and a size/throughput benchmark
+ * on a synthetic 5 s recording.
+ *
+ *   pio test -e native -f test_history
+ */
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+#include "HistoryCodec.h"
+
+constexpr size_t RAW_SAMPLE_BYTES = 24;   // sizeof(BufferedSample)
+
+static bool appendBytes(void *ctx, const uint8_t *data, size_t len)
+{
+    std::vector<uint8_t> *out = (std::vector<uint8_t> *)ctx;
+    out->insert(out->end(), data, data + len);
+    return true;
+}
+
+static void collectRow(void *ctx, const HistoryRow &row)
+{
+    ((std::vector<HistoryRow> *)ctx)->push_back(row);
+}
+
+static std::vector<uint8_t> encode(const std::vector<HistoryRow> &rows)
+{
+    std::vector<uint8_t> out;
+    HistoryEncoder enc;
+    TEST_ASSERT_TRUE(enc.begin(appendBytes, &out));
+    for (const HistoryRow &row : rows) {
+        TEST_ASSERT_TRUE(enc.add(row));
+    }
+    TEST_ASSERT_TRUE(enc.finish());
+    TEST_ASSERT_EQUAL(rows.size(), enc.rows());
+    TEST_ASSERT_EQUAL(out.size(), enc.bytes());
+    return out;
+}
+
+static void assertRoundTrip(const std::vector<HistoryRow> &rows)
+{
+    std::vector<uint8_t> stream = encode(rows);
+    std::vector<HistoryRow> got;
+    TEST_ASSERT_EQUAL((long)rows.size(), decodeHistory(stream.data(), stream.size(), collectRow, &got));
+    TEST_ASSERT_EQUAL(rows.size(), got.size());
+    if (!rows.empty()) {
+        TEST_ASSERT_EQUAL_MEMORY(rows.data(), got.data(), rows.size() * sizeof(HistoryRow));
+    }
+}
+
+/* A 5 s recording with scheduler jitter, sensor noise and draw events */
+static std::vector<HistoryRow> recording(uint32_t n, uint32_t seed)
+{
+    std::vector<HistoryRow> rows(n);
+    uint32_t rng = seed;
+    auto next = [&rng](uint32_t range) {
+        rng = rng * 1664525u + 1013904223u;
+        return (int64_t)((rng >> 8) % range);
+    };
+    int64_t t = 1760000000000LL;
+    int64_t total = 1234567;
+    int64_t blockage = 120;
+    int64_t flow = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        t += 5000 + next(41) - 20;
+        if (next(100) < 3) {
+            flow = flow ? 0 : 300 + next(900);
+        }
+        total += flow * 5 / 600;
+        if (next(500) == 0) {
+            blockage++;
+        }
+        HistoryRow &r = rows[i];
+        r.v[HIST_TIME] = t;
+        r.v[HIST_FLOW] = flow ? flow + next(11) - 5 : 0;
+        r.v[HIST_TOTAL] = total;
+        r.v[HIST_PRESSURE1] = 3200 - flow / 4 + next(7) - 3;
+        r.v[HIST_PRESSURE2] = 3100 - flow / 3 + next(7) - 3;
+        r.v[HIST_UV] = 850 + next(5) - 2;
+        r.v[HIST_DOSE] = flow ? 400 + next(3) : 0;
+        r.v[HIST_BLOCKAGE] = blockage;
+    }
+    return rows;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_round_trip_across_block_boundaries()
+{
+    const uint32_t counts[] = {0, 1, HIST_BLOCK_ROWS - 1, HIST_BLOCK_ROWS, HIST_BLOCK_ROWS + 1,
+                               2 * HIST_BLOCK_ROWS + 1, 1000};
+    for (uint32_t n : counts) {
+        assertRoundTrip(recording(n, n + 1));
+    }
+}
+
+void test_truncated_stream_is_rejected()
+{
+    std::vector<HistoryRow> rows = recording(40, 7);
+    std::vector<uint8_t> stream = encode(rows);
+    std::vector<HistoryRow> got;
+    for (size_t len = 0; len < stream.size(); len++) {
+        got.clear();
+        TEST_ASSERT_EQUAL(-1, decodeHistory(stream.data(), len, collectRow, &got));
+    }
+    stream[3]++;
+    TEST_ASSERT_EQUAL(-1, decodeHistory(stream.data(), stream.size(), collectRow, &got));
+}
+
+void test_negative_and_large_deltas()
+{
+    std::vector<HistoryRow> rows = recording(3 * HIST_BLOCK_ROWS, 3);
+    // Negative pressure (suction on a draining line) straddling a block edge
+    for (uint8_t i = HIST_BLOCK_ROWS - 2; i < HIST_BLOCK_ROWS + 2; i++) {
+        rows[i].v[HIST_PRESSURE1] = -950;
+        rows[i].v[HIST_PRESSURE2] = -1013;
+    }
+    // Clock stepped back by SNTP, then a 30-year jump, then back to the cadence
+    rows[20].v[HIST_TIME] = rows[19].v[HIST_TIME] - 3600000;
+    for (size_t i = 21; i < rows.size(); i++) {
+        rows[i].v[HIST_TIME] = rows[20].v[HIST_TIME] + 946080000000LL + (int64_t)(i - 21) * 5000;
+    }
+    rows[30].v[HIST_TOTAL] = 0;                 // meter replaced
+    rows[31].v[HIST_TOTAL] = 42949672950LL;     // 2^32 dl, past any 32-bit column
+    rows[32].v[HIST_FLOW] = -(1LL << 40);
+    rows[33].v[HIST_FLOW] = 1LL << 40;
+    assertRoundTrip(rows);
+
+    std::vector<HistoryRow> first(1);
+    for (uint8_t c = 0; c < HIST_COLUMNS; c++) {
+        first[0].v[c] = -(1LL << 50) + c;
+    }
+    assertRoundTrip(first);
+}
+
+void test_benchmark_ratio_and_throughput()
+{
+    const uint32_t n = 20000;
+    std::vector<HistoryRow> rows = recording(n, 11);
+    std::vector<uint8_t> stream;
+    stream.reserve(n * RAW_SAMPLE_BYTES);
+    const int passes = 20;
+    HistoryEncoder enc;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; p++) {
+        stream.clear();
+        enc.begin(appendBytes, &stream);
+        for (const HistoryRow &row : rows) {
+            enc.add(row);
+        }
+        enc.finish();
+    }
+    double encodeS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::vector<HistoryRow> got;
+    got.reserve(n);
+    t0 = std::chrono::steady_clock::now();
+    TEST_ASSERT_EQUAL((long)n, decodeHistory(stream.data(), stream.size(), collectRow, &got));
+    double decodeS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    TEST_ASSERT_EQUAL_MEMORY(rows.data(), got.data(), n * sizeof(HistoryRow));
+
+    double perSample = (double)stream.size() / n;
+    TEST_ASSERT_LESS_THAN(12, (int)perSample);
+
+    char line[200];
+    snprintf(line, sizeof(line),
+             "history: %u samples in %u B, %.1f B/sample, %.1fx vs BufferedSample, "
+             "encode %.1f M samples/s, decode %.1f M samples/s on host",
+             (unsigned)n, (unsigned)stream.size(), perSample, RAW_SAMPLE_BYTES / perSample,
+             passes * n / encodeS / 1e6, n / decodeS / 1e6);
+    TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_across_block_boundaries);
+    RUN_TEST(test_truncated_stream_is_rejected);
+    RUN_TEST(test_negative_and_large_deltas);
+    RUN_TEST(test_benchmark_ratio_and_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,295 @@
+/*
+ * LanStream end to end over loopback: the endpoint is polled on its own
+ * thread like the LAN task, a producer publishes the pressure trace at
+ * 500 Hz (ten times the firmware rate) plus a sample every half second,
+ * and test clients speak HTTP to LAN_STREAM_PORT. Covers NDJSON and
+ * binary streams, gap records for a client that stops reading, the
+ * client limit and bad requests.
+ *
+ *   pio test -e native -f test_lanstream
+ */
+#include <unity.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LanStream.h"
+
+constexpr uint32_t TRACE_STEP_US = 2000;
+constexpr uint32_t SAMPLE_EVERY  = 250;    // trace points per sample
+constexpr float    TRACE_P2      = 90.0f;
+constexpr uint16_t SAMPLE_UV     = 900;
+
+static std::atomic<bool> running{true};
+
+/* Acquisition stand-in: trace while a client streams, samples always */
+static void produce()
+{
+    for (uint32_t n = 0; running; n++) {
+        PressurePoint_t p = {(int64_t)n * TRACE_STEP_US, 1700000000000ull + n * 2, 100.0f + n % 50, TRACE_P2};
+        if (lanStream.tracing()) {
+            pressureTrace.publish(p);
+        }
+        if (n % SAMPLE_EVERY == 0) {
+            Sample_t s = {};
+            s.acquiredUs = p.acquiredUs;
+            s.epochMs = p.epochMs;
+            s.flowValid = true;
+            s.flowrate = 12.5f;
+            s.cumulativeFlow = 1000.0 + n;
+            s.uvAdc = SAMPLE_UV;
+            s.pressure1 = p.pressure1;
+            s.pressure2 = p.pressure2;
+            sampleTap.publish(s);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(TRACE_STEP_US));
+    }
+}
+
+static void lanTask()
+{
+    while (running) {
+        lanStream.poll(millis(), true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    lanStream.poll(millis(), false);
+}
+
+/* ─── Client side ──────────────────────────────────────────────────────── */
+static int openClient(int rcvBuf = 0)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (rcvBuf) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+    }
+    timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(LAN_STREAM_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_EQUAL_INT(0, connect(fd, (sockaddr *)&addr, sizeof(addr)));
+    return fd;
+}
+
+static void sendRequest(int fd, const char *target)
+{
+    char req[128];
+    int n = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: hydroguard\r\n\r\n", target);
+    TEST_ASSERT_EQUAL_INT(n, send(fd, req, n, MSG_NOSIGNAL));
+}
+
+/* Response head up to the blank line; anything read past it is left in rest */
+static std::string readHead(int fd, std::string &rest)
+{
+    std::string buf;
+    char tmp[512];
+    size_t end;
+    while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) {
+            return buf;
+        }
+        buf.append(tmp, n);
+    }
+    rest = buf.substr(end + 4);
+    return buf.substr(0, end + 4);
+}
+
+/* Collects the de-chunked body for ms milliseconds */
+static std::string readBody(int fd, std::string raw, uint32_t ms)
+{
+    uint32_t until = millis() + ms;
+    char tmp[4096];
+    while ((int32_t)(millis() - until) < 0) {
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) {
+            break;
+        }
+        raw.append(tmp, n);
+    }
+    std::string body;
+    size_t pos = 0;
+    for (;;) {
+        size_t eol = raw.find("\r\n", pos);
+        if (eol == std::string::npos) {
+            break;
+        }
+        size_t len = strtoul(raw.c_str() + pos, nullptr, 16);
+        if (eol + 2 + len + 2 > raw.size()) {
+            break;   // chunk still in flight
+        }
+        body.append(raw, eol + 2, len);
+        pos = eol + 2 + len + 2;
+    }
+    return body;
+}
+
+static std::string statusLine(const std::string &head)
+{
+    return head.substr(0, head.find("\r\n"));
+}
+
+/* ─── Tests ────────────────────────────────────────────────────────────── */
+void setUp() {}
+void tearDown()
+{
+    delay(100);   // let the LAN task see the close and free the slot
+}
+
+void test_ndjson_stream_is_contiguous()
+{
+    int fd = openClient();
+    sendRequest(fd, "/stream");
+    std::string rest;
+    std::string head = readHead(fd, rest);
+    TEST_ASSERT_EQUAL_STRING("HTTP/1.1 200 OK", statusLine(head).c_str());
+    TEST_ASSERT_TRUE(head.find("Transfer-Encoding: chunked") != std::string::npos);
+    TEST_ASSERT_TRUE(head.find("application/x-ndjson") != std::string::npos);
+
+    std::string body = readBody(fd, rest, 1500);
+    close(fd);
+
+    uint32_t traces = 0, samples = 0, gaps = 0;
+    long long lastUs = -1;
+    bool contiguous = true;
+    size_t pos = 0, eol;
+    while ((eol = body.find('\n', pos)) != std::string::npos) {
+        std::string line = body.substr(pos, eol - pos);
+        pos = eol + 1;
+        long long us;
+        if (line.find("\"type\":\"p\"") != std::string::npos) {
+            TEST_ASSERT_TRUE(sscanf(strstr(line.c_str(), "\"us\":"), "\"us\":%lld", &us) == 1);
+            contiguous &= lastUs < 0 || us - lastUs == TRACE_STEP_US;
+            lastUs = us;
+            traces++;
+        } else if (line.find("\"type\":\"sample\"") != std::string::npos) {
+            TEST_ASSERT_TRUE(line.find("\"uv\":900,") != std::string::npos);
+            samples++;
+        } else {
+            TEST_ASSERT_TRUE(line.find("\"type\":\"gap\"") != std::string::npos);
+            gaps++;
+        }
+    }
+    char msg[120];
+    snprintf(msg, sizeof(msg), "ndjson: %u trace points, %u samples, %u gaps in 1.5 s", (unsigned)traces,
+             (unsigned)samples, (unsigned)gaps);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_GREATER_THAN(300, traces);
+    TEST_ASSERT_GREATER_OR_EQUAL(2, samples);
+    TEST_ASSERT_EQUAL_UINT32(0, gaps);
+    TEST_ASSERT_TRUE(contiguous);
+}
+
+void test_binary_frames_decode()
+{
+    int fd = openClient();
+    sendRequest(fd, "/stream?format=bin");
+    std::string rest;
+    std::string head = readHead(fd, rest);
+    TEST_ASSERT_TRUE(head.find("application/octet-stream") != std::string::npos);
+
+    std::string body = readBody(fd, rest, 1500);
+    close(fd);
+
+    uint32_t count[4] = {};
+    int64_t lastUs = -1;
+    bool valid = true;
+    const uint8_t *p = (const uint8_t *)body.data();
+    const uint8_t *end = p + body.size();
+    while (end - p >= 2 && end - p >= 2 + p[1]) {
+        uint8_t type = p[0];
+        const uint8_t *f = p + 2;
+        TEST_ASSERT_TRUE(type >= LAN_FRAME_SAMPLE && type <= LAN_FRAME_GAP);
+        count[type]++;
+        if (type == LAN_FRAME_TRACE) {
+            TEST_ASSERT_EQUAL_INT(24, p[1]);
+            int64_t us;
+            float p2;
+            memcpy(&us, f + 8, sizeof(us));
+            memcpy(&p2, f + 20, sizeof(p2));
+            valid &= (lastUs < 0 || us - lastUs == TRACE_STEP_US) && p2 == TRACE_P2;
+            lastUs = us;
+        } else if (type == LAN_FRAME_SAMPLE) {
+            TEST_ASSERT_EQUAL_INT(39, p[1]);
+            uint16_t uv;
+            memcpy(&uv, f + 28, sizeof(uv));
+            valid &= uv == SAMPLE_UV && f[38] == 1;
+        }
+        p += 2 + p[1];
+    }
+    TEST_ASSERT_GREATER_THAN(300, count[LAN_FRAME_TRACE]);
+    TEST_ASSERT_GREATER_OR_EQUAL(2, count[LAN_FRAME_SAMPLE]);
+    TEST_ASSERT_EQUAL_UINT32(0, count[LAN_FRAME_GAP]);
+    TEST_ASSERT_TRUE(valid);
+}
+
+/* A client that stops reading is lapped and told how much it missed */
+void test_slow_reader_gets_gap_record()
+{
+    uint32_t gapsBefore = lanStream.stats().gaps;
+    int fd = openClient(2048);
+    sendRequest(fd, "/stream");
+    delay(1500);   // 750 trace points against a 256-entry tap
+
+    std::string rest;
+    std::string head = readHead(fd, rest);
+    TEST_ASSERT_EQUAL_STRING("HTTP/1.1 200 OK", statusLine(head).c_str());
+    std::string body = readBody(fd, rest, 500);
+    close(fd);
+
+    static const char GAP[] = "{\"type\":\"gap\",\"of\":\"p\",\"skipped\":";
+    size_t gap = body.find(GAP);
+    TEST_ASSERT_TRUE(gap != std::string::npos);
+    TEST_ASSERT_GREATER_THAN(0, atoi(body.c_str() + gap + sizeof(GAP) - 1));
+    TEST_ASSERT_GREATER_THAN(gapsBefore, lanStream.stats().gaps);
+}
+
+void test_fourth_client_is_refused()
+{
+    int fds[LAN_MAX_CLIENTS];
+    for (uint8_t i = 0; i < LAN_MAX_CLIENTS; i++) {
+        fds[i] = openClient();
+        sendRequest(fds[i], "/stream");
+    }
+    delay(100);
+    int extra = openClient();
+    std::string rest;
+    TEST_ASSERT_EQUAL_STRING("HTTP/1.1 503 Service Unavailable", statusLine(readHead(extra, rest)).c_str());
+    close(extra);
+    for (int fd : fds) {
+        close(fd);
+    }
+}
+
+void test_unknown_path_is_404()
+{
+    int fd = openClient();
+    sendRequest(fd, "/streams");
+    std::string rest;
+    TEST_ASSERT_EQUAL_STRING("HTTP/1.1 404 Not Found", statusLine(readHead(fd, rest)).c_str());
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    std::thread producer(produce);
+    std::thread lan(lanTask);
+    while (!lanStream.listening()) {
+        delay(1);
+    }
+    delay(20);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_ndjson_stream_is_contiguous);
+    RUN_TEST(test_binary_frames_decode);
+    RUN_TEST(test_slow_reader_gets_gap_record);
+    RUN_TEST(test_fourth_client_is_refused);
+    RUN_TEST(test_unknown_path_is_404);
+    int failures = UNITY_END();
+
+    running = false;
+    producer.join();
+    lan.join();
+    return failures;
+}
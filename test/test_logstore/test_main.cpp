@@ -0,0 +1,289 @@
+/*
+ * LogStore on a RAM flash: round trip, coalescing, recovery after reboot
+ * and after power loss at every byte of a write, the live-set cap, the
+ * NVS fallback for units without the partition, and a
+ * write-amplification / recovery-time benchmark.
+ *
+ *   pio test -e native -f test_logstore
+ */
+#include <unity.h>
+#include "RamFlash.h"
+
+constexpr uint32_t HGLOG_SECTORS = 32;   // partitions.csv: hglog is 128 KB
+constexpr uint8_t  WEAR_KEYS     = 12;   // more keys than the firmware uses
+
+static void fillPattern(uint8_t *buf, uint16_t len, uint32_t seed)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed * 31 + i);
+    }
+}
+
+static bool holdsPattern(LogStore &store, uint8_t key, uint16_t len, uint32_t seed)
+{
+    uint8_t got[LOG_MAX_PAYLOAD];
+    uint8_t want[LOG_MAX_PAYLOAD];
+    fillPattern(want, len, seed);
+    return store.read(key, got, sizeof(got)) == len && memcmp(got, want, len) == 0;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_round_trip_survives_reboot()
+{
+    RamFlash flash(4);
+    LogStore store;
+    TEST_ASSERT_TRUE(store.begin(flash));
+
+    uint32_t settings = 123456;
+    uint8_t blob[200];
+    fillPattern(blob, sizeof(blob), 7);
+    TEST_ASSERT_TRUE(store.writeValue(LOG_KEY_SETTINGS, settings));
+    TEST_ASSERT_TRUE(store.write(LOG_KEY_DETECTOR, blob, sizeof(blob)));
+    settings++;
+    TEST_ASSERT_TRUE(store.writeValue(LOG_KEY_SETTINGS, settings));
+
+    LogStore rebooted;
+    TEST_ASSERT_TRUE(rebooted.begin(flash));
+    uint32_t restored = 0;
+    TEST_ASSERT_TRUE(rebooted.readValue(LOG_KEY_SETTINGS, restored));
+    TEST_ASSERT_EQUAL_UINT32(settings, restored);
+    TEST_ASSERT_TRUE(holdsPattern(rebooted, LOG_KEY_DETECTOR, sizeof(blob), 7));
+    TEST_ASSERT_EQUAL_UINT16(0, rebooted.read(LOG_KEY_BURST, blob, sizeof(blob)));
+}
+
+void test_unchanged_value_is_coalesced()
+{
+    RamFlash flash(4);
+    LogStore store;
+    TEST_ASSERT_TRUE(store.begin(flash));
+
+    uint8_t open = 1;
+    TEST_ASSERT_TRUE(store.writeValue(LOG_KEY_VALVE, open));
+    uint64_t programmed = flash.written;
+    TEST_ASSERT_TRUE(store.writeValue(LOG_KEY_VALVE, open));
+    TEST_ASSERT_EQUAL_UINT64(programmed, flash.written);
+    TEST_ASSERT_EQUAL_UINT32(1, store.getStats().coalesced);
+}
+
+void test_wear_rotates_and_keeps_every_key()
+{
+    RamFlash flash(4);
+    LogStore store;
+    TEST_ASSERT_TRUE(store.begin(flash));
+
+    uint32_t seed[WEAR_KEYS + 1] = {};
+    uint8_t buf[LOG_MAX_PAYLOAD];
+    for (uint32_t i = 1; i <= 20000; i++) {
+        uint8_t key = 1 + i % WEAR_KEYS;
+        uint16_t len = key == LOG_KEY_DETECTOR ? 400 : 4 + key * 7;
+        fillPattern(buf, len, i);
+        TEST_ASSERT_TRUE(store.write(key, buf, len));
+        seed[key] = i;
+    }
+    TEST_ASSERT_GREATER_THAN(100, store.getStats().erases);
+    TEST_ASSERT_EQUAL_UINT32(0, store.getStats().failed);
+
+    LogStore rebooted;
+    TEST_ASSERT_TRUE(rebooted.begin(flash));
+    for (uint8_t key = 1; key <= WEAR_KEYS; key++) {
+        uint16_t len = key == LOG_KEY_DETECTOR ? 400 : 4 + key * 7;
+        TEST_ASSERT_TRUE(holdsPattern(rebooted, key, len, seed[key]));
+    }
+}
+
+/* Replays the same writes with power cut after every possible byte count */
+void test_power_loss_keeps_old_or_new_value()
+{
+    const uint8_t  keys[3] = {LOG_KEY_SETTINGS, LOG_KEY_USAGE, LOG_KEY_BURST};
+    const uint16_t lens[3] = {40, 300, 24};
+    const uint32_t writes = 110;  // wraps the three sectors, compacting and erasing
+
+    uint8_t buf[LOG_MAX_PAYLOAD];
+    for (long budget = 0;; budget++) {
+        RamFlash flash(3);
+        LogStore live;
+        TEST_ASSERT_TRUE(live.begin(flash));
+        flash.setBudget(budget);
+
+        uint32_t acked[3] = {};
+        uint32_t torn = 0;
+        uint8_t  tornKey = 0;
+        for (uint32_t i = 1; i <= writes; i++) {
+            // BURST is written once, early, so compaction must carry it along
+            uint8_t k = i == 2 ? 2 : (i % 5 == 0 ? 1 : 0);
+            fillPattern(buf, lens[k], i);
+            if (!live.write(keys[k], buf, lens[k])) {
+                torn = i;
+                tornKey = k;
+                break;
+            }
+            acked[k] = i;
+        }
+        flash.setBudget(-1);
+
+        LogStore rebooted;
+        TEST_ASSERT_TRUE(rebooted.begin(flash));
+        for (uint8_t k = 0; k < 3; k++) {
+            bool old = acked[k] ? holdsPattern(rebooted, keys[k], lens[k], acked[k])
+                                : rebooted.read(keys[k], buf, sizeof(buf)) == 0;
+            bool inFlight = torn && tornKey == k && holdsPattern(rebooted, keys[k], lens[k], torn);
+            TEST_ASSERT_TRUE(old || inFlight);
+        }
+        // Records written after a torn one must be found on the next boot
+        fillPattern(buf, lens[0], 999);
+        TEST_ASSERT_TRUE(rebooted.write(keys[0], buf, lens[0]));
+        LogStore again;
+        TEST_ASSERT_TRUE(again.begin(flash));
+        TEST_ASSERT_TRUE(holdsPattern(again, keys[0], lens[0], 999));
+        if (!torn) {
+            TEST_ASSERT_GREATER_THAN(0, flash.erases);
+            break;
+        }
+        TEST_ASSERT_EQUAL_UINT32(1, live.getStats().failed);
+    }
+}
+
+void test_live_set_cap_refuses_and_counts()
+{
+    RamFlash flash(4);
+    LogStore store;
+    TEST_ASSERT_TRUE(store.begin(flash));
+
+    uint8_t buf[LOG_MAX_PAYLOAD];
+    uint8_t key = 1;
+    for (; key < LOG_MAX_KEYS; key++) {
+        fillPattern(buf, LOG_MAX_PAYLOAD, key);
+        if (!store.write(key, buf, LOG_MAX_PAYLOAD)) {
+            break;
+        }
+    }
+    TEST_ASSERT_LESS_THAN(LOG_MAX_KEYS, key);
+    LogStore::Stats st = store.getStats();
+    TEST_ASSERT_EQUAL_UINT32(1, st.failed);
+    TEST_ASSERT_EQUAL_UINT8(key, st.lastFailedKey);
+    TEST_ASSERT_LESS_OR_EQUAL(LOG_LIVE_CAPACITY, st.liveBytes);
+
+    // Shrinking a value still fits, and the full set survives compaction
+    TEST_ASSERT_TRUE(store.write(key - 1, buf, 8));
+    for (uint32_t n = 0; n < 200; n++) {
+        fillPattern(buf, LOG_MAX_PAYLOAD, 1);
+        buf[0] = (uint8_t)n;
+        TEST_ASSERT_TRUE(store.write(1, buf, LOG_MAX_PAYLOAD));
+    }
+    LogStore rebooted;
+    TEST_ASSERT_TRUE(rebooted.begin(flash));
+    for (uint8_t k = 2; k < key - 1; k++) {
+        TEST_ASSERT_TRUE(holdsPattern(rebooted, k, LOG_MAX_PAYLOAD, k));
+    }
+}
+
+void test_not_ready_write_is_counted()
+{
+    RamFlash tiny(2);
+    LogStore store;
+    TEST_ASSERT_FALSE(store.begin(tiny));
+    uint8_t open = 1;
+    TEST_ASSERT_FALSE(store.writeValue(LOG_KEY_VALVE, open));
+    TEST_ASSERT_EQUAL_UINT32(1, store.getStats().failed);
+}
+
+/* Firmware-like mix: valve changes, usage baselines and detector hourly, settings daily */
+/* OTA-updated units have no hglog: the same keys go to NVS instead */
+void test_nvs_fallback_round_trip_and_cap()
+{
+    LogStore store;
+    TEST_ASSERT_TRUE(store.beginNvs("test_state"));
+    TEST_ASSERT_TRUE(store.usesNvs());
+
+    uint8_t valve = 0;
+    uint8_t blob[LOG_MAX_PAYLOAD];
+    fillPattern(blob, 200, 3);
+    TEST_ASSERT_TRUE(store.writeValue(LOG_KEY_VALVE, valve));
+    TEST_ASSERT_TRUE(store.write(LOG_KEY_DETECTOR, blob, 200));
+    TEST_ASSERT_TRUE(store.write(LOG_KEY_DETECTOR, blob, 200));
+    TEST_ASSERT_EQUAL_UINT32(1, store.getStats().coalesced);
+
+    LogStore rebooted;
+    TEST_ASSERT_TRUE(rebooted.beginNvs("test_state"));
+    valve = 1;
+    TEST_ASSERT_TRUE(rebooted.readValue(LOG_KEY_VALVE, valve));
+    TEST_ASSERT_EQUAL_UINT8(0, valve);
+    TEST_ASSERT_TRUE(holdsPattern(rebooted, LOG_KEY_DETECTOR, 200, 3));
+    TEST_ASSERT_EQUAL_UINT16(0, rebooted.read(LOG_KEY_SETTINGS, blob, sizeof(blob)));
+    TEST_ASSERT_TRUE(rebooted.write(LOG_KEY_DETECTOR, blob, 200));
+    TEST_ASSERT_EQUAL_UINT32(1, rebooted.getStats().coalesced);
+
+    // Same live-set cap as on flash, so a unit can move to hglog later
+    uint8_t key = 1;
+    for (; key < LOG_MAX_KEYS; key++) {
+        fillPattern(blob, LOG_MAX_PAYLOAD, key);
+        if (!rebooted.write(key, blob, LOG_MAX_PAYLOAD)) {
+            break;
+        }
+    }
+    TEST_ASSERT_LESS_THAN(LOG_MAX_KEYS, key);
+    TEST_ASSERT_EQUAL_UINT32(1, rebooted.getStats().failed);
+    TEST_ASSERT_LESS_OR_EQUAL(LOG_LIVE_CAPACITY, rebooted.getStats().liveBytes);
+
+    // Back on a partition, the store no longer touches NVS
+    RamFlash flash(4);
+    TEST_ASSERT_TRUE(rebooted.begin(flash));
+    TEST_ASSERT_FALSE(rebooted.usesNvs());
+    TEST_ASSERT_FALSE(rebooted.readValue(LOG_KEY_VALVE, valve));
+}
+
+void test_benchmark_amplification_and_recovery()
+{
+    RamFlash flash(HGLOG_SECTORS);
+    LogStore store;
+    TEST_ASSERT_TRUE(store.begin(flash));
+
+    uint8_t buf[LOG_MAX_PAYLOAD];
+    for (uint32_t minute = 0; minute < 7 * 24 * 60; minute++) {
+        if (minute % (24 * 60) == 0) {
+            fillPattern(buf, 8, minute);
+            store.write(LOG_KEY_SETTINGS, buf, 8);
+        }
+        if (minute % 10 == 0) {
+            buf[0] = (uint8_t)(minute / 10 % 2);
+            store.write(LOG_KEY_VALVE, buf, 1);
+        }
+        if (minute % 60 == 0) {
+            fillPattern(buf, 360, minute);
+            store.write(LOG_KEY_USAGE, buf, 360);
+            fillPattern(buf, 420, minute + 1);
+            store.write(LOG_KEY_DETECTOR, buf, 420);
+        }
+    }
+    LogStore::Stats st = store.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, st.failed);
+
+    int64_t t0 = esp_timer_get_time();
+    LogStore rebooted;
+    TEST_ASSERT_TRUE(rebooted.begin(flash));
+    int64_t hostUs = esp_timer_get_time() - t0;
+
+    char line[200];
+    snprintf(line, sizeof(line),
+             "logstore: wa %.2f, %u erases over %u sectors (%.1f per sector per week), "
+             "recovery reads %u KB in %lld us on host",
+             store.writeAmplification(), (unsigned)st.erases, (unsigned)HGLOG_SECTORS,
+             (float)st.erases / HGLOG_SECTORS, (unsigned)(flash.reads / 1024), (long long)hostUs);
+    TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_survives_reboot);
+    RUN_TEST(test_unchanged_value_is_coalesced);
+    RUN_TEST(test_wear_rotates_and_keeps_every_key);
+    RUN_TEST(test_power_loss_keeps_old_or_new_value);
+    RUN_TEST(test_live_set_cap_refuses_and_counts);
+    RUN_TEST(test_not_ready_write_is_counted);
+    RUN_TEST(test_nvs_fallback_round_trip_and_cap);
+    RUN_TEST(test_benchmark_amplification_and_recovery);
+    return UNITY_END();
+}
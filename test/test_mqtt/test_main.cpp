@@ -0,0 +1,358 @@
+/*
+ * MqttSink against an in-process MQTT 3.1.1 broker on loopback. The broker
+ * acknowledges QoS 1 publishes after a fixed delay (a stand-in for the
+ * round trip to a site broker) and can cut the connection mid-stream.
+ * Covers QoS 0 and pipelined QoS 1 delivery with throughput figures,
+ * at-least-once resend after a dropped session, the settings handoff to
+ * the MQTT task, and dropping the in-flight window on a broker change.
+ *
+ *   pio test -e native -f test_mqtt
+ */
+#include <unity.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <poll.h>
+#include "MqttSink.h"
+
+constexpr uint32_t TEST_TIMEOUT_MS = 20000;
+
+/* ─── Broker ───────────────────────────────────────────────────────────── */
+class MiniBroker
+{
+public:
+    struct Seen
+    {
+        uint32_t connects;
+        uint32_t publishes;
+        uint32_t duplicates;     // telemetry received more than once
+        uint32_t dupFlagged;     // publishes carrying DUP
+        uint32_t events;
+        size_t   telemetry;      // distinct telemetry records
+    };
+
+    MiniBroker(uint32_t ackDelay, uint32_t dropAt) : ackDelayMs(ackDelay), dropAfter(dropAt)
+    {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listener, (sockaddr *)&addr, sizeof(addr));   // any free port
+        listen(listener, 2);
+        socklen_t len = sizeof(addr);
+        getsockname(listener, (sockaddr *)&addr, &len);
+        brokerPort = ntohs(addr.sin_port);
+        worker = std::thread([this] { serve(); });
+    }
+
+    ~MiniBroker()
+    {
+        stopping = true;
+        worker.join();
+        close(listener);
+    }
+
+    uint16_t port() const { return brokerPort; }
+
+    Seen seen()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        Seen s = counts;
+        s.telemetry = telemetry.size();
+        return s;
+    }
+
+private:
+    struct PendingAck
+    {
+        uint32_t dueMs;
+        uint8_t  id[2];
+    };
+
+    void serve()
+    {
+        while (!stopping) {
+            pollfd p = {listener, POLLIN, 0};
+            if (::poll(&p, 1, 20) <= 0) {
+                continue;
+            }
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                session(fd);
+                close(fd);
+            }
+        }
+    }
+
+    /* One client at a time; returns when it leaves or the broker cuts it off */
+    void session(int fd)
+    {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::deque<PendingAck> acks;
+        std::string buf;
+        while (!stopping) {
+            uint32_t now = millis();
+            while (!acks.empty() && (int32_t)(now - acks.front().dueMs) >= 0) {
+                uint8_t puback[4] = {0x40, 0x02, acks.front().id[0], acks.front().id[1]};
+                send(fd, puback, sizeof(puback), MSG_NOSIGNAL);
+                acks.pop_front();
+            }
+            pollfd p = {fd, POLLIN, 0};
+            if (::poll(&p, 1, acks.empty() ? 20 : 1) <= 0) {
+                continue;
+            }
+            char tmp[4096];
+            ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+            if (n <= 0) {
+                return;
+            }
+            buf.append(tmp, n);
+            size_t used;
+            while ((used = packet(fd, buf, acks))) {
+                buf.erase(0, used);
+                if (dropAfter && counts.publishes == dropAfter && !dropped) {
+                    dropped = true;
+                    return;                              // unacknowledged publishes die with the session
+                }
+            }
+        }
+    }
+
+    /* Handles the first complete packet in buf; returns its size, 0 if incomplete */
+    size_t packet(int fd, const std::string &buf, std::deque<PendingAck> &acks)
+    {
+        const uint8_t *b = (const uint8_t *)buf.data();
+        size_t len = 0, hdr = 1;
+        uint8_t shift = 0;
+        do {
+            if (hdr >= buf.size()) {
+                return 0;
+            }
+            len |= (size_t)(b[hdr] & 0x7F) << shift;
+            shift += 7;
+        } while (b[hdr++] & 0x80);
+        if (hdr + len > buf.size()) {
+            return 0;
+        }
+        const uint8_t *body = b + hdr;
+        std::lock_guard<std::mutex> guard(mutex);
+        switch (b[0] >> 4) {
+        case 1: {                                        // CONNECT
+            static const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+            send(fd, connack, sizeof(connack), MSG_NOSIGNAL);
+            counts.connects++;
+            break;
+        }
+        case 3: {                                        // PUBLISH
+            uint8_t qos = (b[0] >> 1) & 3;
+            size_t topicLen = body[0] << 8 | body[1];
+            std::string topic((const char *)body + 2, topicLen);
+            size_t p = 2 + topicLen;
+            if (qos) {
+                PendingAck a = {millis() + ackDelayMs, {body[p], body[p + 1]}};
+                acks.push_back(a);
+                p += 2;
+            }
+            std::string payload((const char *)body + p, len - p);
+            counts.publishes++;
+            counts.dupFlagged += (b[0] & 0x08) != 0;
+            unsigned long long t;
+            if (topic.find("/telemetry") != std::string::npos && sscanf(payload.c_str(), "{\"t\":%llu", &t) == 1) {
+                counts.duplicates += !telemetry.insert(t).second;
+            } else if (topic.find("/event/") != std::string::npos) {
+                counts.events++;
+            }
+            break;
+        }
+        case 12: {                                       // PINGREQ
+            static const uint8_t pingresp[] = {0xD0, 0x00};
+            send(fd, pingresp, sizeof(pingresp), MSG_NOSIGNAL);
+            break;
+        }
+        default:
+            break;
+        }
+        return hdr + len;
+    }
+
+    int               listener = -1;
+    uint16_t          brokerPort = 0;
+    uint32_t          ackDelayMs;
+    uint32_t          dropAfter;
+    bool              dropped = false;
+    std::atomic<bool> stopping{false};
+    std::thread       worker;
+    std::mutex        mutex;
+    Seen              counts = {};
+    std::set<unsigned long long> telemetry;
+};
+
+/* ─── Device side ──────────────────────────────────────────────────────── */
+static MqttConfig brokerConfig(uint16_t port, uint8_t qos)
+{
+    MqttConfig c = {};
+    c.enabled = 1;
+    c.qos = qos;
+    c.port = port;
+    strlcpy(c.host, "127.0.0.1", sizeof(c.host));
+    return c;
+}
+
+/*
+ * Offers reports (an event every 100th) as fast as the queue takes them
+ * and runs the sink between offers, like the safety and MQTT tasks.
+ * @return Seconds until the broker has every record.
+ */
+static float stream(MqttSink &sink, MiniBroker &broker, uint32_t reports)
+{
+    uint32_t offered = 0;
+    uint32_t events = 0;
+    uint32_t start = millis();
+    while (millis() - start < TEST_TIMEOUT_MS) {
+        while (offered < reports) {
+            if (offered % 100 == 0 && events == offered / 100) {
+                CloudEvent_t e = {};
+                e.type = CLOUD_LOG_EVENT;
+                e.name = "leak";
+                snprintf(e.msg, sizeof(e.msg), "event %u", (unsigned)events);
+                if (!sink.event(e)) {
+                    break;
+                }
+                events++;
+            }
+            Report_t r = {};
+            r.epochMs = offered;
+            r.flowrate = 1.5f;
+            if (!sink.report(r)) {
+                break;
+            }
+            offered++;
+        }
+        sink.run(millis(), true);
+        MiniBroker::Seen seen = broker.seen();
+        if (seen.telemetry == reports && seen.events >= events && offered == reports) {
+            return (millis() - start) / 1000.0f;
+        }
+        delay(1);
+    }
+    return -1.0f;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_settings_take_effect_on_the_mqtt_task()
+{
+    MqttSink sink;
+    MiniBroker broker(0, 0);
+    sink.requestConfig(brokerConfig(broker.port(), 1));
+    TEST_ASSERT_EQUAL_UINT16(broker.port(), sink.config().port);
+    TEST_ASSERT_FALSE(sink.active());
+    sink.run(millis(), true);
+    TEST_ASSERT_TRUE(sink.active());
+    TEST_ASSERT_TRUE(sink.connected());
+    TEST_ASSERT_EQUAL_UINT32(1, sink.session().connects);
+
+    MqttConfig off = sink.config();
+    off.enabled = 0;
+    sink.requestConfig(off);
+    TEST_ASSERT_TRUE(sink.connected());
+    sink.run(millis(), true);
+    TEST_ASSERT_FALSE(sink.active());
+    TEST_ASSERT_FALSE(sink.connected());
+    TEST_ASSERT_EQUAL_UINT32(1, sink.session().disconnects);
+}
+
+void test_qos0_delivers_everything()
+{
+    MqttSink sink;
+    MiniBroker broker(0, 0);
+    sink.requestConfig(brokerConfig(broker.port(), 0));
+    float s = stream(sink, broker, 2000);
+    MiniBroker::Seen seen = broker.seen();
+
+    char line[160];
+    snprintf(line, sizeof(line), "mqtt qos0: %u records in %.2f s (%.0f/s)", (unsigned)seen.publishes, s,
+             seen.publishes / s);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_THAN(0, s);
+    TEST_ASSERT_EQUAL_UINT32(0, seen.duplicates);
+    TEST_ASSERT_EQUAL_UINT32(0, sink.stats().failed);
+}
+
+/* With a 20 ms ack delay, one publish per round trip would manage 50/s */
+void test_qos1_pipelines_past_the_round_trip()
+{
+    const uint32_t ackDelayMs = 20;
+    MqttSink sink;
+    MiniBroker broker(ackDelayMs, 0);
+    sink.requestConfig(brokerConfig(broker.port(), 1));
+    float s = stream(sink, broker, 1000);
+    MiniBroker::Seen seen = broker.seen();
+
+    char line[160];
+    snprintf(line, sizeof(line), "mqtt qos1, %u ms acks: %u records in %.2f s (%.0f/s, stop-and-wait %u/s)",
+             (unsigned)ackDelayMs, (unsigned)seen.publishes, s, seen.publishes / s, (unsigned)(1000 / ackDelayMs));
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_THAN(0, s);
+    TEST_ASSERT_GREATER_THAN(3 * 1000 / ackDelayMs, seen.publishes / s);
+    TEST_ASSERT_EQUAL_UINT32(0, seen.duplicates);
+}
+
+/* Publishes in flight when the session drops are resent with DUP */
+void test_qos1_resends_after_dropped_session()
+{
+    MqttSink sink;
+    MiniBroker broker(20, 150);
+    sink.requestConfig(brokerConfig(broker.port(), 1));
+    float s = stream(sink, broker, 300);
+    MiniBroker::Seen seen = broker.seen();
+    MqttSink::Session sess = sink.session();
+
+    TEST_ASSERT_GREATER_THAN(0, s);
+    TEST_ASSERT_EQUAL_UINT32(2, seen.connects);
+    TEST_ASSERT_EQUAL_UINT32(2, sess.connects);
+    TEST_ASSERT_GREATER_THAN(0, sess.resent);
+    TEST_ASSERT_EQUAL_UINT32(sess.resent, seen.dupFlagged);
+    TEST_ASSERT_LESS_OR_EQUAL(MQTT_INFLIGHT, seen.duplicates);
+}
+
+/* Unacknowledged publishes are not carried over to a different broker */
+void test_broker_change_drops_the_inflight_window()
+{
+    MqttSink sink;
+    MiniBroker slow(TEST_TIMEOUT_MS, 0);
+    MiniBroker next(0, 0);
+    sink.requestConfig(brokerConfig(slow.port(), 1));
+    sink.run(millis(), true);
+    for (uint32_t i = 0; i < MQTT_INFLIGHT; i++) {
+        Report_t r = {};
+        r.epochMs = i;
+        TEST_ASSERT_TRUE(sink.report(r));
+    }
+    sink.run(millis(), true);
+    TEST_ASSERT_EQUAL_UINT8(MQTT_INFLIGHT, sink.session().inflight);
+
+    sink.requestConfig(brokerConfig(next.port(), 1));
+    sink.run(millis(), true);
+    TEST_ASSERT_TRUE(sink.connected());
+    TEST_ASSERT_EQUAL_UINT8(0, sink.session().inflight);
+    TEST_ASSERT_EQUAL_UINT32(0, sink.session().resent);
+    TEST_ASSERT_EQUAL_UINT32(MQTT_INFLIGHT, sink.stats().failed);
+    TEST_ASSERT_EQUAL_UINT32(1, next.seen().connects);
+    TEST_ASSERT_EQUAL_UINT32(0, next.seen().publishes);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_settings_take_effect_on_the_mqtt_task);
+    RUN_TEST(test_qos0_delivers_everything);
+    RUN_TEST(test_qos1_pipelines_past_the_round_trip);
+    RUN_TEST(test_qos1_resends_after_dropped_session);
+    RUN_TEST(test_broker_change_drops_the_inflight_window);
+    return UNITY_END();
+}
@@ -0,0 +1,132 @@
+/*
+ * EnergyLedger hour rollover: time that runs past the end of the open
+ * hour is split between the hours it spans, so every closed hour covers
+ * exactly one hour, a long deep sleep fills one bucket per hour, and the
+ * ring keeps the last day. Also checks the same through PowerManager,
+ * whose light sleep skips the host clock forward.
+ *
+ *   pio test -e native -f test_powermanager
+ */
+#include <unity.h>
+#include "PowerManager.h"
+
+static EnergyLedger ledger;
+
+void setUp()
+{
+    ledger.reset();
+}
+
+void tearDown() {}
+
+void test_hour_closes_at_exactly_one_hour()
+{
+    ledger.add(POWER_HOUR_MS - 1, 0, 0, 0);
+    TEST_ASSERT_EQUAL(0, ledger.filled);
+    ledger.add(1, 0, 0, 0);
+    TEST_ASSERT_EQUAL(1, ledger.filled);
+    TEST_ASSERT_EQUAL(POWER_HOUR_MS, ledger.hour(0).awakeMs);
+    TEST_ASSERT_EQUAL(0, ledger.open.elapsedMs());
+}
+
+void test_overshoot_carries_into_the_next_hour()
+{
+    ledger.add(POWER_HOUR_MS - 1000, 0, 0, 0);
+    ledger.add(0, 0, 5000, 0);
+    TEST_ASSERT_EQUAL(1, ledger.filled);
+    TEST_ASSERT_EQUAL(POWER_HOUR_MS, ledger.hour(0).elapsedMs());
+    TEST_ASSERT_EQUAL(1000, ledger.hour(0).lightMs);
+    TEST_ASSERT_EQUAL(4000, ledger.open.lightMs);
+}
+
+void test_split_is_pro_rata_across_states()
+{
+    // Half an hour open, then an hour of mixed time: half of it fits
+    ledger.add(POWER_HOUR_MS / 2, 0, 0, 0);
+    ledger.add(600000, 300000, 1200000, 1800000);
+    const EnergyHour &h = ledger.hour(0);
+    TEST_ASSERT_EQUAL(POWER_HOUR_MS, h.elapsedMs());
+    TEST_ASSERT_EQUAL(POWER_HOUR_MS / 2 + 300000, h.awakeMs);
+    TEST_ASSERT_EQUAL(150000, h.radioMs);
+    TEST_ASSERT_EQUAL(600000, h.lightMs);
+    TEST_ASSERT_EQUAL(900000, h.deepMs);
+    TEST_ASSERT_EQUAL(300000, ledger.open.awakeMs);
+    TEST_ASSERT_EQUAL(150000, ledger.open.radioMs);
+    TEST_ASSERT_EQUAL(600000, ledger.open.lightMs);
+    TEST_ASSERT_EQUAL(900000, ledger.open.deepMs);
+}
+
+void test_long_deep_sleep_fills_one_bucket_per_hour()
+{
+    ledger.add(60000, 0, 0, 0);
+    ledger.add(0, 0, 0, 5 * POWER_HOUR_MS + 30000);
+    TEST_ASSERT_EQUAL(5, ledger.filled);
+    TEST_ASSERT_EQUAL(60000, ledger.hour(0).awakeMs);
+    TEST_ASSERT_EQUAL(POWER_HOUR_MS - 60000, ledger.hour(0).deepMs);
+    for (uint8_t i = 1; i < 5; i++) {
+        TEST_ASSERT_EQUAL(POWER_HOUR_MS, ledger.hour(i).deepMs);
+        TEST_ASSERT_EQUAL(0, ledger.hour(i).awakeMs);
+    }
+    TEST_ASSERT_EQUAL(90000, ledger.open.deepMs);
+    TEST_ASSERT_EQUAL(60000, ledger.window().awakeMs);
+}
+
+void test_ring_keeps_the_last_day()
+{
+    // 30 hours awake for 1 min each, then a 2-day sleep pushes them all out
+    for (uint32_t h = 0; h < 30; h++) {
+        ledger.add(60000, 0, 0, POWER_HOUR_MS - 60000);
+    }
+    TEST_ASSERT_EQUAL(POWER_HISTORY_HOURS, ledger.filled);
+    TEST_ASSERT_EQUAL_FLOAT(60000.0f, ledger.awakeMsPerHour());
+
+    ledger.add(0, 0, 0, 48 * POWER_HOUR_MS);
+    TEST_ASSERT_EQUAL(POWER_HISTORY_HOURS, ledger.filled);
+    TEST_ASSERT_EQUAL(0, ledger.window().awakeMs);
+    TEST_ASSERT_EQUAL(POWER_HISTORY_HOURS * POWER_HOUR_MS, ledger.window().deepMs);
+}
+
+void test_wakes_stay_with_the_hour_they_happened_in()
+{
+    ledger.add(POWER_HOUR_MS - 10, 0, 0, 0);
+    ledger.wake(WAKE_BUTTON);
+    ledger.add(0, 0, 3 * POWER_HOUR_MS, 0);
+    ledger.wake(WAKE_TIMER);
+    TEST_ASSERT_EQUAL(3, ledger.filled);
+    TEST_ASSERT_EQUAL(1, ledger.hour(0).wakes);
+    TEST_ASSERT_EQUAL(0, ledger.hour(1).wakes);
+    TEST_ASSERT_EQUAL(1, ledger.open.wakes);
+    TEST_ASSERT_EQUAL(1, ledger.wakesByCause[WAKE_BUTTON]);
+    TEST_ASSERT_EQUAL(1, ledger.wakesByCause[WAKE_TIMER]);
+}
+
+void test_light_sleep_across_the_hour()
+{
+    PowerManager pm;
+    pm.begin(60);
+    pm.account(esp_timer_get_time());
+    powerRetained.ledger.reset();
+
+    hostAdvance(POWER_HOUR_MS - 1000);
+    TEST_ASSERT_EQUAL(WAKE_TIMER, pm.lightSleep(5000000));
+    const EnergyLedger &l = pm.ledger();
+    TEST_ASSERT_EQUAL(1, l.filled);
+    TEST_ASSERT_EQUAL(POWER_HOUR_MS, l.hour(0).elapsedMs());
+    TEST_ASSERT_UINT32_WITHIN(50, POWER_HOUR_MS - 1000, l.hour(0).awakeMs);
+    TEST_ASSERT_UINT32_WITHIN(50, 4000, l.open.lightMs);
+    TEST_ASSERT_EQUAL(1, l.open.wakes);
+    TEST_ASSERT_EQUAL(1, l.wakesByCause[WAKE_TIMER]);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_hour_closes_at_exactly_one_hour);
+    RUN_TEST(test_overshoot_carries_into_the_next_hour);
+    RUN_TEST(test_split_is_pro_rata_across_states);
+    RUN_TEST(test_long_deep_sleep_fills_one_bucket_per_hour);
+    RUN_TEST(test_ring_keeps_the_last_day);
+    RUN_TEST(test_wakes_stay_with_the_hour_they_happened_in);
+    RUN_TEST(test_light_sleep_across_the_hour);
+    return UNITY_END();
+}
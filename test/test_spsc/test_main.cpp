@@ -0,0 +1,141 @@
+/*
+ * SpscRing: ordering and wrap-around, then a two-thread benchmark of the
+ * acquire → safety queue shape (Sample_t, depth 8) printing throughput and
+ * push-to-pop latency percentiles. Timings are host figures for comparing
+ * changes to the ring, not device numbers.
+ *
+ *   pio test -e native -f test_spsc
+ */
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "Pipeline.h"
+
+static uint64_t nowNs()
+{
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_fifo_order_across_wrap()
+{
+    SpscRing<uint32_t, 4> ring;
+    uint32_t next = 0;
+    uint32_t expect = 0;
+    for (uint32_t round = 0; round < 1000; round++) {
+        while (ring.push(next)) {
+            next++;
+        }
+        TEST_ASSERT_EQUAL(4, ring.size());
+        uint32_t v;
+        for (uint32_t i = 0; i <= round % 4; i++) {
+            TEST_ASSERT_TRUE(ring.pop(v));
+            TEST_ASSERT_EQUAL_UINT32(expect++, v);
+        }
+    }
+}
+
+void test_batches_are_clipped_to_fit()
+{
+    SpscRing<uint32_t, 8> ring;
+    uint32_t in[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    TEST_ASSERT_EQUAL(8, ring.pushBatch(in, 12));
+    TEST_ASSERT_EQUAL(0, ring.pushBatch(in + 8, 4));
+
+    uint32_t v;
+    TEST_ASSERT_TRUE(ring.peekAt(7, v));
+    TEST_ASSERT_EQUAL_UINT32(7, v);
+    TEST_ASSERT_FALSE(ring.peekAt(8, v));
+
+    uint32_t out[12];
+    TEST_ASSERT_EQUAL(5, ring.popBatch(out, 5));
+    TEST_ASSERT_EQUAL(4, ring.pushBatch(in + 8, 4));
+    TEST_ASSERT_EQUAL(7, ring.popBatch(out, 12));
+    TEST_ASSERT_EQUAL_UINT32(5, out[0]);
+    TEST_ASSERT_EQUAL_UINT32(11, out[6]);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+/* Producer stamps each sample; the consumer records push → pop latency */
+static void runBenchmark(const char *name, size_t batch, uint32_t items)
+{
+    static SpscRing<Sample_t, SAMPLE_QUEUE_LEN> ring;
+    LatencyHistogram<96> latencyNs;
+    std::atomic<bool> go{false};
+
+    std::thread producer([&] {
+        while (!go.load()) {
+            std::this_thread::yield();
+        }
+        Sample_t out[SAMPLE_QUEUE_LEN] = {};
+        uint32_t seq = 0;
+        while (seq < items) {
+            size_t n = batch;
+            if (n > items - seq) {
+                n = items - seq;
+            }
+            uint64_t stamp = nowNs();
+            for (size_t i = 0; i < n; i++) {
+                out[i].acquiredUs = (int64_t)stamp;
+                out[i].acquiredMs = seq + i;
+            }
+            size_t pushed = ring.pushBatch(out, n);
+            seq += pushed;
+            if (!pushed) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    go = true;
+    uint64_t t0 = nowNs();
+    Sample_t in[SAMPLE_QUEUE_LEN];
+    uint32_t expect = 0;
+    bool ordered = true;
+    while (expect < items) {
+        size_t n = ring.popBatch(in, batch);
+        if (!n) {
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t now = nowNs();
+        for (size_t i = 0; i < n; i++) {
+            ordered &= in[i].acquiredMs == expect++;
+            uint64_t ns = now - (uint64_t)in[i].acquiredUs;
+            latencyNs.record(ns > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)ns);
+        }
+    }
+    double seconds = (nowNs() - t0) / 1e9;
+    producer.join();
+
+    char line[200];
+    snprintf(line, sizeof(line), "spsc %s: %.2f M samples/s, latency p50 %u ns, p99 %u ns, p99.9 %u ns, max %u ns",
+             name, items / seconds / 1e6, (unsigned)latencyNs.percentile(50), (unsigned)latencyNs.percentile(99),
+             (unsigned)latencyNs.percentile(99.9f), (unsigned)latencyNs.max());
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_benchmark_single_items()
+{
+    runBenchmark("push/pop", 1, 2000000);
+}
+
+void test_benchmark_batches()
+{
+    runBenchmark("batch of 4", 4, 2000000);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_order_across_wrap);
+    RUN_TEST(test_batches_are_clipped_to_fit);
+    RUN_TEST(test_benchmark_single_items);
+    RUN_TEST(test_benchmark_batches);
+    return UNITY_END();
+}
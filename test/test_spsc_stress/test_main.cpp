@@ -0,0 +1,147 @@
+/*
+ * SpscRing under ThreadSanitizer: a producer and a consumer thread hammer
+ * small rings with every push/pop/peek variant while an observer polls
+ * size(). Any data race aborts the run; payload checksums catch torn or
+ * reordered items.
+ *
+ *   pio test -e native_tsan
+ */
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "SpscRing.h"
+
+#ifdef __SANITIZE_THREAD__
+extern "C" const char *__tsan_default_options()
+{
+    return "halt_on_error=1";
+}
+#endif
+
+struct Item
+{
+    uint32_t seq;
+    uint32_t words[5];
+    uint32_t check;
+
+    void fill(uint32_t s)
+    {
+        seq = s;
+        check = s;
+        for (uint8_t i = 0; i < 5; i++) {
+            words[i] = s * 2654435761u + i;
+            check ^= words[i];
+        }
+    }
+
+    bool valid() const
+    {
+        uint32_t c = seq;
+        for (uint8_t i = 0; i < 5; i++) {
+            c ^= words[i];
+        }
+        return c == check;
+    }
+};
+
+constexpr uint32_t STRESS_ITEMS = 100000;
+
+template <size_t N>
+static void stress()
+{
+    static SpscRing<Item, N> ring;
+    std::atomic<bool> done{false};
+    std::atomic<bool> sizeBounded{true};
+
+    std::thread producer([&] {
+        Item batch[N];
+        uint32_t seq = 0;
+        while (seq < STRESS_ITEMS) {
+            if (seq % 3) {
+                Item item;
+                item.fill(seq);
+                seq += ring.push(item);
+            } else {
+                size_t n = 1 + seq % N;
+                if (n > STRESS_ITEMS - seq) {
+                    n = STRESS_ITEMS - seq;
+                }
+                for (size_t i = 0; i < n; i++) {
+                    batch[i].fill(seq + i);
+                }
+                seq += ring.pushBatch(batch, n);
+            }
+            if (ring.size() == N) {
+                std::this_thread::yield();   // let the consumer run on a single-core host
+            }
+        }
+    });
+
+    std::thread observer([&] {
+        while (!done.load()) {
+            if (ring.size() > N) {
+                sizeBounded = false;
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    Item batch[N];
+    uint32_t expect = 0;
+    bool intact = true;
+    while (expect < STRESS_ITEMS) {
+        Item item;
+        switch (expect % 4) {
+        case 0:
+            if (ring.pop(item)) {
+                intact &= item.valid() && item.seq == expect++;
+            }
+            break;
+        case 1:
+            if (ring.peek(item)) {
+                intact &= item.valid() && item.seq == expect;
+                ring.pop(item);
+                intact &= item.seq == expect++;
+            }
+            break;
+        case 2:
+            if (ring.peekAt(1, item)) {
+                intact &= item.valid() && item.seq == expect + 1;
+            }
+            break;
+        default:
+            break;
+        }
+        if (expect % 4 >= 2) {
+            size_t n = ring.popBatch(batch, 1 + expect % N);
+            for (size_t i = 0; i < n; i++) {
+                intact &= batch[i].valid() && batch[i].seq == expect++;
+            }
+        }
+        if (ring.empty()) {
+            std::this_thread::yield();
+        }
+    }
+    done = true;
+    producer.join();
+    observer.join();
+    TEST_ASSERT_TRUE(intact);
+    TEST_ASSERT_TRUE(sizeBounded.load());
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_stress_depth_2() { stress<2>(); }
+void test_stress_depth_8() { stress<8>(); }
+void test_stress_depth_64() { stress<64>(); }
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_stress_depth_2);
+    RUN_TEST(test_stress_depth_8);
+    RUN_TEST(test_stress_depth_64);
+    return UNITY_END();
+}
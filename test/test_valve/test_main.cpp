@@ -0,0 +1,134 @@
+/*
+ * ValveActuator with end-stop feedback: a stuck latch holds back repeated
+ * opens but never a close or a change of direction, so the safety
+ * shutoffs still reach the pin. The end-stops are pins the test drives.
+ *
+ *   pio test -e native -f test_valve
+ */
+#define VALVE_FB_OPEN_PIN   15
+#define VALVE_FB_CLOSED_PIN 16
+
+#include <unity.h>
+#include "RamFlash.h"
+#include "Servo.h"
+
+static RamFlash flash(4);
+
+/* Positions the end-stops report; both high = somewhere in between */
+static void endStops(bool atOpen, bool atClosed)
+{
+    digitalWrite(VALVE_FB_OPEN_PIN, atOpen ? LOW : HIGH);
+    digitalWrite(VALVE_FB_CLOSED_PIN, atClosed ? LOW : HIGH);
+}
+
+/* Commands a move that never arrives and lets it time out */
+static void stickMoving(bool open)
+{
+    TEST_ASSERT_TRUE(open ? valveOn() : valveOff());
+    endStops(false, false);
+    valve.run();
+    hostAdvance(VALVE_STUCK_TIMEOUT_MS);
+    valve.run();
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_STUCK, valve.getState());
+    TEST_ASSERT_TRUE(valve.takeStuckEvent());
+}
+
+void setUp()
+{
+    valve = ValveActuator();
+    valve.begin();
+    if (!valve.isOpen()) {
+        valve.command(true);
+    }
+    endStops(true, false);
+    valve.run();
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_OPEN, valve.getState());
+}
+
+void tearDown() {}
+
+void test_close_drives_a_valve_stuck_opening()
+{
+    valveOff();
+    endStops(false, true);
+    valve.run();
+    stickMoving(true);
+    TEST_ASSERT_EQUAL(HIGH, digitalRead(SERVOPIN));
+
+    TEST_ASSERT_TRUE(valveOff());
+    TEST_ASSERT_EQUAL(LOW, digitalRead(SERVOPIN));
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_CLOSING, valve.getState());
+
+    // The stuck timer restarted with the close
+    hostAdvance(VALVE_STUCK_TIMEOUT_MS - 1000);
+    valve.run();
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_CLOSING, valve.getState());
+    endStops(false, true);
+    valve.run();
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_CLOSED, valve.getState());
+}
+
+void test_open_drives_a_valve_stuck_closing()
+{
+    stickMoving(false);
+    TEST_ASSERT_TRUE(valveOn());
+    TEST_ASSERT_EQUAL(HIGH, digitalRead(SERVOPIN));
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_OPENING, valve.getState());
+}
+
+void test_stuck_latch_holds_back_repeated_opens()
+{
+    valveOff();
+    endStops(false, true);
+    valve.run();
+    stickMoving(true);
+
+    TEST_ASSERT_FALSE(valveOn());
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_STUCK, valve.getState());
+
+    // A user retry drives again without a second stuck event
+    TEST_ASSERT_TRUE(valve.command(true, true));
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_OPENING, valve.getState());
+    hostAdvance(VALVE_STUCK_TIMEOUT_MS);
+    valve.run();
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_STUCK, valve.getState());
+    TEST_ASSERT_FALSE(valve.takeStuckEvent());
+}
+
+void test_repeated_close_redrives_without_realerting()
+{
+    stickMoving(false);
+    digitalWrite(SERVOPIN, HIGH);   // e.g. a brown-out glitched the output
+
+    TEST_ASSERT_FALSE(valveOff());
+    TEST_ASSERT_EQUAL(LOW, digitalRead(SERVOPIN));
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_CLOSING, valve.getState());
+    TEST_ASSERT_FALSE(valveOff());
+
+    hostAdvance(VALVE_STUCK_TIMEOUT_MS);
+    valve.run();
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_STUCK, valve.getState());
+    TEST_ASSERT_FALSE(valve.takeStuckEvent());
+    TEST_ASSERT_EQUAL(2, valve.stuckEvents());
+}
+
+void test_late_arrival_clears_the_latch()
+{
+    stickMoving(false);
+    endStops(false, true);
+    valve.run();
+    TEST_ASSERT_EQUAL(ValveActuator::VALVE_CLOSED, valve.getState());
+    TEST_ASSERT_FALSE(valveOff());
+}
+
+int main(int argc, char **argv)
+{
+    stateStore.begin(flash);
+    UNITY_BEGIN();
+    RUN_TEST(test_close_drives_a_valve_stuck_opening);
+    RUN_TEST(test_open_drives_a_valve_stuck_closing);
+    RUN_TEST(test_stuck_latch_holds_back_repeated_opens);
+    RUN_TEST(test_repeated_close_redrives_without_realerting);
+    RUN_TEST(test_late_arrival_clears_the_latch);
+    return UNITY_END();
+}
@@ -0,0 +1,143 @@
+/*
+ * WallClock: local time across the NZ DST transitions, the hold over the
+ * repeated hour, slewed and stepped corrections that never move UTC
+ * backwards, and the local-seconds wrap in 2106.
+ *
+ *   pio test -e native -f test_wallclock
+ */
+#include <unity.h>
+#include <new>
+#include "WallClock.h"
+
+constexpr uint64_t HOUR_MS = 3600000;
+
+static uint64_t utcMs(int32_t y, uint32_t mo, uint32_t d, uint32_t h, uint32_t mi, uint32_t s)
+{
+    return ((uint64_t)daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s) * 1000;
+}
+
+/* Local seconds for a wall-clock reading, as localSeconds() encodes it */
+static uint32_t localAt(int32_t y, uint32_t mo, uint32_t d, uint32_t h, uint32_t mi, uint32_t s)
+{
+    return (uint32_t)(utcMs(y, mo, d, h, mi, s) / 1000);
+}
+
+void setUp()
+{
+    // onSync() reaches the global, and the mutex member rules out assignment
+    wallClock.~WallClock();
+    new (&wallClock) WallClock();
+    wallClock.setTimezone(WALLCLOCK_DEFAULT_TZ);
+}
+
+void tearDown() {}
+
+void test_dst_starts_forward_an_hour()
+{
+    // 2024-09-29 02:00 NZST becomes 03:00 NZDT at 14:00 UTC the day before
+    uint64_t change = utcMs(2024, 9, 28, 14, 0, 0);
+    TEST_ASSERT_EQUAL(localAt(2024, 9, 29, 1, 59, 59), WallClock::localSeconds(change - 1000));
+    TEST_ASSERT_EQUAL(localAt(2024, 9, 29, 3, 0, 0), WallClock::localSeconds(change));
+    TEST_ASSERT_EQUAL(localAt(2024, 9, 29, 3, 0, 0), WallClock::localSeconds(change + 999));
+}
+
+void test_dst_ends_back_an_hour()
+{
+    // 2025-04-06 03:00 NZDT becomes 02:00 NZST at 14:00 UTC the day before
+    uint64_t change = utcMs(2025, 4, 5, 14, 0, 0);
+    TEST_ASSERT_EQUAL(localAt(2025, 4, 6, 2, 59, 59), WallClock::localSeconds(change - 1000));
+    TEST_ASSERT_EQUAL(localAt(2025, 4, 6, 2, 0, 0), WallClock::localSeconds(change));
+    TEST_ASSERT_EQUAL(localAt(2025, 4, 6, 3, 0, 0), WallClock::localSeconds(change + HOUR_MS));
+}
+
+void test_hold_covers_the_repeated_hour()
+{
+    uint64_t change = utcMs(2025, 4, 5, 14, 0, 0);
+    uint32_t peak = localAt(2025, 4, 6, 2, 59, 0);
+    uint32_t held = 0;
+    for (uint64_t t = change - 60000; t <= change + HOUR_MS + 60000; t += 60000) {
+        uint32_t next = WallClock::holdLocal(held, WallClock::localSeconds(t));
+        TEST_ASSERT_TRUE(!held || next >= held);
+        held = next;
+        if (t < change + HOUR_MS) {
+            TEST_ASSERT_EQUAL(peak, held);
+        }
+    }
+    TEST_ASSERT_EQUAL(localAt(2025, 4, 6, 3, 1, 0), held);
+}
+
+void test_local_seconds_wrap_in_2106()
+{
+    // Local seconds pass 2^32 at 2106-02-07 06:28:16; NZDT (+13) gets there at 17:28:16 UTC the day before
+    uint64_t wrapUtc = utcMs(2106, 2, 6, 17, 28, 16);
+    TEST_ASSERT_EQUAL(UINT32_MAX, WallClock::localSeconds(wrapUtc - 1000));
+    TEST_ASSERT_EQUAL(0, WallClock::localSeconds(wrapUtc));
+    TEST_ASSERT_EQUAL(3600, WallClock::localSeconds(wrapUtc + HOUR_MS));
+    TEST_ASSERT_LESS_THAN(1ULL << 32, wrapUtc / 1000);   // UTC itself has not wrapped
+
+    // The hold keeps following time across the wrap, and still holds there
+    uint32_t held = WallClock::localSeconds(wrapUtc - 60000);
+    held = WallClock::holdLocal(held, WallClock::localSeconds(wrapUtc + 60000));
+    TEST_ASSERT_EQUAL(60, held);
+    TEST_ASSERT_EQUAL(60, WallClock::holdLocal(held, WallClock::localSeconds(wrapUtc - 30000)));
+    TEST_ASSERT_EQUAL(120, WallClock::holdLocal(held, 120));
+
+    // A first reading past 2^31 is taken, not compared against "unset"
+    TEST_ASSERT_EQUAL(0x90000000u, WallClock::holdLocal(0, 0x90000000u));
+}
+
+void test_small_correction_is_slewed()
+{
+    wallClock.begin(WALLCLOCK_DEFAULT_TZ);
+    wallClock.start();
+    TEST_ASSERT_TRUE(wallClock.valid());
+
+    // The oscillator gains 500 ms on UTC; the sync pulls it back gradually
+    hostAdvance(500);
+    uint64_t before = wallClock.utcMillis();
+    hostSntpSync();
+    TEST_ASSERT_EQUAL(0, wallClock.stats().steps);
+    TEST_ASSERT_INT_WITHIN(20000, -500000, (int32_t)wallClock.stats().lastErrorUs);
+    uint64_t u1 = wallClock.utcMillis();
+    TEST_ASSERT_GREATER_OR_EQUAL(before, u1);
+
+    // 0.5 ms per second: 200 ms of the error over 400 s, the rest by 1000 s more
+    hostAdvance(400000);
+    uint64_t u2 = wallClock.utcMillis();
+    TEST_ASSERT_UINT32_WITHIN(20, 400000 - 200, (uint32_t)(u2 - u1));
+    hostAdvance(1000000);
+    uint64_t u3 = wallClock.utcMillis();
+    TEST_ASSERT_UINT32_WITHIN(20, 1000000 - 300, (uint32_t)(u3 - u2));
+    hostAdvance(1000000);
+    TEST_ASSERT_UINT32_WITHIN(20, 1000000, (uint32_t)(wallClock.utcMillis() - u3));
+}
+
+void test_large_correction_steps_and_holds()
+{
+    wallClock.begin(WALLCLOCK_DEFAULT_TZ);
+    wallClock.start();
+    hostAdvance(5000);
+    uint64_t before = wallClock.utcMillis();
+    hostSntpSync();
+    TEST_ASSERT_EQUAL(1, wallClock.stats().steps);
+
+    // UTC is now 5 s behind what was handed out: held there, never backwards
+    TEST_ASSERT_EQUAL(before, wallClock.utcMillis());
+    hostAdvance(3000);
+    TEST_ASSERT_EQUAL(before, wallClock.utcMillis());
+    hostAdvance(3000);
+    uint64_t after = wallClock.utcMillis();
+    TEST_ASSERT_UINT32_WITHIN(20, 1000, (uint32_t)(after - before));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dst_starts_forward_an_hour);
+    RUN_TEST(test_dst_ends_back_an_hour);
+    RUN_TEST(test_hold_covers_the_repeated_hour);
+    RUN_TEST(test_local_seconds_wrap_in_2106);
+    RUN_TEST(test_small_correction_is_slewed);
+    RUN_TEST(test_large_correction_steps_and_holds);
+    return UNITY_END();
+}
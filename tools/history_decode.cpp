@@ -0,0 +1,120 @@
+/*
+ * Host decoder for the `history` console export (src/HistoryCodec.h).
+ *
+ *   c++ -std=c++17 -O2 -o history_decode tools/history_decode.cpp
+ *   ./history_decode capture.txt > history.csv   # console capture, {"hist":"..."} lines
+ *   ./history_decode -b history.bin > history.csv  # raw encoded stream
+ *
+ * Reads stdin when no file is given. Prints CSV in the charted units.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "../src/HistoryCodec.h"
+
+/* ─── Input ────────────────────────────────────────────────────────────── */
+static int base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+static bool appendBase64(const std::string &text, std::vector<uint8_t> &out)
+{
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char c : text) {
+        if (c == '=') {
+            break;
+        }
+        int v = base64Value(c);
+        if (v < 0) {
+            return false;
+        }
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back((uint8_t)(acc >> bits));
+        }
+    }
+    return true;
+}
+
+/* Collects the payload of every {"hist":"..."} line; other console output is ignored */
+static bool readCapture(FILE *f, std::vector<uint8_t> &out)
+{
+    static const char KEY[] = "\"hist\":\"";
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        const char *p = strstr(line, KEY);
+        if (!p) {
+            continue;
+        }
+        p += sizeof(KEY) - 1;
+        const char *end = strchr(p, '"');
+        if (!end || !appendBase64(std::string(p, end), out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void readBinary(FILE *f, std::vector<uint8_t> &out)
+{
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        out.insert(out.end(), buf, buf + n);
+    }
+}
+
+/* ─── Output ───────────────────────────────────────────────────────────── */
+static void printRow(void *, const HistoryRow &row)
+{
+    printf("%lld", (long long)row.v[HIST_TIME]);
+    for (uint8_t c = HIST_TIME + 1; c < HIST_COLUMNS; c++) {
+        printf(HIST_COLUMN_SCALE[c] < 0.1f ? ",%.2f" : ",%.1f", row.v[c] * HIST_COLUMN_SCALE[c]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    bool binary = argc > 1 && !strcmp(argv[1], "-b");
+    const char *path = argc > (binary ? 2 : 1) ? argv[binary ? 2 : 1] : nullptr;
+    FILE *f = path ? fopen(path, binary ? "rb" : "r") : stdin;
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+
+    std::vector<uint8_t> stream;
+    if (binary) {
+        readBinary(f, stream);
+    } else if (!readCapture(f, stream)) {
+        fprintf(stderr, "bad base64 in capture\n");
+        return 1;
+    }
+    if (f != stdin) {
+        fclose(f);
+    }
+
+    for (uint8_t c = 0; c < HIST_COLUMNS; c++) {
+        printf(c ? ",%s" : "%s", HIST_COLUMN_NAMES[c]);
+    }
+    printf("\n");
+    long rows = decodeHistory(stream.data(), stream.size(), printRow, nullptr);
+    if (rows < 0) {
+        fprintf(stderr, "malformed or truncated stream (%zu bytes)\n", stream.size());
+        return 1;
+    }
+    fprintf(stderr, "%ld samples from %zu bytes\n", rows, stream.size());
+    return 0;
+}